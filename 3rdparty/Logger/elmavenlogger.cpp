@@ -37,6 +37,10 @@ ElMavenLogger* ElMavenLogger::getInstance() {
 
 void ElMavenLogger::logErr(const std::string& errMessage, const ErrorType& type)
 {
+    // the logger could not be created (e.g., init was never called)
+    if (!_logger)
+        return;
+
     switch(type) {
         case critical: {
             _logger->critical(errMessage);
@@ -1,4 +1,6 @@
 #include "cstdlib"
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
 #include "string.h"
 
@@ -26,10 +28,13 @@ float sum(MatF &mat, int rowNum);
 float sumXSquared(MatF &mat, int rowNum);
 float sumOfProducts(MatF &mat1, int rowNum1, MatF &mat2, int rowNum2);
 void _subtract(MatF &mat, int rowNum, float val, MatF &minused);
+void _band_products(MatF &mCoords, MatF &nCoords, std::vector<int> &first, std::vector<int> &last, MatF &products);
+void _band_distances(MatF &mCoords, MatF &nCoords, std::vector<int> &first, std::vector<int> &last, MatF &distances);
+int _band_width(std::vector<int> &first, std::vector<int> &last);
 float entropy(MatF &mat, int rowNum, int numBins, float minVal, float scaleFactor, MatI &indArray);
 void entropyXY(MatI &binIndX, MatI &binIndY, VecF &entropyX, VecF &entropyY, MatF &scores, int numBins);
 
-void _traceback(MatI &tb, MatF &smat, int m, int n, MatI &tbpath, VecI &equiv1, VecI &equiv2, VecF &scores);
+void _traceback(std::vector<unsigned char> &tb, MatF &smat, std::vector<int> &first, int m, int n, VecI &equiv1, VecI &equiv2, VecF &scores);
 
 // NEED to redo these guys and affirm correctness
 /*
@@ -348,28 +353,27 @@ void DynProg::best_anchors(VecI &mBijShort, VecI &nBijShort, VecF &sBijShort, Ve
 }
 
 // n and m are the starting index for traceback
-// Sets tbpath to be a matrix of 1's and 0's showing the path
+// tb holds the traceback of the cells of each row of smat, which begins at
+// column first[m] of the full matrix
 // scores are the scores at each equivalent point
 
-void _traceback(MatI &tb, MatF &smat, int m, int n, MatI &tbpath, VecI &mCoord, VecI &nCoord, VecF &scores) {
-    int i;
-    // Vec2I tbvec   to add in future for the equivalencies
-    int rows = tb.rows();
-    int cols = tb.cols();
-    int *n_eqr = new int[rows+cols];
-    int *m_eqr = new int[rows+cols];
-    float *score_pathr = new float[rows+cols];
-
-    int cnt = 0;
+void _traceback(std::vector<unsigned char> &tb, MatF &smat, std::vector<int> &first, int m, int n, VecI &mCoord, VecI &nCoord, VecF &scores) {
+    size_t width = smat.cols();
+    std::vector<int> tmpEquiv_m;
+    std::vector<int> tmpEquiv_n;
+    std::vector<float> tmpScores;
+    tmpEquiv_m.reserve(m + n + 1);
+    tmpEquiv_n.reserve(m + n + 1);
+    tmpScores.reserve(m + n + 1);
+
     // Go until we jump off the matrix:
     while (m != -1 && n != -1) {
-        //if (cnt > rows+cols) { printf("rows: %d cols: %d\n", rows, cols); printf("cnt too big!"); exit(1); }
-        n_eqr[cnt] = n;
-        m_eqr[cnt] = m;
-        tbpath(m,n) = 1;
-        score_pathr[cnt] = smat(m,n);
+        int k = n - first[m];
+        tmpEquiv_n.push_back(n);
+        tmpEquiv_m.push_back(m);
+        tmpScores.push_back(smat(m,k));
 
-        int val = tb(m,n);  
+        int val = tb[m * width + k];
         if (val == 0) { // Diag
             m -= 1;
             n -= 1;
@@ -380,28 +384,13 @@ void _traceback(MatI &tb, MatF &smat, int m, int n, MatI &tbpath, VecI &mCoord,
         else {  // val == 2  // Left
             n -= 1;
         }
-        cnt++;
     }
 
-    std::vector<int> tmpEquiv_m;
-    tmpEquiv_m.reserve(cnt);
-    std::vector<int> tmpEquiv_n;
-    tmpEquiv_n.reserve(cnt);
-    std::vector<float> tmpScores;
-    tmpScores.reserve(cnt);
-
     // Reverse the arrays
-    int rev = cnt - 1;
-    // This could be made a little faster...
-    for (i = 0; i < cnt; ++i) {
-        tmpEquiv_m.push_back(m_eqr[rev]);
-        tmpEquiv_n.push_back(n_eqr[rev]);
-        tmpScores.push_back(score_pathr[rev]);
-        rev--;
-    }
-    delete[] n_eqr;
-    delete[] m_eqr;
-    delete[] score_pathr;
+    std::reverse(tmpEquiv_m.begin(), tmpEquiv_m.end());
+    std::reverse(tmpEquiv_n.begin(), tmpEquiv_n.end());
+    std::reverse(tmpScores.begin(), tmpScores.end());
+    int cnt = tmpScores.size();
     mCoord.take(cnt, tmpEquiv_m);
     nCoord.take(cnt, tmpEquiv_n);
     scores.take(cnt, tmpScores);
@@ -717,22 +706,13 @@ float DynProg::sum_sq_res_yeqx(VecF &m_tm, VecF &n_tm, VecI &mWarpMap, VecI &nWa
 }
 
 void DynProg::score_product(MatF &mCoords, MatF &nCoords, MatF &scores) {
-    int i;
     int s_mlen = mCoords.rows();// s_cols = length_n
     int s_nlen = nCoords.rows();// s_rows = length_m  // Both rows and cols derived from # rows
-    int cols = mCoords.cols();
-    assert(cols == nCoords.cols());
-    MatF tmp(s_mlen, s_nlen);
-    for (int m = 0; m < s_mlen; ++m) {
-        for (int n = 0; n < s_nlen; ++n) {
-            float sum = 0.0;
-            for (i = 0; i < cols; ++i) {
-                sum += mCoords(m,i) * nCoords(n,i);
-            }
-            tmp(m,n) = sum;
-            //printf("M: %d N: %d sum: %f\n", m, n, sum);
-        }
-    }
+    assert(mCoords.cols() == nCoords.cols());
+    std::vector<int> first, last;
+    band_bounds(s_mlen, s_nlen, first, last);
+    MatF tmp;
+    _band_products(mCoords, nCoords, first, last, tmp);
     scores.take(tmp);
 }
 
@@ -745,7 +725,6 @@ void DynProg::score_covariance(MatF &mCoords, MatF &nCoords, MatF &scores) {
     int cols = mCoords.cols();
     assert(cols == nCoords.cols());
     //printf("WORKING IN COVARIANCE\n");
-    MatF tmp(s_mlen, s_nlen);
 
     double *sum_x = new double[s_nlen];
     double *sum_y = new double[s_mlen];
@@ -757,11 +736,16 @@ void DynProg::score_covariance(MatF &mCoords, MatF &nCoords, MatF &scores) {
         sum_y[i] = mCoords.sum(i);
     }
 
-    // CALCULATE ALL PAIR calculations
-    for (int n = 0; n < s_nlen; ++n) {
-        for (int m = 0; m < s_mlen; ++m) {
-            tmp(m,n) = (sumOfProducts(mCoords, m, nCoords, n) -
-                ((sum_x[n] * sum_y[m])/cols))/cols;
+    // CALCULATE ALL PAIR calculations (of the band)
+    std::vector<int> first, last;
+    band_bounds(s_mlen, s_nlen, first, last);
+    MatF tmp;
+    _band_products(mCoords, nCoords, first, last, tmp);
+    for (int m = 0; m < s_mlen; ++m) {
+        float *row = tmp.rowData(m);
+        for (int n = first[m]; n <= last[m]; ++n) {
+            float &score = row[n - first[m]];
+            score = (score - ((sum_x[n] * sum_y[m])/cols))/cols;
         }
     }
     delete[] sum_x;
@@ -775,7 +759,6 @@ void DynProg::score_pearsons_r(MatF &mCoords, MatF &nCoords, MatF &scores) {
     int s_mlen = mCoords.rows();// s_rows = length_m  // Both rows and cols derived from # rows
     int cols = mCoords.cols();
     assert(cols == nCoords.cols());
-    MatF tmp(s_mlen, s_nlen);
 
     //printf("WORKING IN PEARSONS_R\n");
     float *bot_x = new float[s_nlen]; 
@@ -796,18 +779,23 @@ void DynProg::score_pearsons_r(MatF &mCoords, MatF &nCoords, MatF &scores) {
         bot_y[i] = ( sumXSquared(mCoords,i) ) - ( ((sum_y[i])*sum_y[i])/cols );
     }
 
-    // CALCULATE ALL PAIR calculations
-    for (int n = 0; n < s_nlen; ++n) {
-        for (int m = 0; m < s_mlen; ++m) {
+    // CALCULATE ALL PAIR calculations (of the band)
+    std::vector<int> first, last;
+    band_bounds(s_mlen, s_nlen, first, last);
+    MatF tmp;
+    _band_products(mCoords, nCoords, first, last, tmp);
+    for (int m = 0; m < s_mlen; ++m) {
+        float *row = tmp.rowData(m);
+        for (int n = first[m]; n <= last[m]; ++n) {
+            float &score = row[n - first[m]];
             double bot = sqrt(bot_x[n] * bot_y[m]);
             if (bot == 0) {
                 // no undefined
-                tmp(m, n) = 0;
+                score = 0;
             } else {
                 // sum(X * Y) - (sum(x) * sum(y))/num_elements
-                double top = sumOfProducts(mCoords, m, nCoords, n)
-                             - ((sum_x[n] * sum_y[m]) / cols);
-                tmp(m, n) = static_cast<float>(top / bot);
+                double top = score - ((sum_x[n] * sum_y[m]) / cols);
+                score = static_cast<float>(top / bot);
             }
         }
     }
@@ -858,27 +846,18 @@ void DynProg::score_pearsons_r2(MatF &mCoords, MatF &nCoords, MatF &scores) {
         }
     }
     delete[] bot_x; delete[] bot_y;
+    crop_to_band(tmp);
     scores.take(tmp);
 }
 
 void DynProg::score_euclidean(MatF &mCoords, MatF &nCoords, MatF &scores) {
-    int i;
     int s_mlen = mCoords.rows();// s_cols = length_n
     int s_nlen = nCoords.rows();// s_rows = length_m  // Both rows and cols derived from # rows
-    int cols = mCoords.cols();
-    assert(cols == nCoords.cols());
-    MatF tmp(s_mlen, s_nlen);
-    for (int m = 0; m < s_mlen; ++m) {
-        for (int n = 0; n < s_nlen; ++n) {
-            float sum = 0.0;
-            for (i = 0; i < cols; ++i) {
-                float diff = mCoords(m,i) - nCoords(n,i);
-                sum += diff * diff;
-            }
-            tmp(m,n) = sqrt(sum);
-            //printf("M: %d N: %d sum: %f\n", m, n, sum);
-        }
-    }
+    assert(mCoords.cols() == nCoords.cols());
+    std::vector<int> first, last;
+    band_bounds(s_mlen, s_nlen, first, last);
+    MatF tmp;
+    _band_distances(mCoords, nCoords, first, last, tmp);
     scores.take(tmp);
 }
 
@@ -929,6 +908,7 @@ void DynProg::score_mutual_info(MatF &mCoords, MatF &nCoords, MatF &scores, int
     // CALCULATE ALL PAIR calculations
 
     entropyXY(binIndNCoords, binIndMCoords, entropyX, entropyY, tmpmat, MI_NUM_BINS);
+    crop_to_band(tmpmat);
     scores.take(tmpmat);
 }
 
@@ -958,6 +938,136 @@ void DynProg::score(MatF &mCoords, MatF &nCoords, MatF &scores, const char *type
     }
 }
 
+void DynProg::set_band(std::vector<int> &start, std::vector<int> &end, int cols) {
+    int rows = start.size();
+    assert(end.size() == start.size());
+    _band_start = start;
+    _band_end = end;
+    _band_cols = cols;
+    if (rows == 0 || cols == 0) {
+        _band_start.clear();
+        _band_end.clear();
+        return;
+    }
+
+    int m;
+    for (m = 0; m < rows; ++m) {
+        _band_start[m] = max(0, min(_band_start[m], cols - 1));
+        _band_end[m] = max(0, min(_band_end[m], cols - 1));
+    }
+    // Only ever widen the band: it has to hold both corners, its bounds must
+    // not move backwards, and every row must start at most one column after
+    // the end of the row above, so that each of its cells has a predecessor.
+    _band_start[0] = 0;
+    _band_end[rows - 1] = cols - 1;
+    for (m = rows - 2; m >= 0; --m) {
+        _band_start[m] = min(_band_start[m], _band_start[m + 1]);
+    }
+    _band_end[0] = max(_band_end[0], _band_start[0]);
+    for (m = 1; m < rows; ++m) {
+        _band_end[m] = max(_band_end[m], _band_end[m - 1]);
+        _band_start[m] = min(_band_start[m], _band_end[m - 1] + 1);
+        _band_end[m] = max(_band_end[m], _band_start[m]);
+    }
+}
+
+void DynProg::band_bounds(int rows, int cols, std::vector<int> &start, std::vector<int> &end) {
+    if (banded()) {
+        assert(rows == (int)_band_start.size());
+        assert(cols == _band_cols);
+        start = _band_start;
+        end = _band_end;
+    }
+    else {
+        start.assign(rows, 0);
+        end.assign(rows, cols - 1);
+    }
+}
+
+void DynProg::crop_to_band(MatF &scores) {
+    if (!banded()) {
+        return;
+    }
+    int rows = scores.rows();
+    std::vector<int> first, last;
+    band_bounds(rows, scores.cols(), first, last);
+    MatF tmp(rows, _band_width(first, last), 0.0f);
+    for (int m = 0; m < rows; ++m) {
+        float* row = scores.rowData(m);
+        float* out = tmp.rowData(m);
+        for (int n = first[m]; n <= last[m]; ++n) {
+            out[n - first[m]] = row[n];
+        }
+    }
+    scores.take(tmp);
+}
+
+// Same arithmetic as VecF::sample_stats, over the band only
+void DynProg::score_stats(MatF &smat, double &mean, double &std_dev) {
+    std::vector<int> first, last;
+    band_bounds(smat.rows(), banded() ? _band_cols : smat.cols(), first, last);
+    double _sum = 0.0;
+    double _sumSq = 0.0;
+    int _len = 0;
+    for (int m = 0; m < smat.rows(); ++m) {
+        float* row = smat.rowData(m);
+        int count = last[m] - first[m] + 1;
+        for (int k = 0; k < count; ++k) {
+            double _val = static_cast<double>(row[k]);
+            _sum += _val;
+            _sumSq += _val * _val;
+        }
+        _len += count;
+    }
+    double tmp = _sumSq - ((_sum * _sum)/_len);
+    tmp /= _len>1 ? _len-1 : 1;
+    std_dev = std::sqrt( tmp );
+    mean = _sum/_len;
+}
+
+void DynProg::std_normal(MatF &smat) {
+    if (!banded()) {
+        if (!smat.all_equal()) {
+            smat.std_normal();
+        }
+        return;
+    }
+
+    std::vector<int> first, last;
+    band_bounds(smat.rows(), _band_cols, first, last);
+    float mn = smat(0, 0);
+    float mx = smat(0, 0);
+    int m, k;
+    for (m = 0; m < smat.rows(); ++m) {
+        float* row = smat.rowData(m);
+        for (k = 0; k <= last[m] - first[m]; ++k) {
+            mn = min(mn, row[k]);
+            mx = max(mx, row[k]);
+        }
+    }
+    if (mn == mx) {
+        return;
+    }
+
+    double mean, std_dev;
+    score_stats(smat, mean, std_dev);
+    float avg = static_cast<float>(mean);
+    for (m = 0; m < smat.rows(); ++m) {
+        float* row = smat.rowData(m);
+        for (k = 0; k <= last[m] - first[m]; ++k) {
+            row[k] -= avg;
+        }
+    }
+    score_stats(smat, mean, std_dev);
+    float stdev = static_cast<float>(std_dev);
+    for (m = 0; m < smat.rows(); ++m) {
+        float* row = smat.rowData(m);
+        for (k = 0; k <= last[m] - first[m]; ++k) {
+            row[k] /= stdev;
+        }
+    }
+}
+
 
 void DynProg::expandFlag(MatI &flagged, int flag, int numSteps, MatI &expanded) {
     int m_length = flagged.rows();
@@ -1072,6 +1182,72 @@ void _subtract(MatF &mat, int rowNum, float val, MatF &minused) {
     }
 }
 
+int _band_width(std::vector<int> &first, std::vector<int> &last) {
+    int width = 0;
+    for (size_t m = 0; m < first.size(); ++m) {
+        width = max(width, last[m] - first[m] + 1);
+    }
+    return width;
+}
+
+// Dot products of each row m of mCoords with the rows first[m] to last[m] of
+// nCoords, stored from the first column of row m on. nCoords is transposed so
+// that the inner loop runs over contiguous products, which vectorizes, while
+// every product still sums its terms in the order of the columns. Zeros of
+// mCoords are skipped, they would only add zeros to the sums.
+void _band_products(MatF &mCoords, MatF &nCoords, std::vector<int> &first, std::vector<int> &last, MatF &products) {
+    int rows = mCoords.rows();
+    int cols = mCoords.cols();
+    MatF nTrans;
+    nCoords.transpose(nTrans);
+    MatF tmp(rows, _band_width(first, last), 0.0f);
+    for (int m = 0; m < rows; ++m) {
+        float* mRow = mCoords.rowData(m);
+        float* out = tmp.rowData(m);
+        int count = last[m] - first[m] + 1;
+        for (int i = 0; i < cols; ++i) {
+            float val = mRow[i];
+            if (val == 0.0f) {
+                continue;
+            }
+            float* nCol = nTrans.rowData(i) + first[m];
+#pragma omp simd
+            for (int k = 0; k < count; ++k) {
+                out[k] += val * nCol[k];
+            }
+        }
+    }
+    products.take(tmp);
+}
+
+// Euclidean distances between each row m of mCoords and the rows first[m] to
+// last[m] of nCoords, laid out and vectorized like _band_products
+void _band_distances(MatF &mCoords, MatF &nCoords, std::vector<int> &first, std::vector<int> &last, MatF &distances) {
+    int rows = mCoords.rows();
+    int cols = mCoords.cols();
+    MatF nTrans;
+    nCoords.transpose(nTrans);
+    MatF tmp(rows, _band_width(first, last), 0.0f);
+    for (int m = 0; m < rows; ++m) {
+        float* mRow = mCoords.rowData(m);
+        float* out = tmp.rowData(m);
+        int count = last[m] - first[m] + 1;
+        for (int i = 0; i < cols; ++i) {
+            float val = mRow[i];
+            float* nCol = nTrans.rowData(i) + first[m];
+#pragma omp simd
+            for (int k = 0; k < count; ++k) {
+                float diff = val - nCol[k];
+                out[k] += diff * diff;
+            }
+        }
+        for (int k = 0; k < count; ++k) {
+            out[k] = sqrt(out[k]);
+        }
+    }
+    distances.take(tmp);
+}
+
 //Sum of the products (i.e. the dot product at that row)
 float sumOfProducts(MatF &mat1, int rowNum1, MatF &mat2, int rowNum2) {
     float* mat1ptr = mat1.rowData(rowNum1);
@@ -1096,8 +1272,17 @@ float sumXSquared(MatF &mat, int rowNum) {
 }
 
 void DynProg::default_gap_penalty(MatF &smat, VecF &out) {
-    int _length = smat.cols() + smat.rows(); 
-    float _avg = smat.avg();
+    int _length = (banded() ? _band_cols : smat.cols()) + smat.rows(); 
+    float _avg;
+    if (banded()) {
+        double std_dev;
+        double mean;
+        score_stats(smat, mean, std_dev);
+        _avg = mean;
+    }
+    else {
+        _avg = smat.avg();
+    }
     linear_less_before(DEFAULT_GAP_PENALTY_SLOPE, _avg, _length, out);
 }
 
@@ -1139,150 +1324,84 @@ void DynProg::find_path(MatF& smat, VecF &gap_penalty, int minimize, float diag_
         }
     }
 
-    // Initialize matrices:
+    // Only the traceback is kept for every cell (of the band). The additive
+    // scores and gap lengths are only needed for the row above, and local
+    // alignments keep the best additive score of the right column.
     int rows = smat.rows();
-    int cols = smat.cols();
-    MatF tmp_asmat(rows, cols);
-    MatI tmp_tb(rows, cols);
-    MatI tmp_tbpath(rows, cols,0);
-    MatI tmp_gapmat(rows, cols);
+    int cols = banded() ? _band_cols : smat.cols();
+    size_t width = smat.cols();
+    std::vector<int> first, last;
+    band_bounds(rows, cols, first, last);
+    std::vector<unsigned char> tmp_tb(rows * width);
+    std::vector<float> prev_asmat(cols), tmp_asmat(cols);
+    std::vector<int> prev_gapmat(cols), tmp_gapmat(cols);
     _smat = &smat; // save a pointer to smat
 
+    // candidates from outside of the band (or the matrix) are never chosen
+    const float unavailable = minimize ? FLT_MAX : -FLT_MAX;
+
+    float best_right = 0.0f;
+    int best_right_m = -1;
+
     // ********************************************************
     // * BEGIN CALC ADDITIVE SCORE MATRIX
     // ********************************************************
-    int length_m = rows;
-    int length_n = cols;
-
-    //smat.print();
-    // Initialize top left cell:
-    tmp_asmat(0,0)  = smat(0,0);
-    tmp_gapmat(0,0) = 0;
-    tmp_tb(0,0)     = 0;
-
-    // GLOBAL:
-    if (!local) { 
-            // FILL in the left and top sides with gaps!
-            for (int m = 1; m < length_m; ++m) {
-                tmp_asmat(m,0) =  (smat(m,0) * gap_factor) + tmp_asmat(m-1,0) - gap_penalty[tmp_gapmat(m-1,0)];
-                tmp_gapmat(m,0) = m;
-                tmp_tb(m,0) = 1;  // path is from above 
-            }
-            for (int n = 1; n < length_n; ++n) {
-                tmp_asmat(0,n)= (smat(0,n) * gap_factor) + tmp_asmat(0,n - 1) - gap_penalty[tmp_gapmat(0,n - 1)];
-                tmp_gapmat(0,n) = n;
-                tmp_tb(0,n) = 2;  // path is from left 
-            }
-    }
-    // LOCAL:
-    else {   
-        if (minimize) {
-            for (int m = 1; m < length_m; ++m) {
-                float diag = (smat(m,0) * diag_factor ) - init_penalty;  // drop in from left side
-                float top  = (smat(m,0) * gap_factor) + tmp_asmat(m - 1,0) - gap_penalty[(tmp_gapmat(m - 1,0))];
-                float best_val;
-                int best_pos;
-
-                // If minimize:
-                if (diag <= top) { best_pos = 0; best_val = diag; }
-                else { best_pos = 1; best_val = top; }
-
-                // Set the gap matrix:
-                if (best_pos == 1) { tmp_gapmat(m,0) = tmp_gapmat(m - 1,0) + 1; }
-                else { tmp_gapmat(m,0) = 0; }  
-                tmp_asmat(m,0) = best_val; tmp_tb(m,0)  = best_pos;
-            }
-            for (int n = 1; n < length_n; ++n) {
-                float diag = (smat(0,n) * diag_factor) - init_penalty;  // drop in from top
-                float left = (smat(0,n) * gap_factor) + tmp_asmat(0,n - 1) - gap_penalty[(tmp_gapmat(0,n -1))];
-                float best_val;
-                int best_pos;
-
-                if (diag <= left) { best_pos = 0; best_val = diag; }
-                else { best_pos = 2; best_val = left; }
-
-                // Set the gap matrix:
-                if (best_pos == 2) { tmp_gapmat(0,n) = tmp_gapmat(0,n - 1) + 1; }
-                else { tmp_gapmat(0,n) = 0; }
-                tmp_asmat(0,n) = best_val; tmp_tb(0,n)  = best_pos;
-            }
-        }
-        else {  // maximize:
-            for (int m = 1; m < length_m; ++m) {
-                float diag = (smat(m,0) * diag_factor) - init_penalty;  // drop in from left side
-                float top  = (smat(m,0) * gap_factor) + tmp_asmat(m - 1,0) - gap_penalty[(tmp_gapmat(m - 1,0))];
-                float best_val;
-                int best_pos;
-
-                // If !minimize:
-                if (diag >= top) { best_pos = 0; best_val = diag; }
-                else { best_pos = 1; best_val = top; }
-
-                // Set the gap matrix:
-                if (best_pos == 1) { tmp_gapmat(m,0) = tmp_gapmat(m - 1,0) + 1; }
-                else { tmp_gapmat(m,0) = 0; }  
-                tmp_asmat(m,0) = best_val; tmp_tb(m,0)  = best_pos;
-            }
-            for (int n = 1; n < length_n; ++n) {
-                float diag = (smat(0,n) * diag_factor) - init_penalty;  // drop in from top
-                float left = (smat(0,n) * gap_factor) + tmp_asmat(0,n - 1) - gap_penalty[(tmp_gapmat(0,n -1))];
-                float best_val;
-                int best_pos;
-
-                if (diag >= left) { best_pos = 0; best_val = diag; }
-                else { best_pos = 2; best_val = left; }
-
-                // Set the gap matrix:
-                if (best_pos == 2) { tmp_gapmat(0,n) = tmp_gapmat(0,n - 1) + 1; }
-                else { tmp_gapmat(0,n) = 0; }
-                tmp_asmat(0,n) = best_val; tmp_tb(0,n)  = best_pos;
+    for (int m = 0; m < rows; ++m) {
+        float* smat_row = smat.rowData(m);
+        unsigned char* tb_row = &tmp_tb[m * width];
+        int offset = first[m];
+        int prev_first = m > 0 ? first[m - 1] : 0;
+        int prev_last = m > 0 ? last[m - 1] : -1;
+        for (int n = first[m]; n <= last[m]; ++n) {
+            float best_val; int best_pos;
+            float smat_at_ind = smat_row[n - offset];
+            if (m == 0 && n == 0) {
+                // Initialize top left cell:
+                best_val = smat_at_ind;
+                best_pos = 0;
             }
-        }
-    }
-    // COMPLETE the tmp_asmat:
-    if (minimize) {  // complete the asmat with MINIMIZE!
-        for (int m = 1; m < length_m; ++m) {
-            for (int n = 1; n < length_n; ++n) {
-                float best_val; int best_pos;
-                float smat_at_ind = smat(m,n);
-                // MINIMIZE: 
+            else {
                 float smat_at_ind_times_gap_factor = smat_at_ind * gap_factor;
-                //DynProg::_min(diag, top, left, best_val, best_pos);
-                DynProg::_min(
-                        (smat_at_ind * diag_factor) + tmp_asmat(m-1,n-1),
-                        smat_at_ind_times_gap_factor + tmp_asmat(m-1,n) - gap_penalty[tmp_gapmat(m-1,n)],
-                        smat_at_ind_times_gap_factor + tmp_asmat(m,n-1) - gap_penalty[tmp_gapmat(m,n-1)],
-                        best_val, best_pos
-                        );
-                // SET the gap_length_matrix
-                if (best_pos == 1) { tmp_gapmat(m,n) = tmp_gapmat(m-1,n) + 1; }
-                else if (best_pos == 2) { tmp_gapmat(m,n) = tmp_gapmat(m,n-1) + 1; }
-                else { tmp_gapmat(m,n) = 0; }
-                tmp_tb(m,n) = best_pos; tmp_asmat(m,n) = best_val;
+                float diag = unavailable;
+                float top = unavailable;
+                float left = unavailable;
+                if (m > 0 && n > prev_first && n - 1 <= prev_last) {
+                    diag = (smat_at_ind * diag_factor) + prev_asmat[n - 1];
+                }
+                else if (local && (m == 0 || n == 0)) {
+                    // LOCAL: drop in from the left or top side
+                    diag = (smat_at_ind * diag_factor) - init_penalty;
+                }
+                if (m > 0 && n >= prev_first && n <= prev_last) {
+                    top = smat_at_ind_times_gap_factor + prev_asmat[n] - gap_penalty[prev_gapmat[n]];
+                }
+                if (n > first[m]) {
+                    left = smat_at_ind_times_gap_factor + tmp_asmat[n - 1] - gap_penalty[tmp_gapmat[n - 1]];
+                }
+                if (minimize) {
+                    DynProg::_min(diag, top, left, best_val, best_pos);
+                }
+                else {
+                    DynProg::_max(diag, top, left, best_val, best_pos);
+                }
             }
+            // SET the gap_length_matrix
+            if (best_pos == 1) { tmp_gapmat[n] = prev_gapmat[n] + 1; }
+            else if (best_pos == 2) { tmp_gapmat[n] = tmp_gapmat[n - 1] + 1; }
+            else { tmp_gapmat[n] = 0; }
+            tb_row[n - offset] = best_pos; tmp_asmat[n] = best_val;
         }
-    }
-    else { // complete the asmat with MAXIMIZE!
-        for (int m = 1; m < length_m; ++m) {
-            for (int n = 1; n < length_n; ++n) {
-                float best_val; int best_pos;
-                float smat_at_ind = smat(m,n);
-                // MAXIMIZE: 
-                float smat_at_ind_times_gap_factor = smat_at_ind * gap_factor;
-                //DynProg::_max(diag, top, left, best_val, best_pos);
-                DynProg::_max(
-                        ( smat_at_ind * diag_factor ) + tmp_asmat(m-1,n-1),
-                        smat_at_ind_times_gap_factor + tmp_asmat(m-1,n) - gap_penalty[tmp_gapmat(m-1,n)],
-                        smat_at_ind_times_gap_factor + tmp_asmat(m,n-1) - gap_penalty[tmp_gapmat(m,n-1)],
-                        best_val, best_pos
-                        );
-                // SET the gap_length_matrix
-                if (best_pos == 1) { tmp_gapmat(m,n) = tmp_gapmat(m-1,n) + 1; }
-                else if (best_pos == 2) { tmp_gapmat(m,n) = tmp_gapmat(m,n-1) + 1; }
-                else { tmp_gapmat(m,n) = 0; }
-                tmp_tb(m,n) = best_pos; tmp_asmat(m,n) = best_val;
+
+        if (local && last[m] == cols - 1) {
+            float val = tmp_asmat[cols - 1];
+            if (best_right_m == -1 ||
+                (minimize ? val <= best_right : val >= best_right)) {
+                best_right = val;
+                best_right_m = m;
             }
         }
+        std::swap(prev_asmat, tmp_asmat);
+        std::swap(prev_gapmat, tmp_gapmat);
     }
     //  ************************************************************
     //  * END CALC ADD SCORE MATRIX
@@ -1292,15 +1411,29 @@ void DynProg::find_path(MatF& smat, VecF &gap_penalty, int minimize, float diag_
     int optimal_m;
     int optimal_n;
     if (local) {
-        if (minimize) {
-            bestscore = DynProg::_global_min(tmp_asmat, optimal_m, optimal_n);
+        // Fetch the best value on the right and bottom sides
+        float best_bottom = prev_asmat[first[rows - 1]];
+        int best_bottom_n = first[rows - 1];
+        for (int n = first[rows - 1]; n <= last[rows - 1]; ++n) {
+            float val = prev_asmat[n];
+            if (minimize ? val <= best_bottom : val >= best_bottom) {
+                best_bottom = val;
+                best_bottom_n = n;
+            }
+        }
+        if (minimize ? best_right < best_bottom : best_right > best_bottom) {
+            bestscore = best_right;
+            optimal_m = best_right_m;
+            optimal_n = cols - 1;
         }
         else {
-            bestscore = DynProg::_global_max(tmp_asmat, optimal_m, optimal_n);
+            bestscore = best_bottom;
+            optimal_m = rows - 1;
+            optimal_n = best_bottom_n;
         }
     }
     else {  //global
-        bestscore = tmp_asmat(rows - 1, cols - 1);
+        bestscore = prev_asmat[cols - 1];
         optimal_m = rows - 1;
         optimal_n = cols - 1;
     }
@@ -1310,8 +1443,7 @@ void DynProg::find_path(MatF& smat, VecF &gap_penalty, int minimize, float diag_
         gap_penalty *= -1.f;
     }
 
-    _traceback(tmp_tb, smat, optimal_m, optimal_n, tmp_tbpath, _mCoords, _nCoords, _sCoords); 
-    int _equivLastInd = _mCoords.dim()-1;
-    _bestScore = tmp_asmat(_mCoords[_equivLastInd],_nCoords[_equivLastInd]);
+    _traceback(tmp_tb, smat, first, optimal_m, optimal_n, _mCoords, _nCoords, _sCoords); 
+    _bestScore = bestscore;
 }
 
@@ -3,6 +3,8 @@
 
 #include "math.h"
 
+#include <vector>
+
 #include "vec.h"
 #include "mat.h"
 
@@ -25,8 +27,30 @@ class DynProg {
         VecF _sCoords;
         float _bestScore; // the scores at each m,n coordinate!
         float _prob;
+
+        // Optional band of the score matrix. Row m only holds the scores of
+        // columns _band_start[m] to _band_end[m] of the full matrix, stored
+        // from its first column on, in a matrix as wide as the widest row of
+        // the band. Both are empty when the full matrix is used.
+        std::vector<int> _band_start;
+        std::vector<int> _band_end;
+        int _band_cols;  // columns of the full matrix
        
-        DynProg() { DEFAULT_GAP_PENALTY_SLOPE = 2.f; }
+        DynProg() { DEFAULT_GAP_PENALTY_SLOPE = 2.f; _band_cols = 0; }
+
+        // Restricts score(), std_normal() and find_path() to a band of the
+        // (start.size() x cols) score matrix, which is widened where needed so
+        // that it holds a path from the top left to the bottom right corner.
+        // An empty band restores the full matrix.
+        void set_band(std::vector<int> &start, std::vector<int> &end, int cols);
+        bool banded() const { return !_band_start.empty(); }
+        // first and last column of every row of a (rows x cols) score matrix,
+        // from the band if one is set
+        void band_bounds(int rows, int cols, std::vector<int> &start, std::vector<int> &end);
+
+        // Shifts and scales the scores (of the band) to a mean of zero and a
+        // standard deviation of one, unless they are all equal
+        void std_normal(MatF &smat);
 
         // If gap_penalty array len = 0, then a linear gap penalty based on the
         // average matrix score will be used
@@ -84,6 +108,7 @@ class DynProg {
         // mCoords run | 
         //             V
         //             scans along the y axis
+        // If a band is set, only the scores within it are calculated.
         void score_product(MatF &mCoords, MatF &nCoords, MatF &scores);
         void score_covariance(MatF &mCoords, MatF &nCoords, MatF &scores);
         void score_pearsons_r(MatF &mCoords, MatF &nCoords, MatF &scores);
@@ -92,6 +117,10 @@ class DynProg {
         void score_euclidean(MatF &mCoords, MatF &nCoords, MatF &scores);
         // convenience method for scoring
         void score(MatF &mCoords, MatF &nCoords, MatF &scores, const char *type, int mi_num_bins=2);
+        // keeps only the scores of a full matrix that lie within the band
+        void crop_to_band(MatF &scores);
+        // mean and sample standard deviation of the scores (of the band)
+        void score_stats(MatF &smat, double &mean, double &std_dev);
 							 
 //   DynProg::expandFlag(mat1, 2, 1)
 //   
@@ -1,7 +1,8 @@
 #include "obiwarp.h"
 
 ObiParams::ObiParams(string score,bool local, float factor_diag, float factor_gap, float gap_init,float gap_extend,
-            float init_penalty, float response, bool nostdnrm, float binSize){
+            float init_penalty, float response, bool nostdnrm, float binSize,
+            bool dropEmptyColumns, float maxRtShift){
 
     this->score = score;
     this->local = local;
@@ -13,6 +14,8 @@ ObiParams::ObiParams(string score,bool local, float factor_diag, float factor_ga
     this->response = response;
     this->nostdnrm = nostdnrm;
     this->binSize = binSize;
+    this->dropEmptyColumns = dropEmptyColumns;
+    this->maxRtShift = maxRtShift;
 }
 
 ObiWarp::ObiWarp(ObiParams *obiParams){
@@ -26,13 +29,15 @@ ObiWarp::ObiWarp(ObiParams *obiParams){
     this->init_penalty = obiParams->init_penalty;
     this->response = obiParams->response;
     this->nostdnrm = obiParams->nostdnrm;
+    this->dropEmptyColumns = obiParams->dropEmptyColumns;
+    this->maxRtShift = obiParams->maxRtShift;
 }
 
 ObiWarp::~ObiWarp(){
 
 }
 
-void ObiWarp::setReferenceData(vector<float> &rtPoints, vector<float> &mzPoints, vector<vector<float> >& intMat){
+void ObiWarp::setReferenceData(vector<float> &rtPoints, vector<float> &mzPoints, MatF& intMat){
     tmPoint = rtPoints;
     _tm_vals = tmPoint.size();
     _tm.take(_tm_vals, tmPoint);
@@ -41,47 +46,46 @@ void ObiWarp::setReferenceData(vector<float> &rtPoints, vector<float> &mzPoints,
     _mz_vals = mzPoint.size();
     _mz.take(_mz_vals, mzPoint);
 
-    assert(_tm_vals == intMat.size());
-    MatF mat(_tm_vals, _mz_vals);
-    for(int i=0; i < _tm_vals; ++i){
-        assert(_mz_vals == intMat[i].size());
-        for(int j = 0; j < _mz_vals; ++j)
-            mat(i,j) = intMat[i][j];
-    }
-    _mat.take(mat);
+    assert(_tm_vals == intMat.rows());
+    assert(_mz_vals == intMat.cols());
+    _mat.take(intMat);
 
 }
 
-vector<float> ObiWarp::align(vector<float> &rtPoints, vector<float> &mzPoints, vector<vector<float> >& intMat){
+vector<float> ObiWarp::align(vector<float> &rtPoints, MatF& mat){
     
     VecF tm;
     vector<float> tmPoint(rtPoints);
     int tm_vals = tmPoint.size();
     tm.take(tm_vals, tmPoint);
 
-    VecF mz;
-    vector<float> mzPoint(mzPoints);
-    int mz_vals = mzPoint.size();
-    mz.take(mz_vals, mzPoint);
-
-    assert(tm_vals = intMat.size());
-    MatF mat(tm_vals, mz_vals);
-    for(int i = 0; i < tm_vals; ++i){
-        assert(mz_vals == intMat[i].size());
-        for(int j = 0; j < mz_vals; ++j)
-            mat(i,j)=intMat[i][j];
+    assert(tm_vals == mat.rows());
+    assert(_mz_vals == mat.cols());
+
+    // per call, so that samples can be aligned in parallel
+    DynProg dyn;
+    if (maxRtShift > 0) {
+        vector<int> bandStart;
+        vector<int> bandEnd;
+        rtShiftBand(_tm, tm, maxRtShift, bandStart, bandEnd);
+        dyn.set_band(bandStart, bandEnd, tm_vals);
     }
 
     MatF smat;
-    dyn.score(_mat, mat, smat, score);
+    if (dropEmptyColumns) {
+        MatF reference;
+        MatF sample;
+        keepNonEmptyColumns(_mat, mat, reference, sample);
+        dyn.score(reference, sample, smat, score);
+    } else {
+        dyn.score(_mat, mat, smat, score);
+    }
 
     if (!nostdnrm) {
-        if (!smat.all_equal()) { 
-            smat.std_normal();
-        }
+        dyn.std_normal(smat);
     }
 
-    int gp_length = smat.rows() + smat.cols();
+    int gp_length = _tm_vals + tm_vals;
 
     VecF gp_array;
     dyn.linear_less_before(gap_extend,gap_init,gp_length,gp_array);
@@ -111,6 +115,66 @@ vector<float> ObiWarp::align(vector<float> &rtPoints, vector<float> &mzPoints, v
 }
 
 
+void ObiWarp::keepNonEmptyColumns(MatF& first, MatF& second, MatF& firstOut, MatF& secondOut){
+    int cols = first.cols();
+    vector<char> nonEmpty(cols, 0);
+    for (int i = 0; i < first.rows(); ++i) {
+        float* row = first.rowData(i);
+        for (int j = 0; j < cols; ++j)
+            nonEmpty[j] |= (row[j] != 0.0f);
+    }
+    for (int i = 0; i < second.rows(); ++i) {
+        float* row = second.rowData(i);
+        for (int j = 0; j < cols; ++j)
+            nonEmpty[j] |= (row[j] != 0.0f);
+    }
+
+    vector<int> kept;
+    for (int j = 0; j < cols; ++j) {
+        if (nonEmpty[j])
+            kept.push_back(j);
+    }
+    // keep a column to score against even if both are empty
+    if (kept.empty())
+        kept.push_back(0);
+
+    int keptCols = kept.size();
+    MatF firstKept(first.rows(), keptCols);
+    for (int i = 0; i < first.rows(); ++i) {
+        float* row = first.rowData(i);
+        float* out = firstKept.rowData(i);
+        for (int j = 0; j < keptCols; ++j)
+            out[j] = row[kept[j]];
+    }
+    MatF secondKept(second.rows(), keptCols);
+    for (int i = 0; i < second.rows(); ++i) {
+        float* row = second.rowData(i);
+        float* out = secondKept.rowData(i);
+        for (int j = 0; j < keptCols; ++j)
+            out[j] = row[kept[j]];
+    }
+    firstOut.take(firstKept);
+    secondOut.take(secondKept);
+}
+
+void ObiWarp::rtShiftBand(VecF& refTimes, VecF& times, float maxShift, vector<int>& start, vector<int>& end){
+    int rows = refTimes.length();
+    int cols = times.length();
+    start.assign(rows, 0);
+    end.assign(rows, -1);
+    // both time axes are sorted, so the band only moves forward
+    int first = 0;
+    int last = -1;
+    for (int m = 0; m < rows; ++m) {
+        while (first < cols && times[first] < refTimes[m] - maxShift)
+            ++first;
+        while (last + 1 < cols && times[last + 1] <= refTimes[m] + maxShift)
+            ++last;
+        start[m] = first;
+        end[m] = last;
+    }
+}
+
 bool ObiWarp::tm_axis_vals(VecI &tmCoords, VecF &tmVals,VecF &_tm ,int _tm_vals){
     VecF tmp(tmCoords.length());
     for (int i = 0; i < tmCoords.length(); ++i) {
@@ -13,7 +13,8 @@ using namespace std;
 
 struct ObiParams{
     ObiParams(string score,bool local, float factor_diag, float factor_gap, float gap_init,float gap_extend,
-            float init_penalty, float response, bool nostdnrm, float binSize);
+            float init_penalty, float response, bool nostdnrm, float binSize,
+            bool dropEmptyColumns = false, float maxRtShift = 0.0f);
 
     string score;
     bool local;
@@ -25,15 +26,40 @@ struct ObiParams{
     float response;
     bool nostdnrm;
     float binSize;
+
+    // m/z bins without any intensity in both the reference and the aligned
+    // sample are left out of the score matrix. This is faster for sparse
+    // data, but changes the scores of "cor" and "cov" as they depend on the
+    // number of bins
+    bool dropEmptyColumns;
+
+    // largest retention time difference, in minutes, between scans that may
+    // be matched. Only the band of the score matrix within this difference
+    // is scored and searched for the warping path, which keeps time and
+    // memory linear in the number of scans for long runs. Not used if zero
+    float maxRtShift;
 };
 
+/**
+ * Aligns samples to a reference sample. Once the reference data is set, it is
+ * only read by `align`, which keeps all of its dynamic programming state on
+ * its own stack. Several samples can therefore be aligned concurrently
+ * against the same ObiWarp object.
+ */
 class ObiWarp{
 public:
     ObiWarp(ObiParams *obiParams);
     ~ObiWarp();
-    void setReferenceData(vector<float> &rtPoints, vector<float> &mzPoints, vector<vector<float> >& intMat);
-    vector<float> align(vector<float> &rtPoints, vector<float> &mzPoints, vector<vector<float> >& intMat);
+    // intMat has one row per retention time and one column per m/z bin
+    void setReferenceData(vector<float> &rtPoints, vector<float> &mzPoints, MatF& intMat);
+    // intMat has the same m/z bins as the reference data
+    vector<float> align(vector<float> &rtPoints, MatF& intMat);
 private:
+    // copy the columns of two matrices where either has a non-zero value
+    static void keepNonEmptyColumns(MatF& first, MatF& second, MatF& firstOut, MatF& secondOut);
+    // first and last sample scan within maxShift of every reference scan
+    static void rtShiftBand(VecF& refTimes, VecF& times, float maxShift, vector<int>& start, vector<int>& end);
+
     bool tm_axis_vals(VecI &tmCoords, VecF &tmVals,VecF &_tm ,int _tm_vals);
     void warp_tm(VecF &selfTimes, VecF &equivTimes, VecF &_tm);
     VecF _tm;
@@ -43,7 +69,6 @@ private:
     int _mz_vals;
     std::vector<float> tmPoint;
     std::vector<float> mzPoint;
-    DynProg dyn;
 
     char* score;
     bool local;
@@ -54,6 +79,8 @@ private:
     float init_penalty;
     float response;
     bool nostdnrm;
+    bool dropEmptyColumns;
+    float maxRtShift;
 
 };
 
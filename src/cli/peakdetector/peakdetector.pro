@@ -49,6 +49,7 @@ unix: LIBS += -lboost_system -lboost_filesystem -lsqlite3
 win32: LIBS += -lboost_system-mt -lboost_filesystem-mt -lsqlite3
 
 !macx: LIBS += -fopenmp
+!macx: QMAKE_CXXFLAGS += -fopenmp
 
 macx {
     DYLIBPATH = $$system(source ~/.bash_profile ; echo $LDFLAGS)
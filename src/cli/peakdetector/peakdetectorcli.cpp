@@ -28,6 +28,7 @@ PeakDetectorCLI::PeakDetectorCLI(Logger* log,
     saveJsonEIC = false;
     quantitationType = PeakGroup::AreaTop;
     alignMode = AlignmentMode::None;
+    loadThreads = 0;
     _reduceGroupsFlag = true;
     _parseOptions = new ParseOptions();
     _dlManager = new DownloadManager;
@@ -233,6 +234,10 @@ void PeakDetectorCLI::processOptions(int argc, char* argv[])
             _projectName = QString(optarg);
             break;
 
+        case 't':
+            loadThreads = atoi(optarg);
+            break;
+
         case 'v':
             mavenParameters->ionizationMode = atoi(optarg);
             break;
@@ -557,6 +562,9 @@ void PeakDetectorCLI::_processGeneralArgsXML(xml_node& generalArgs)
         } else if (strcmp(node.name(), "pollyExtra") == 0) {
             _pollyExtraInfo = QString(node.attribute("value").value());
 
+        } else if (strcmp(node.name(), "loadThreads") == 0) {
+            loadThreads = atoi(node.attribute("value").value());
+
         } else if (strcmp(node.name(), "samples") == 0) {
             string sampleStr = node.attribute("value").value();
             if (QFile::exists(QString::fromStdString(sampleStr))) {
@@ -649,26 +657,48 @@ void PeakDetectorCLI::loadSamples(vector<string>& filenames)
 #endif
     _log->info() << "Loading samples…" << std::flush;
 
-    for (unsigned int i = 0; i < filenames.size(); i++) {
+    int numThreads = _sampleLoadingThreads(filenames);
+    if (numThreads > 1) {
+        _log->info() << "Loading up to "
+                     << numThreads
+                     << " samples in parallel"
+                     << std::flush;
+    }
+
+    // samples and failure messages are stored at the index of their file, so
+    // that the outcome is reported in the same order as the input files
+    int numFiles = static_cast<int>(filenames.size());
+    vector<mzSample*> loaded(numFiles, nullptr);
+    vector<string> errors(numFiles, "");
+
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    for (int i = 0; i < numFiles; i++) {
         mzSample* sample = new mzSample();
         try {
             sample->loadSample(filenames[i].c_str());
         } catch (const std::bad_alloc&) {
-            cerr << "MemoryError: " << "ran out of memory" << endl;
+            errors[i] = "ran out of memory";
             mzUtils::delete_all(sample->scans);
         }
         if (!sample->scans.empty()) {
             sample->sampleName = mzUtils::cleanFilename(filenames[i]);
             sample->isSelected = true;
+            loaded[i] = sample;
+        } else {
+            delete sample;
+        }
+    }
+
+    for (int i = 0; i < numFiles; i++) {
+        mzSample* sample = loaded[i];
+        if (sample != nullptr) {
             mavenParameters->samples.push_back(sample);
             _log->info() << "Loaded sample: "
                          << sample->getSampleName()
                          << std::flush;
         } else {
-            if (sample != NULL) {
-                delete sample;
-                sample = NULL;
-            }
+            if (!errors[i].empty())
+                cerr << "MemoryError: " << errors[i] << endl;
             _log->info() << "Failed to load file: "
                          << filenames[i]
                          << std::flush;
@@ -697,6 +727,45 @@ void PeakDetectorCLI::loadSamples(vector<string>& filenames)
 #endif
 }
 
+int PeakDetectorCLI::_sampleLoadingThreads(const vector<string>& filenames)
+{
+    if (filenames.size() < 2)
+        return 1;
+
+    // netCDF reader is not thread-safe
+    for (const auto& filename : filenames) {
+        QString file = QString::fromStdString(filename);
+        if (file.endsWith(".nc", Qt::CaseInsensitive)
+            || file.endsWith(".cdf", Qt::CaseInsensitive)) {
+            return 1;
+        }
+    }
+
+    int numThreads = loadThreads;
+    if (numThreads <= 0)
+        numThreads = mzUtils::numSystemCpus();
+    numThreads = min(numThreads, static_cast<int>(filenames.size()));
+    if (numThreads <= 1)
+        return 1;
+
+    // every loaded sample stays in memory, while each file being parsed
+    // additionally needs about its own size for the document being read
+    qint64 cumulativeSize = 0;
+    qint64 largestFileSize = 0;
+    for (const auto& filename : filenames) {
+        QFileInfo info(QString::fromStdString(filename));
+        cumulativeSize += info.size();
+        largestFileSize = max(largestFileSize, info.size());
+    }
+    qint64 totalMemory = mzUtils::availableSystemMemory();
+    while (numThreads > 1
+           && (cumulativeSize * 1.5) + (numThreads * largestFileSize)
+                  >= totalMemory) {
+        --numThreads;
+    }
+    return numThreads;
+}
+
 void PeakDetectorCLI::alignSamples(const int& method)
 {
     if (mavenParameters->samples.size() > 1) {
@@ -707,7 +776,9 @@ void PeakDetectorCLI::alignSamples(const int& method)
             // instead of using obi params make use mavenParameters to access all
             // the values.
             ObiParams params(
-                "cor", false, 2.0, 1.0, 0.20, 3.40, 0.0, 20.0, false, 0.60);
+                "cor", false, 2.0, 1.0, 0.20, 3.40, 0.0, 20.0, false, 0.60,
+                mavenParameters->obiWarpDropEmptyColumns,
+                mavenParameters->obiWarpMaxRtShift);
             Aligner mzAligner;
             mzAligner.alignWithObiWarp(
                 mavenParameters->samples, &params, mavenParameters);
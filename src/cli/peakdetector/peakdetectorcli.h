@@ -71,6 +71,9 @@ public:
     QString pollyArgs;
     AlignmentMode alignMode;
 
+    /** number of sample files loaded in parallel, 0 to use all cores */
+    int loadThreads;
+
     PeakDetectorCLI(Logger* log,
                     Analytics* analytics,
                     int argc = 0,
@@ -111,8 +114,12 @@ public:
     void loadCompoundsFile();
 
     /**
-     * [loadSamples description]
-     * @param filenames [description]
+     * @brief Load the given sample files into mavenParameters->samples.
+     * @details Files are loaded in parallel, by at most `loadThreads`
+     * threads and no more than the system memory can hold at once. Files
+     * that fail to load are reported and skipped. Loaded samples are sorted
+     * using mzSample::compSampleSort, independent of the loading order.
+     * @param filenames Paths of the sample files.
      */
     void loadSamples(vector<string>& filenames);
 
@@ -208,6 +215,8 @@ public:
                 "<name>.emDB project. If given <name> contains the string "
                 "\".raw\" in it, the emDB will be saved with raw peak data. "
                 "<string>",
+            "t?loadThreads: Enter number of sample files to load in parallel, "
+                "0 to use all available cores. <int>",
             "v?ionizationMode: Enter 0, -1 or 1 ionization mode. <int>",
             "w?minPeakWidth: Enter min peak width threshold in a group. <int>",
             "x?xml: Enter full path to the config file or a settings file from "
@@ -267,6 +276,16 @@ private:
      */
     void _processGeneralArgsXML(xml_node& generalArgs);
 
+    /**
+     * @brief Decide how many sample files can be loaded at the same time.
+     * @details Bounded by `loadThreads` (or the number of cores) and reduced
+     * until the files being loaded are expected to fit in system memory.
+     * Loading is serial for netCDF files.
+     * @param filenames Paths of the sample files to be loaded.
+     * @return Number of threads to load samples with.
+     */
+    int _sampleLoadingThreads(const vector<string>& filenames);
+
     void _groupReduction();
 
     QStringList _getSampleList();
@@ -309,6 +328,7 @@ struct Arguments
         generalArgs << "int" << "saveEicJson" << "0";
         generalArgs << "string" << "outputdir" << "0";
         generalArgs << "string" << "pollyExtra" << "";
+        generalArgs << "int" << "loadThreads" << "0";
         generalArgs << "string" << "samples" << "path/to/sample1";
         generalArgs << "string" << "samples" << "path/to/sample2";
         generalArgs << "string" << "samples" << "path/to/sample3";
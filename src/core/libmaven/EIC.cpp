@@ -5,7 +5,8 @@
 #include "mavenparameters.h"
 #include "mzPatterns.h"
 #include "mzSample.h"
-#include "SavGolSmoother.h"
+#include "aslssolver.h"
+#include "smoothingengine.h"
 #include "Scan.h"
 
 /**
@@ -78,7 +79,7 @@ EIC *EIC::eicMerge(const vector<EIC *> &eics)
     vector<float> intensity(maxlen, 0);
     vector<float> rt(maxlen, 0);
     vector<int> scans(maxlen, 0);
-    vector<float> mz(maxlen, 0);
+    vector<mzValue> mz(maxlen, 0);
     vector<int> mzcount(maxlen, 0);
 
     //smoothing   //initalize time array
@@ -164,7 +165,7 @@ void EIC::_computeAsLSBaseline(const float lambda,
                                const float p,
                                const int numIterations)
 {
-    // Eigen behaves better with double values compared to float
+    // the solver works with double values for better numerical stability
     vector<double> intensity;
     for(unsigned int i = 0; i < this->intensity.size(); ++i)
         intensity.push_back(static_cast<double>(this->intensity[i]));
@@ -175,76 +176,14 @@ void EIC::_computeAsLSBaseline(const float lambda,
     auto resamplingFactor = mzUtils::approximateResamplingFactor(originalSize);
     intensity = mzUtils::resample(intensity, 1, resamplingFactor);
 
-    using namespace Eigen;
-    auto n = static_cast<unsigned int>(intensity.size());
-
-    // Perform difference operation (pseudo-differentiation) on a sparse matrix
-    auto diff = [](Eigen::SparseMatrix<double> mat)
-    {
-        Eigen::SparseMatrix<double> E1 = mat.block(0,
-                                                   0,
-                                                   mat.rows() - 1,
-                                                   mat.cols());
-        Eigen::SparseMatrix<double> E2 = mat.block(1,
-                                                   0,
-                                                   mat.rows() - 1,
-                                                   mat.cols());
-        return Eigen::SparseMatrix<double>(E2 - E1);
-    };
-
-    // create a sparse identity matrix of size `n`
-    Eigen::SparseMatrix<double> ident(n, n);
-    ident.setIdentity();
-
-    // compute approximate second derivative of the identity matrix
-    auto D = diff(diff(ident));
-
-    // create a weights vector of length `n` initially containing only ones
-    // for coefficients
-    auto w = VectorXd(ArrayXd::Ones(n));
-
-    // instantiate a Cholesky decomposition linear solver for sparse matrices
-    SimplicialCholesky<SparseMatrix<double>> solver;
-
-    // instantiate a vector for intensity and one to store baseline
-    VectorXd intensityVec = Map<VectorXd>(intensity.data(), n);
-    VectorXd baselineVec;
-
-    // helper matrices for `select` operation used when creating binary vectors
-    auto ones = VectorXd(MatrixXd::Ones(n, 1));
-    auto zeros = VectorXd(MatrixXd::Zero(n, 1));
-
-    // TODO: ideally this should converge to a point where the baseline does
-    // not change anymnore, but since we do not have good float comparators
-    // yet we can use a decent number of iterations to get as close to the true
-    // baseline as possible
-    for (int i=0; i < numIterations; ++i) {
-        // create a square matrix 'W' with the weights as its diagonal
-        auto W = SparseMatrix<double>(w.asDiagonal());
-
-        // compute 'A' and 'b', and then solve for 'x' that satisfies the
-        // equation 'A·x = b', where x will be the iteratively estimated
-        // baseline
-        auto A = W + (lambda * (D.transpose() * D));
-        solver.compute(A);
-        auto b = VectorXd(w.array() * intensityVec.array());
-        baselineVec = solver.solve(b);
-
-        // calculate weights for the next iteration
-        auto gtBin = VectorXd(
-            ((intensityVec - baselineVec).array() > 0.0).select(ones, zeros)
-        );
-        auto ltBin = VectorXd(
-            ((intensityVec - baselineVec).array() < 0.0).select(ones, zeros)
-        );
-        w = (p * gtBin) + ((1.0f - p) * ltBin);
-    }
-
-    // copy data from an Eigen vector to std::vector
-    vector<double> tempVector(baselineVec.data(),
-                              baselineVec.data()
-                              + baselineVec.rows()
-                              * baselineVec.cols());
+    // the system solved at each iteration is pentadiagonal, a banded solver
+    // factorizes it in linear time; iterations stop once weights settle
+    vector<double> tempVector;
+    mzUtils::AsLSSolver::forCurrentThread().solve(intensity,
+                                                  lambda,
+                                                  p,
+                                                  numIterations,
+                                                  tempVector);
 
     // interpolate the signal after possible decimation
     tempVector = mzUtils::resample(tempVector, resamplingFactor, 1);
@@ -371,8 +310,6 @@ void EIC::computeSpline(int smoothWindow)
     try
     {
         this->spline = new float[n];
-        for (int i = 0; i < n; i++)
-            spline[i] = 0;
     }
     catch (...)
     {
@@ -388,24 +325,19 @@ void EIC::computeSpline(int smoothWindow)
     if (smoothWindow <= 1)
         return; //nothing to smooth get out
 
+    // kernels and buffers are kept by the engine across EICs of a thread
+    auto& smoother = mzUtils::SmoothingEngine::forCurrentThread();
     if (smootherType == SAVGOL)
     { //SAVGOL SMOOTHER
-        mzUtils::SavGolSmoother smoother(smoothWindow, smoothWindow, 4);
-        vector<float> smoothed = smoother.Smooth(intensity);
-        for (int i = 0; i < n; i++)
-            spline[i] = smoothed[i];
+        smoother.savitzkyGolay(intensity.data(), spline, n, smoothWindow, 4);
     }
     else if (smootherType == GAUSSIAN)
     { //GAUSSIAN SMOOTHER
-        gaussian1d_smoothing(n, smoothWindow, spline);
+        smoother.gaussian(spline, n, smoothWindow);
     }
     else if (smootherType == AVG)
     {
-        float *y = new float[n];
-        for (int i = 0; i < n; i++)
-            y[i] = intensity[i];
-        smoothAverage(y, spline, smoothWindow, n);
-        delete[] y;
+        smoother.movingAverage(intensity.data(), spline, n, smoothWindow);
     }
 }
 
@@ -414,7 +346,7 @@ void EIC::clearEICContents()
 {
     peaks.clear();
     std::vector<float>().swap(rt);
-    std::vector<float>().swap(mz);
+    std::vector<mzValue>().swap(mz);
     std::vector<float>().swap(intensity);
 }
 
@@ -438,7 +370,7 @@ void EIC::reduceToRtRange(float minRt, float maxRt)
         int start = distance(begin(rt), lower);
         int stop = distance(begin(rt), upper);
         rt = vector<float>(begin(rt) + start, begin(rt) + stop);
-        mz = vector<float>(begin(mz) + start, begin(mz) + stop);
+        mz = vector<mzValue>(begin(mz) + start, begin(mz) + stop);
         intensity = vector<float>(begin(intensity) + start,
                                   begin(intensity) + stop);
         scannum = vector<int>(begin(scannum) + start, begin(scannum) + stop);
@@ -470,6 +402,46 @@ void EIC::reduceToRtRange(float minRt, float maxRt)
     }
 }
 
+EIC* EIC::cloneTrace() const
+{
+    EIC* copy = new EIC();
+    copy->scannum = scannum;
+    copy->rt = rt;
+    copy->mz = mz;
+    copy->intensity = intensity;
+    copy->sampleName = sampleName;
+    copy->sample = sample;
+    std::copy(color, color + 4, copy->color);
+    copy->maxIntensity = maxIntensity;
+    copy->rtAtMaxIntensity = rtAtMaxIntensity;
+    copy->mzAtMaxIntensity = mzAtMaxIntensity;
+    copy->totalIntensity = totalIntensity;
+    copy->eic_noNoiseObs = eic_noNoiseObs;
+    copy->filterSignalBaselineDiff = filterSignalBaselineDiff;
+    copy->mzmin = mzmin;
+    copy->mzmax = mzmax;
+    copy->rtmin = rtmin;
+    copy->rtmax = rtmax;
+
+    copy->smootherType = smootherType;
+    copy->_baselineMode = _baselineMode;
+    copy->baselineSmoothingWindow = baselineSmoothingWindow;
+    copy->baselineDropTopX = baselineDropTopX;
+    copy->_aslsSmoothness = _aslsSmoothness;
+    copy->_aslsAsymmetry = _aslsAsymmetry;
+
+    size_t n = intensity.size();
+    if (baseline != nullptr) {
+        copy->baseline = new float[n];
+        std::copy(baseline, baseline + n, copy->baseline);
+    }
+    if (spline != nullptr) {
+        copy->spline = new float[n];
+        std::copy(spline, spline + n, copy->spline);
+    }
+    return copy;
+}
+
 void EIC::getPeakPositions(int smoothWindow, bool recomputeBaseline)
 {
     unsigned int N = intensity.size();
@@ -1131,7 +1103,7 @@ vector<PeakGroup> EIC::groupPeaks(vector<EIC *> &eics,
         //Feng note: fillInPeaks is unecessary
         grp.groupStatistics();
         grp.computeAvgBlankArea(eics);
-        if (grp.getFragmentationEvents().size()) {
+        if (grp.fragmentationEventCount() > 0) {
             grp.computeFragPattern(mp->fragmentTolerance);
             grp.matchFragmentation(mp->fragmentTolerance, mp->scoringAlgo);
         }
@@ -1189,146 +1161,260 @@ void EIC::getRTMinMaxPerScan()
     }
 }
 
-/**
- * This is the functon which gets the EIC of the given scan for the
- * given mzmin and mzmax. This function will go through the each scan
- * and find the the max intensity and mz corresponding to that max intensity.
- * Total intensity is calculated by adding the maxintensity from each scan.
- * @param[in] scan This is the 
- */
-bool EIC::makeEICSlice(mzSample *sample, float mzmin, float mzmax, float rtmin, float rtmax, int mslevel, int eicType, string filterline)
+void EIC::_intensityInMzRange(const mzValue *mzs,
+                              const float *intensities,
+                              size_t nobs,
+                              mzValue mzmin,
+                              mzValue mzmax,
+                              int eicType,
+                              mzValue &eicMz,
+                              float &eicIntensity)
 {
-    float eicMz = 0, eicIntensity = 0;
-    int lb, scanNum;
-    vector<float>::iterator mzItr;
-    deque<Scan *>::iterator scanItr;
-    deque<Scan *> scans;
+    eicMz = 0;
+    eicIntensity = 0;
 
-    scans = sample->scans;
-    //binary search rt domain iterator
-    Scan tmpScan(sample, 0, 1, rtmin - 0.1, 0, -1);
-    scanItr = lower_bound(scans.begin(), scans.end(), &tmpScan, Scan::compRt);
-    if (scanItr >= scans.end())
+    //binary search for the run of observations within the m/z range, which
+    //can then be reduced without any branches
+    size_t lb = lower_bound(mzs, mzs + nobs, mzmin) - mzs;
+    size_t ub = upper_bound(mzs + lb, mzs + nobs, mzmax) - mzs;
+
+    switch ((EIC::EicType)eicType)
     {
-        return false;
+
+    //takes the sum of all intensities for given m/z range in a scan
+    //associated m/z is the weighted average(with intensities as weights)
+    case EIC::SUM:
+    {
+        double sumMz = 0.0;
+        double sumIntensity = 0.0;
+#pragma omp simd reduction(+:sumMz, sumIntensity)
+        for (size_t i = lb; i < ub; i++)
+        {
+            double intensity = static_cast<double>(intensities[i]);
+            sumIntensity += intensity;
+            sumMz += static_cast<double>(mzs[i]) * intensity;
+        }
+        if (sumIntensity != 0.0) {
+            eicMz = static_cast<mzValue>(sumMz / sumIntensity);
+            eicIntensity = static_cast<float>(sumIntensity);
+        }
+        break;
+    }
+
+    //takes the maximum intensity for given m/z range in a scan
+    case EIC::MAX:
+    default:
+    {
+        float highest = 0.0f;
+#pragma omp simd reduction(max:highest)
+        for (size_t i = lb; i < ub; i++)
+            highest = intensities[i] > highest ? intensities[i] : highest;
+
+        //the m/z is that of the first observation with this intensity
+        if (highest > 0.0f) {
+            size_t i = lb;
+            while (intensities[i] != highest)
+                i++;
+            eicIntensity = highest;
+            eicMz = mzs[i];
+        }
+        break;
+    }
+    }
+}
+
+void EIC::_addEICPoint(int scanNum, float scanRt, mzValue eicMz, float eicIntensity)
+{
+    this->scannum.push_back(scanNum);
+    this->rt.push_back(scanRt);
+    this->intensity.push_back(eicIntensity);
+    this->mz.push_back(eicMz);
+    this->totalIntensity += eicIntensity;
+    if (eicIntensity > this->maxIntensity) {
+        this->maxIntensity = eicIntensity;
+        this->rtAtMaxIntensity = scanRt;
+        this->mzAtMaxIntensity = eicMz;
     }
+}
 
-    int estimatedScans = scans.size();
+void EIC::_reserveForRtRange(mzSample *sample, float rtmin, float rtmax, int scanCount)
+{
+    int estimatedScans = scanCount;
 
     //TODO: why is 10 added?
     if (sample->maxRt - sample->minRt > 0 && (rtmax - rtmin) / (sample->maxRt - sample->minRt) <= 1)
     {
 
-        estimatedScans = float(rtmax - rtmin) / (sample->maxRt - sample->minRt) * scans.size() + 10;
+        estimatedScans = float(rtmax - rtmin) / (sample->maxRt - sample->minRt) * scanCount + 10;
     }
 
     this->scannum.reserve(estimatedScans);
     this->rt.reserve(estimatedScans);
     this->intensity.reserve(estimatedScans);
     this->mz.reserve(estimatedScans);
+}
 
-    scanNum = scanItr - scans.begin() - 1;
+/**
+ * This is the functon which gets the EIC of the given scan for the
+ * given mzmin and mzmax. This function will go through the each scan
+ * and find the the max intensity and mz corresponding to that max intensity.
+ * Total intensity is calculated by adding the maxintensity from each scan.
+ * @param[in] scan This is the 
+ */
+bool EIC::makeEICSlice(mzSample *sample, mzValue mzmin, mzValue mzmax, float rtmin, float rtmax, int mslevel, int eicType, string filterline)
+{
+    return _forEachPointInSlice(
+        sample,
+        mzmin,
+        mzmax,
+        rtmin,
+        rtmax,
+        mslevel,
+        eicType,
+        filterline,
+        [&](size_t scanCount) {
+            _reserveForRtRange(sample, rtmin, rtmax, scanCount);
+        },
+        [this](int scanNum, float scanRt, mzValue eicMz, float eicIntensity) {
+            _addEICPoint(scanNum, scanRt, eicMz, eicIntensity);
+        });
+}
 
-    for (; scanItr != scans.end(); scanItr++)
-    {
-        Scan *scan = *(scanItr);
-        scanNum++;
+bool EIC::maxIntensityInSlice(mzSample *sample, mzValue mzmin, mzValue mzmax, float rtmin, float rtmax, int mslevel, int eicType, const string &filterline, float &maxIntensity, float &rtAtMax, mzValue &mzAtMax)
+{
+    maxIntensity = 0.0f;
+    rtAtMax = 0.0f;
+    mzAtMax = 0;
+    return _forEachPointInSlice(
+        sample,
+        mzmin,
+        mzmax,
+        rtmin,
+        rtmax,
+        mslevel,
+        eicType,
+        filterline,
+        [](size_t) {},
+        [&](int, float scanRt, mzValue eicMz, float eicIntensity) {
+            if (eicIntensity > maxIntensity) {
+                maxIntensity = eicIntensity;
+                rtAtMax = scanRt;
+                mzAtMax = eicMz;
+            }
+        });
+}
 
-        float precursorMz = scan->precursorMz;
+template <typename Reserve, typename Visit>
+bool EIC::_forEachPointInSlice(mzSample *sample, mzValue mzmin, mzValue mzmax, float rtmin, float rtmax, int mslevel, int eicType, const string &filterline, Reserve reserve, Visit visit)
+{
+    mzValue eicMz = 0;
+    float eicIntensity = 0;
 
-        if (!(scan->filterLine == filterline || filterline == ""))
-            continue;
-        if (scan->mslevel != mslevel)
-            continue;
-        if (precursorMz > 0.0f && (precursorMz < mzmin || precursorMz > mzmax))
-            continue;
-        if (scan->rt < rtmin)
-            continue;
-        if (scan->rt > rtmax)
-            break;
+    if (sample->hasSpectrumStore())
+    {
+        const SpectrumStore &store = sample->spectrumStore();
+        const vector<unsigned int> &rows = store.rowsAtMsLevel(mslevel);
+
+        //binary search rt domain iterator
+        auto rowItr = lower_bound(rows.begin(),
+                                  rows.end(),
+                                  rtmin,
+                                  [&store](unsigned int row, float rt) { return store.rt[row] < rt; });
+        if (rowItr == rows.end())
+        {
+            return false;
+        }
 
-        eicMz = 0;
-        eicIntensity = 0;
+        //compare filterline ids instead of strings
+        int filterLineId = -1;
+        if (filterline != "") {
+            filterLineId = store.findFilterLine(filterline);
+            if (filterLineId < 0)
+                return true;
+        }
 
-        //binary search
-        mzItr = lower_bound(scan->mz.begin(), scan->mz.end(), mzmin);
-        lb = mzItr - scan->mz.begin();
+        reserve(rows.size());
 
-        switch ((EIC::EicType)eicType)
+        for (; rowItr != rows.end(); rowItr++)
         {
+            unsigned int row = *rowItr;
+            float precursorMz = store.precursorMz[row];
+            float scanRt = store.rt[row];
 
-        //takes the maximum intensity for given m/z range in a scan
-            case EIC::MAX:
-        {
-            for (unsigned int scanIdx = lb; scanIdx < scan->nobs(); scanIdx++)
-            {
-                if (scan->mz[scanIdx] < mzmin)
-                    continue;
-                if (scan->mz[scanIdx] > mzmax)
-                    break;
+            if (filterLineId >= 0 && store.filterLineId[row] != filterLineId)
+                continue;
+            if (precursorMz > 0.0f && (precursorMz < mzmin || precursorMz > mzmax))
+                continue;
+            if (scanRt < rtmin)
+                continue;
+            if (scanRt > rtmax)
+                break;
 
-                if (scan->intensity[scanIdx] > eicIntensity)
-                {
-                    eicIntensity = scan->intensity[scanIdx];
-                    eicMz = scan->mz[scanIdx];
-                }
+            if (!sample->scanMzIndex().mayContain(row, mzmin, mzmax)) {
+                visit(row, scanRt, 0, 0.0f);
+                continue;
             }
-            break;
+
+            size_t offset = store.offsets[row];
+            _intensityInMzRange(store.mz->data() + offset,
+                                store.intensity->data() + offset,
+                                store.nobs(row),
+                                mzmin,
+                                mzmax,
+                                eicType,
+                                eicMz,
+                                eicIntensity);
+            visit(row, scanRt, eicMz, eicIntensity);
         }
+        return true;
+    }
 
-        //takes the sum of all intensities for given m/z range in a scan
-        //associated m/z is the weighted average(with intensities as weights)
-        case EIC::SUM:
-        {
-            double sumMz = 0.0;
-            double sumIntensity = 0.0;
-            for (unsigned int scanIdx = lb; scanIdx < scan->nobs(); scanIdx++)
-            {
-                if (scan->mz[scanIdx] < mzmin)
-                    continue;
-                if (scan->mz[scanIdx] > mzmax)
-                    break;
+    //scans of the requested MS level, no copy is made
+    const vector<Scan *> &scans = sample->scansAtMsLevel(mslevel);
 
-                double intensity = static_cast<double>(scan->intensity[scanIdx]);
-                sumIntensity += intensity;
-                sumMz += static_cast<double>(scan->mz[scanIdx]) * intensity;
-            }
-            if (sumIntensity != 0.0) {
-                eicMz = static_cast<float>(sumMz / sumIntensity);
-                eicIntensity = static_cast<float>(sumIntensity);
-            }
-            break;
-        }
+    //binary search rt domain iterator
+    auto scanItr = lower_bound(scans.begin(),
+                               scans.end(),
+                               rtmin,
+                               [](const Scan *scan, float rt) { return scan->rt < rt; });
+    if (scanItr == scans.end())
+    {
+        return false;
+    }
 
-        default:
-        {
-            for (unsigned int scanIdx = lb; scanIdx < scan->nobs(); scanIdx++)
-            {
-                if (scan->mz[scanIdx] < mzmin)
-                    continue;
-                if (scan->mz[scanIdx] > mzmax)
-                    break;
+    reserve(scans.size());
 
-                if (scan->intensity[scanIdx] > eicIntensity)
-                {
-                    eicIntensity = scan->intensity[scanIdx];
-                    eicMz = scan->mz[scanIdx];
-                }
-            }
+    for (; scanItr != scans.end(); scanItr++)
+    {
+        Scan *scan = *(scanItr);
+
+        float precursorMz = scan->precursorMz;
+
+        if (!(scan->filterLine == filterline || filterline == ""))
+            continue;
+        if (precursorMz > 0.0f && (precursorMz < mzmin || precursorMz > mzmax))
+            continue;
+        if (scan->rt < rtmin)
+            continue;
+        if (scan->rt > rtmax)
             break;
-        }
-        }
 
-        this->scannum.push_back(scanNum);
-        this->rt.push_back(scan->rt);
-        this->intensity.push_back(eicIntensity);
-        this->mz.push_back(eicMz);
-        this->totalIntensity += eicIntensity;
-        if (eicIntensity > this->maxIntensity) {
-            this->maxIntensity = eicIntensity;
-            this->rtAtMaxIntensity = scan->rt;
-            this->mzAtMaxIntensity = eicMz;
+        //scans without peaks near the window are not read at all
+        if (!sample->scanMayContainMz(scan, mzmin, mzmax)) {
+            visit(scan->scannum, scan->rt, 0, 0.0f);
+            continue;
         }
+
+        auto scanData = sample->loadScanData(scan);
+        _intensityInMzRange(scanData->mz.data(),
+                            scanData->intensity.data(),
+                            scanData->nobs(),
+                            mzmin,
+                            mzmax,
+                            eicType,
+                            eicMz,
+                            eicIntensity);
+        visit(scan->scannum, scan->rt, eicMz, eicIntensity);
     }
 
     return true;
@@ -56,7 +56,7 @@ class EIC
 
     vector<int> scannum;     /**< Store all scan numbers in an EIC */
     vector<float> rt;        /**< Store all retention times in an EIC */
-    vector<float> mz;        /**< Store all mass/charge ratios in an EIC */
+    vector<mzValue> mz;        /**< Store all mass/charge ratios in an EIC */
     vector<float> intensity; /**< Store all intensities in an EIC */
     vector<Peak> peaks;      /**< Store all peak objects in an EIC */
     string sampleName;       /**< Store name of the sample associated with the EIC */
@@ -76,7 +76,7 @@ class EIC
     float rtAtMaxIntensity;
 
     /* mz value of maximum intensity*/
-    float mzAtMaxIntensity;
+    mzValue mzAtMaxIntensity;
 
     float maxAreaTopIntensity; /**< maximum areaTop intensity (after baseline correction) out of all peaks */
 
@@ -118,6 +118,14 @@ class EIC
      */
     void reduceToRtRange(float minRt, float maxRt);
 
+    /**
+     * @brief Create a copy of this EIC without its peaks.
+     * @details Data points, intensity statistics, the baseline and spline (if
+     * computed) and the smoothing and baseline settings are copied.
+     * @return A new EIC object, owned by the caller.
+     */
+    EIC* cloneTrace() const;
+
     /**
     * @brief Find peak positions after smoothing, baseline calculation and peak
     * filtering.
@@ -261,7 +269,17 @@ class EIC
     * @param
     * @return bool true if EIC is pulled. false otherwise
     */
-    bool makeEICSlice(mzSample *sample, float mzmin, float mzmax, float rtmin, float rtmax, int mslevel, int eicType, string filterline);
+    bool makeEICSlice(mzSample *sample, mzValue mzmin, mzValue mzmax, float rtmin, float rtmax, int mslevel, int eicType, string filterline);
+
+    /**
+     * @brief Find the most intense point of the EIC that makeEICSlice would
+     * create for the same arguments, without creating it.
+     * @param maxIntensity Set to the highest intensity (zero if there is none).
+     * @param rtAtMax Set to the retention time of the highest intensity.
+     * @param mzAtMax Set to the m/z of the highest intensity.
+     * @return Same as makeEICSlice.
+     */
+    static bool maxIntensityInSlice(mzSample *sample, mzValue mzmin, mzValue mzmax, float rtmin, float rtmax, int mslevel, int eicType, const string &filterline, float &maxIntensity, float &rtAtMax, mzValue &mzAtMax);
 
     void getRTMinMaxPerScan();
 
@@ -327,6 +345,52 @@ class EIC
     static bool compMaxIntensity(EIC *a, EIC *b) { return a->maxIntensity > b->maxIntensity; }
 
   private:
+    /**
+     * @brief Reduce the observations of a scan within an m/z range to a
+     * single EIC point.
+     * @param mzs Sorted m/z values of the scan.
+     * @param intensities Intensity values of the scan.
+     * @param nobs Number of observations in the scan.
+     * @param mzmin Lower bound of the m/z range.
+     * @param mzmax Upper bound of the m/z range.
+     * @param eicType Type of EIC (max or sum).
+     * @param eicMz Set to the m/z of the EIC point.
+     * @param eicIntensity Set to the intensity of the EIC point.
+     */
+    static void _intensityInMzRange(const mzValue *mzs,
+                                    const float *intensities,
+                                    size_t nobs,
+                                    mzValue mzmin,
+                                    mzValue mzmax,
+                                    int eicType,
+                                    mzValue &eicMz,
+                                    float &eicIntensity);
+
+    /**
+     * @brief Append a point to the EIC and update its intensity statistics.
+     */
+    void _addEICPoint(int scanNum, float scanRt, mzValue eicMz, float eicIntensity);
+
+    /**
+     * @brief Reserve space for the points expected in an rt range.
+     */
+    void _reserveForRtRange(mzSample *sample, float rtmin, float rtmax, int scanCount);
+
+    /**
+     * @brief Compute the EIC points of a slice one at a time, reading the
+     * spectra from the columnar spectrum store of the sample if it has one.
+     * Scans that cannot have peaks in the m/z window are visited with a zero
+     * intensity, without reading their peaks.
+     * @param reserve Called with the number of scans at the MS level, before
+     * any point is visited.
+     * @param visit Called with the scan number, retention time, m/z and
+     * intensity of each point.
+     * @return False if there are no scans beyond rtmin.
+     * @see mzSample::spectrumStore
+     */
+    template <typename Reserve, typename Visit>
+    static bool _forEachPointInSlice(mzSample *sample, mzValue mzmin, mzValue mzmax, float rtmin, float rtmax, int mslevel, int eicType, const string &filterline, Reserve reserve, Visit visit);
+
     /**
      * Name of selected smoothing algorithm
      */
@@ -387,8 +451,9 @@ class EIC
      * should be passed here as integer, i.e. lambda should be in range [0, 3].
      * @param p for asymmetry. Values between 0.01 to 0.10 work reasonable well
      * for MS data.
-     * @param numIterations for the number of iterations that should be
-     * performed (since this is an iterative optimization algorithm).
+     * @param numIterations for the maximum number of iterations that should
+     * be performed (since this is an iterative optimization algorithm). Fewer
+     * are performed if the weights converge earlier.
      */
     void _computeAsLSBaseline(const float lambda,
                               const float p,
@@ -29,9 +29,11 @@ Fragment::Fragment(Scan* scan,
     this->sampleName = scan->sample->sampleName;
     this->scanNum = scan->scannum;
     this->precursorCharge = scan->precursorCharge;
-    vector<pair<float, float>> mzarray = scan->getTopPeaks(minFractionalIntensity,
-                                                           minSigNoiseRatio,
-                                                           5);
+
+    // peaks of lazily loaded samples are read back from the file
+    auto scanData = scan->sample->loadScanData(scan);
+    vector<pair<float, float>> mzarray =
+        scanData->getTopPeaks(minFractionalIntensity, minSigNoiseRatio, 5);
 
     for (unsigned int j = 0; j < mzarray.size() && j < maxFragmentSize;
             j++) {
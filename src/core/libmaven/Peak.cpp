@@ -173,7 +173,7 @@ vector<mzLink> Peak::findCovariants() {
     map<int, vector<float> >M;
     map<int, vector<float> >::iterator itr;
     for(unsigned int i=0; i<scans.size(); i++ ) {
-        Scan* _scan = scans[i];
+        auto _scan = sample->loadScanData(scans[i]);
         for(unsigned int j=0; j<_scan->nobs(); j++ ) {
             int rmz = int(_scan->mz[j]*1000);
             if (M[rmz].size()==0 )  M[rmz].resize(scanCount);
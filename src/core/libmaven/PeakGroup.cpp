@@ -164,10 +164,18 @@ void PeakGroup::copyObj(const PeakGroup& o)  {
     _tableName = o.tableName();
 
     copyChildren(o);
-    _parameters = make_shared<MavenParameters>(*(o.parameters().get()));
+    // copies share the parameters of the original, see mutableParameters()
+    _parameters = o._parameters;
     _integrationType = o.integrationType();
 }
 
+MavenParameters* PeakGroup::mutableParameters()
+{
+    if (_parameters.use_count() > 1)
+        _parameters = make_shared<MavenParameters>(*_parameters);
+    return _parameters.get();
+}
+
 PeakGroup::~PeakGroup() {
     _parameters.reset();
     clear();
@@ -873,6 +881,24 @@ vector<Scan*> PeakGroup::getFragmentationEvents()
     return matchedScans;
 }
 
+size_t PeakGroup::fragmentationEventCount()
+{
+    size_t count = 0;
+    if (!this->isMS1()) return count;
+
+    for(const auto& peak : peaks) {
+        mzSample* sample = peak.getSample();
+        if (sample == nullptr)
+            continue;
+        if (sample->ms2ScanCount() == 0)
+            continue;
+
+        mzSlice slice(minMz, maxMz, peak.rtmin, peak.rtmax);
+        count += sample->countFragmentationEvents(&slice);
+    }
+    return count;
+}
+
 void PeakGroup::computeFragPattern(float productPpmTolr)
 {
     vector<Scan*> ms2Events = getFragmentationEvents();
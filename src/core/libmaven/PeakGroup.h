@@ -252,6 +252,12 @@ class PeakGroup{
          */
         vector<Scan*> getFragmentationEvents();
 
+        /**
+         * @brief count the MS2 scans for this group, without collecting them
+         * @return number of MS2 scans found by getFragmentationEvents
+         */
+        size_t fragmentationEventCount();
+
         /**
          * @brief build a consensus fragment spectra for this group
          * @param productPpmTolr ppm tolerance for fragment m/z
@@ -624,6 +630,16 @@ class PeakGroup{
             return _parameters;
         }
 
+        /**
+         * @brief Obtain the parameters of this peak-group for modification.
+         * @details Copies of a peak-group (and all groups detected in one
+         * run) share the same parameters object, which is not meant to be
+         * modified through `parameters()`. If it is shared, this group is
+         * first given its own copy, so that the changes only apply to it.
+         * @return A pointer to parameters owned by this group alone.
+         */
+        MavenParameters* mutableParameters();
+
         IntegrationType integrationType() const { return _integrationType; }
 
         int groupId() const { return _groupId; }
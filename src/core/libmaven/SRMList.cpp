@@ -12,6 +12,7 @@ SRMList::SRMList(vector<mzSample*>samples, deque<Compound*> compoundsDB){
 
 vector<mzSlice*> SRMList::getSrmSlices(double amuQ1, double amuQ3, int userPolarity, bool associateCompoundNames) {
     QMap<QString, Scan*>seenMRMS;
+    QMap<QString, float>seenIntensity;
     int countMatches=0;
 
     vector<mzSlice*>slices;
@@ -28,11 +29,15 @@ vector<mzSlice*> SRMList::getSrmSlices(double amuQ1, double amuQ3, int userPolar
 
             if (filterLine.isEmpty()) continue;
 
+            auto scanData = sample->loadScanData(scan);
+            if (scanData->nobs() == 0) continue;
+            float intensity = scanData->intensity[0];
             if (seenMRMS.contains(filterLine)){
-                if(scan->intensity[0] <= seenMRMS.value(filterLine)->intensity[0]) continue;
+                if(intensity <= seenIntensity.value(filterLine)) continue;
             }
 
             seenMRMS.insert(filterLine, scan);
+            seenIntensity.insert(filterLine, intensity);
         }
     }
 
@@ -40,5 +40,7 @@ namespace mzUtils
         ~SavGolSmoother() ;
         void Smooth(std::vector<float> *mzs, std::vector<float> *intensities) ;
         std::vector<float> Smooth(std::vector<float>& intensities);
+        //! filter coefficients, from the leftmost point of the window.
+        const std::vector<float>& coefficients() const { return mvect_coefficients; }
     };
 }
@@ -18,9 +18,18 @@ Scan::Scan(mzSample* sample, int scannum, int mslevel, float rt, float precursor
 	this->precursorCharge = 0;
 	this->precursorIntensity = 0;
     this->isolationWindow = 1;
+    this->fileSeekStart = -1;
+    this->fileSeekEnd = -1;
+    this->_hasSummary = false;
+    this->_summaryNobs = 0;
+    this->_minMz = 0;
+    this->_maxMz = 0;
+    this->_basePeakMz = 0;
+    this->_basePeakIntensity = 0;
+    this->_totalIntensity = 0;
 }
 
-void Scan::deepcopy(Scan* b) {
+void Scan::deepcopy(const Scan* b) {
     this->sample = b->sample;
     this->rt = b->rt;
     this->scannum = b->scannum;
@@ -39,14 +48,63 @@ void Scan::deepcopy(Scan* b) {
     this->setPolarity( b->getPolarity() );
     this->originalRt = b->originalRt;
     this->isolationWindow = b->isolationWindow;
+    this->fileSeekStart = b->fileSeekStart;
+    this->fileSeekEnd = b->fileSeekEnd;
+    this->_hasSummary = b->_hasSummary;
+    this->_summaryNobs = b->_summaryNobs;
+    this->_minMz = b->_minMz;
+    this->_maxMz = b->_maxMz;
+    this->_basePeakMz = b->_basePeakMz;
+    this->_basePeakIntensity = b->_basePeakIntensity;
+    this->_totalIntensity = b->_totalIntensity;
+}
+
+void Scan::updateSummary() {
+    _hasSummary = true;
+    _summaryNobs = nobs();
+    _minMz = 0;
+    _maxMz = 0;
+    _basePeakMz = 0;
+    _basePeakIntensity = 0;
+    _totalIntensity = 0;
+    if (_summaryNobs == 0)
+        return;
+
+    _minMz = mz[0];
+    _maxMz = mz[0];
+    double sum = 0;
+    for (unsigned int i = 0; i < _summaryNobs; i++) {
+        _minMz = min(_minMz, mz[i]);
+        _maxMz = max(_maxMz, mz[i]);
+        sum += intensity[i];
+        if (intensity[i] > _basePeakIntensity) {
+            _basePeakIntensity = intensity[i];
+            _basePeakMz = mz[i];
+        }
+    }
+    _totalIntensity = sum;
+}
 
+void Scan::setSummary(unsigned int nobs,
+                      mzValue minMz,
+                      mzValue maxMz,
+                      float basePeakMz,
+                      float basePeakIntensity,
+                      float totalIntensity) {
+    _hasSummary = true;
+    _summaryNobs = nobs;
+    _minMz = minMz;
+    _maxMz = maxMz;
+    _basePeakMz = basePeakMz;
+    _basePeakIntensity = basePeakIntensity;
+    _totalIntensity = totalIntensity;
 }
 
-int Scan::findHighestIntensityPos(float _mz, MassCutoff *massCutoff) {
+int Scan::findHighestIntensityPos(float _mz, MassCutoff *massCutoff) const {
         float mzmin = _mz - massCutoff->massCutoffValue(_mz);
         float mzmax = _mz + massCutoff->massCutoffValue(_mz);
 
-        vector<float>::iterator itr = lower_bound(mz.begin(), mz.end(), mzmin-1);
+        auto itr = lower_bound(mz.begin(), mz.end(), mzmin-1);
         int lb = itr-mz.begin();
         int bestPos=-1;  float highestIntensity=0;
         for(unsigned int k=lb; k < nobs(); k++ ) {
@@ -64,11 +122,11 @@ int Scan::findHighestIntensityPos(float _mz, MassCutoff *massCutoff) {
 @author: Sahil
 */
 //TODO: Sahil, Added while merging point
-int Scan::findClosestHighestIntensityPos(float _mz, MassCutoff *massCutoff) {
+int Scan::findClosestHighestIntensityPos(float _mz, MassCutoff *massCutoff) const {
 			float mzmin = _mz - massCutoff->getMassCutoff()-0.001;
 			float mzmax = _mz + massCutoff->getMassCutoff()+0.001;
 
-			vector<float>::iterator itr = lower_bound(mz.begin(), mz.end(), mzmin-0.1);
+			auto itr = lower_bound(mz.begin(), mz.end(), mzmin-0.1);
 			int lb = itr-mz.begin();
 			float highestIntensity=0; 
 			for(unsigned int k=lb; k < mz.size(); k++ ) {
@@ -90,9 +148,9 @@ int Scan::findClosestHighestIntensityPos(float _mz, MassCutoff *massCutoff) {
 			return bestPos;
 }
 
-vector<int> Scan::findMatchingMzs(float mzmin, float mzmax) {
+vector<int> Scan::findMatchingMzs(float mzmin, float mzmax) const {
 	vector<int>matches;
-	vector<float>::iterator itr = lower_bound(mz.begin(), mz.end(), mzmin-1);
+	auto itr = lower_bound(mz.begin(), mz.end(), mzmin-1);
 	int lb = itr-mz.begin();
 	for(unsigned int k=lb; k < nobs(); k++ ) {
 		if (mz[k] < mzmin) continue;
@@ -108,8 +166,9 @@ void Scan::quantileFilter(int minQuantile) {
         if( minQuantile <= 0 || minQuantile >= 100 ) return;
 
         int vsize=intensity.size();
-        vector<float>dist = quantileDistribution(this->intensity);
-        vector<float>cMz;
+        vector<float>dist = quantileDistribution(
+            vector<float>(intensity.begin(), intensity.end()));
+        vector<mzValue>cMz;
         vector<float>cIntensity;
         for(int i=0; i<vsize; i++ ) {
             if ( intensity[i] > dist[ minQuantile ]) {
@@ -117,10 +176,11 @@ void Scan::quantileFilter(int minQuantile) {
                 cIntensity.push_back(intensity[i]);
             }
         }
-        vector<float>(cMz).swap(cMz);
+        vector<mzValue>(cMz).swap(cMz);
         vector<float>(cIntensity).swap(cIntensity);
         mz.swap(cMz);
         intensity.swap(cIntensity);
+        updateSummary();
 }
 
 void Scan::intensityFilter(int minIntensity) {
@@ -128,7 +188,7 @@ void Scan::intensityFilter(int minIntensity) {
 
         //first pass.. find local maxima in intensity space
         int vsize=intensity.size();
-        vector<float>cMz;
+        vector<mzValue>cMz;
         vector<float>cIntensity;
         for(int i=0; i<vsize; i++ ) {
            if ( intensity[i] > minIntensity) { //local maxima
@@ -136,10 +196,11 @@ void Scan::intensityFilter(int minIntensity) {
                 cIntensity.push_back(intensity[i]);
             }
         }
-        vector<float>(cMz).swap(cMz);
+        vector<mzValue>(cMz).swap(cMz);
         vector<float>(cIntensity).swap(cIntensity);
         mz.swap(cMz);
         intensity.swap(cIntensity);
+        updateSummary();
 }
 
 void Scan::simpleCentroid() {
@@ -150,12 +211,13 @@ void Scan::simpleCentroid() {
 
         //find local maxima in intensity space
         int vsize=spline.size();
-        vector<float>cMz;
+        vector<mzValue>cMz;
         vector<float>cIntensity;
 
         findLocalMaximaInIntensitySpace(vsize, &cMz, &cIntensity, &spline);
 
         updateIntensityWithTheLocalMaximas(&cMz, &cIntensity);
+        updateSummary();
 
         centroided = true;
 }
@@ -172,18 +234,19 @@ vector<float> Scan::smoothenIntensitites() {
 
     mzUtils::SavGolSmoother smoother(smoothWindow,smoothWindow,order);
     //smooth once
-    vector<float>spline = smoother.Smooth(intensity);
+    vector<float> values(intensity.begin(), intensity.end());
+    vector<float>spline = smoother.Smooth(values);
     //smooth twice
     spline = smoother.Smooth(spline);
 
     return spline;
 }
 
-void Scan::findLocalMaximaInIntensitySpace(int vsize, vector<float> *cMz, vector<float> *cIntensity, vector<float> *spline) {
+void Scan::findLocalMaximaInIntensitySpace(int vsize, vector<mzValue> *cMz, vector<float> *cIntensity, vector<float> *spline) {
         for(int i=1; i<vsize-2; i++ ) {
             if ( (*spline)[i] > (*spline)[i-1] &&  (*spline)[i] > (*spline)[i+1] ) { //local maxima in spline space
                     //local maxima in real intensity space
-                    float maxMz=mz[i]; float maxIntensity=intensity[i];
+                    mzValue maxMz=mz[i]; float maxIntensity=intensity[i];
                     for(int j=i-1; j<i+1; j++) {
                             if (intensity[i] > maxIntensity) { maxIntensity=intensity[i]; maxMz=mz[i]; }
                     }
@@ -193,18 +256,18 @@ void Scan::findLocalMaximaInIntensitySpace(int vsize, vector<float> *cMz, vector
         }
 }
 
-void Scan::updateIntensityWithTheLocalMaximas(vector<float> *cMz, vector<float> *cIntensity){
+void Scan::updateIntensityWithTheLocalMaximas(vector<mzValue> *cMz, vector<float> *cIntensity){
 
-    vector<float>(*cMz).swap(*cMz);
+    vector<mzValue>(*cMz).swap(*cMz);
     vector<float>(*cIntensity).swap(*cIntensity);
     mz.swap(*cMz);
     intensity.swap(*cIntensity);
 }
 
-bool Scan::hasMz(float _mz, MassCutoff *massCutoff) {
+bool Scan::hasMz(float _mz, MassCutoff *massCutoff) const {
     float mzmin = _mz - massCutoff->massCutoffValue(_mz);
     float mzmax = _mz + massCutoff->massCutoffValue(_mz);
-	vector<float>::iterator itr = lower_bound(mz.begin(), mz.end(), mzmin);
+	auto itr = lower_bound(mz.begin(), mz.end(), mzmin);
 	//cerr << _mz  << " k=" << lb << "/" << mz.size() << " mzk=" << mz[lb] << endl;
 	for(unsigned int k=itr-mz.begin(); k < nobs(); k++ ) {
         if (mz[k] >= mzmin && mz[k] <= mzmax )  return true;
@@ -391,7 +454,7 @@ void Scan::findError(ChargedSpecies* x) {
             x->error = sqrt(totalError/x->countMatches);
             //cout << "-------- total Error= " << sqrt(totalError/x->countMatches) << " total Intensity=" << totalIntensity << endl;
 }
-vector<int> Scan::intensityOrderDesc() {
+vector<int> Scan::intensityOrderDesc() const {
     vector<pair<float,int> > mzarray(nobs());
     vector<int>position(nobs());
     for(unsigned int pos=0; pos < nobs(); pos++ ) {
@@ -406,7 +469,7 @@ vector<int> Scan::intensityOrderDesc() {
    return position;
 }
 
-vector <pair<float,float> > Scan::getTopPeaks(float minFracCutoff,float minSNRatio=3,int dropTopX=40)
+vector <pair<float,float> > Scan::getTopPeaks(float minFracCutoff,float minSNRatio=3,int dropTopX=40) const
 {
     vector<pair<float,float>> selected;
     if (nobs() == 0)
@@ -434,7 +497,7 @@ vector <pair<float,float> > Scan::getTopPeaks(float minFracCutoff,float minSNRat
     return selected;
 }
 
-string Scan::toMGF() { 
+string Scan::toMGF() const { 
     //Merged with Maven776 - Kiran
     std::stringstream buffer;
     buffer << "BEGIN IONS" << endl;
@@ -543,7 +606,7 @@ vector<int> Scan::assignCharges(MassCutoff *massCutoffTolr) {
     return parentPeaks;
 }
 
-Scan* Scan::getLastFullScan(int historySize)
+Scan* Scan::getLastFullScan(int historySize) const
 {
 	if (!this->sample) return 0;
     int scanNum = this->scannum;
@@ -557,10 +620,10 @@ Scan* Scan::getLastFullScan(int historySize)
 
 void Scan::recalculatePrecursorMz(float ppm)
 {
-    if (mslevel != 2)
+    if (mslevel != 2 || !sample)
         return;
     
-    Scan* fullScan = getLastFullScan(50);
+    auto fullScan = sample->loadScanData(getLastFullScan(50));
     if (!fullScan)
         return;
     
@@ -579,13 +642,13 @@ void Scan::recalculatePrecursorMz(float ppm)
     }
 }
 
-vector<mzPoint> Scan::getIsolatedRegion(float isolationWindowAmu)
+vector<mzPoint> Scan::getIsolatedRegion(float isolationWindowAmu) const
 {
 	vector<mzPoint> isolatedSegment;
 	if(! this->sample) return isolatedSegment;
 
 	//find last ms1 scan or get out
-	Scan* lastFullScan = this->getLastFullScan();
+	auto lastFullScan = sample->loadScanData(this->getLastFullScan());
 	if (!lastFullScan) return isolatedSegment;
 
 	//no precursor information
@@ -605,7 +668,7 @@ vector<mzPoint> Scan::getIsolatedRegion(float isolationWindowAmu)
 	return isolatedSegment;
 }
 
-double Scan::getPrecursorPurity(float ppm)
+double Scan::getPrecursorPurity(float ppm) const
 {
     if (this->precursorMz <= 0 ) return 0;
     if (this->sample == 0 ) return 0;
@@ -615,7 +678,7 @@ double Scan::getPrecursorPurity(float ppm)
     if (isolatedSegment.size() == 0) return 0;
 
     //get last full scan
-    Scan* lastFullScan = this->getLastFullScan();
+    auto lastFullScan = sample->loadScanData(this->getLastFullScan());
     if (!lastFullScan) return 0;
 
     //locate intensity of isolated mass
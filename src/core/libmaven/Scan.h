@@ -6,6 +6,7 @@
 #include <QStringList>
 
 #include "standardincludes.h"
+#include "datastructures/peakarray.h"
 
 class mzSample;
 class mzPoint;
@@ -27,7 +28,7 @@ class Scan
   public:
     Scan(mzSample *sample, int scannum, int mslevel, float rt, float precursorMz, int polarity);
 
-    void deepcopy(Scan *b);
+    void deepcopy(const Scan *b);
 
     /**
     * @brief return number of m/z's(number of observatiosn) recorded in a scan.
@@ -36,9 +37,13 @@ class Scan
 
     /**
      * @brief Obtain the smallest m/z value stored.
+     * @details Read from the summary of the scan if it is up to date, so
+     * that the bound is still known once the peaks have been released.
      * @return Fractional m/z value.
      */
-    inline float minMz() {
+    inline mzValue minMz() const {
+        if (_hasCurrentSummary())
+            return _minMz;
         if(nobs() > 0)
             return *(std::min_element(begin(mz),
                                       end(mz)));
@@ -47,37 +52,85 @@ class Scan
 
     /**
      * @brief Obtain the largest m/z value stored.
+     * @details Read from the summary of the scan if it is up to date.
      * @return Fractional m/z value.
      */
-    inline float maxMz() {
+    inline mzValue maxMz() const {
+        if (_hasCurrentSummary())
+            return _maxMz;
         if(nobs() > 0)
             return *(std::max_element(begin(mz),
                                       end(mz)));
         return 0.0f; }
 
+    /**
+     * @brief Check whether some peaks of this scan may lie within an m/z
+     * range.
+     * @details Only compares the range with the m/z bounds of the scan, so
+     * a scan whose bounds straddle the range may still have no peak in it.
+     * Scans without a summary and without peaks in memory may have been
+     * released, and are assumed to overlap.
+     * @return False if no peak of the scan can be within [mzmin, mzmax].
+     */
+    inline bool overlapsMzRange(mzValue mzmin, mzValue mzmax) const {
+        if (_hasCurrentSummary())
+            return _summaryNobs > 0 && _maxMz >= mzmin && _minMz <= mzmax;
+        return nobs() == 0 || (mz.back() >= mzmin && mz.front() <= mzmax);
+    }
+
+    /**
+     * @brief Cache the m/z bounds, base peak and total intensity of the
+     * scan.
+     * @details Must be called whenever the peaks are modified by code
+     * outside this class, the filters of this class call it themselves.
+     * The cached values are used for as long as the number of peaks does
+     * not change, and after the peaks have been released by a lazily
+     * loaded sample.
+     */
+    void updateSummary();
+
+    /**
+     * @brief Set the values cached by updateSummary without reading the
+     * peaks, e.g. from the metadata of a scan whose peaks are left in the
+     * file.
+     * @param nobs Number of peaks of the scan.
+     */
+    void setSummary(unsigned int nobs,
+                    mzValue minMz,
+                    mzValue maxMz,
+                    float basePeakMz,
+                    float basePeakIntensity,
+                    float totalIntensity);
+
+    /**
+     * @brief Check whether the values cached by updateSummary describe the
+     * peaks of the scan.
+     */
+    inline bool hasSummary() const { return _hasCurrentSummary(); }
+
     /**
     *@brief return the corresponding sample
     */
-    inline mzSample *getSample() { return sample; }
+    inline mzSample *getSample() const { return sample; }
 
 
-    vector<int> findMatchingMzs(float mzmin, float mzmax); //TODO why int vector?
+    vector<int> findMatchingMzs(float mzmin, float mzmax) const; //TODO why int vector?
 
     /**
     *@brief In a given m/z range (mz + ppm) return the position of Highest intensity present in the scan
     *@param m/z and ppm(parts per million). Together they define the m/z range
     */
-    int findHighestIntensityPos(float mz, MassCutoff *massCutoff);
+    int findHighestIntensityPos(float mz, MassCutoff *massCutoff) const;
 
 
-    int findClosestHighestIntensityPos(float mz, MassCutoff *massCutoff); //TODO: Sahil, Added while merging point
+    int findClosestHighestIntensityPos(float mz, MassCutoff *massCutoff) const; //TODO: Sahil, Added while merging point
 
     /**
     * @brief checks if an input m/z value is present in the scan
     * @param  mz(input m/z value) and ppm(prats per million)
     * @return returns true if input m/z exists, otherwise false
     */
-    bool hasMz(float mz, MassCutoff *massCutoff);
+    bool hasMz(float mz, MassCutoff *massCutoff) const;
 
     /**
     * @brief check if the data is centroided
@@ -110,22 +163,23 @@ class Scan
     * @brief Calculate the sum of all the intensities for a scan
     * @return return total intensity
     */
-    int totalIntensity() const
+    float totalIntensity() const
     {
-        int sum = 0;
+        if (_hasCurrentSummary())
+            return _totalIntensity;
+        double sum = 0;
         for (unsigned int i = 0; i < intensity.size(); i++)
             sum += intensity[i];
         return sum;
     }
 
-
-    //TODO: basePeakIntensity value in every scan of mzXml file represents maxIntensity. Use it rather than looping over all the  intensities
     /**
     * @brief return the maxIntensity in scan
     */
-
-    float maxIntensity()
+    float maxIntensity() const
     {
+        if (_hasCurrentSummary())
+            return _basePeakIntensity;
         float max = 0;
         for (unsigned int i = 0; i < intensity.size(); i++)
             if (intensity[i] > max)
@@ -133,13 +187,32 @@ class Scan
         return max;
     }
 
+    /**
+    * @brief return the m/z of the most intense peak in scan (0 if the scan
+    * has no peaks)
+    */
+    float basePeakMz() const
+    {
+        if (_hasCurrentSummary())
+            return _basePeakMz;
+        float max = 0;
+        float maxMz = 0;
+        for (unsigned int i = 0; i < intensity.size(); i++) {
+            if (intensity[i] > max) {
+                max = intensity[i];
+                maxMz = mz[i];
+            }
+        }
+        return maxMz;
+    }
+
     /**
     * @brief return pairs of m/z, intensity values for top intensities.
     * @details intensities are normalized to a maximum intensity in a scan * 100]
     * @param minFracCutoff specfies mininum relative intensity; for example
     * 0.05, filters out all intensites below 5% of maxium scan intensity]
     */
-    vector<pair<float, float> > getTopPeaks(float minFracCutoff, float minSigNoiseRatio, int dropTopX);
+    vector<pair<float, float> > getTopPeaks(float minFracCutoff, float minSigNoiseRatio, int dropTopX) const;
 
     vector<int> assignCharges(MassCutoff *massCutoffTolr);
 
@@ -147,12 +220,12 @@ class Scan
 
     ChargedSpecies *deconvolute(float mzfocus, float noiseLevel, MassCutoff *massCutoffMerge, float minSigNoiseRatio, int minDeconvolutionCharge, int maxDeconvolutionCharge, int minDeconvolutionMass, int maxDeconvolutionMass, int minChargedStates);
 
-    string toMGF();
+    string toMGF() const;
 
     /**
     *@brief  return position of intensities in descending order(highest to lowest)
     */
-    vector<int> intensityOrderDesc();
+    vector<int> intensityOrderDesc() const;
 
     /**
     *@brief centroid the data
@@ -186,7 +259,7 @@ class Scan
      * @details if the parent full scan has multiple readings within a precursor m/z window
      * the fragmentation scan would be a mixture of fragments from all those species
      */ 
-    double getPrecursorPurity(float ppm = 10.0);
+    double getPrecursorPurity(float ppm = 10.0) const;
 
     /**
     *@brief print the info present in a scan
@@ -212,13 +285,20 @@ class Scan
     float productMz;
     float collisionEnergy;
 
-    vector<float> intensity; /**< intensities found in one scan */
-    vector<float> mz; /**< m/z's found in one scan */
+    PeakArray<float> intensity; /**< intensities found in one scan */
+    PeakArray<mzValue> mz; /**< m/z's found in one scan */
     string scanType;
     string filterLine;
     mzSample *sample; /**< sample corresponding to the scan */
     int polarity; /**< +1 for positively charged, -1 for negatively charged, 0 for neutral*/
 
+    /**
+     * @brief Byte range of the file holding this scan's peaks, so that they
+     * can be read again after being released (-1 if unknown).
+     */
+    long long fileSeekStart;
+    long long fileSeekEnd;
+
     /**
      * @brief compare total intensity of two scans
      * @return true if Scan a has a higher totalIntensity than b, else false
@@ -242,6 +322,23 @@ class Scan
   private:
     float parentPeakIntensity;
 
+    //values cached by updateSummary
+    bool _hasSummary;
+    unsigned int _summaryNobs;
+    mzValue _minMz;
+    mzValue _maxMz;
+    float _basePeakMz;
+    float _basePeakIntensity;
+    float _totalIntensity;
+
+    /**
+     * @brief Check whether the cached summary describes the current peaks,
+     * or the peaks that were released.
+     */
+    inline bool _hasCurrentSummary() const {
+        return _hasSummary && (nobs() == _summaryNobs || nobs() == 0);
+    }
+
     struct BrotherData
     {
         float expectedMass;
@@ -265,18 +362,18 @@ class Scan
     /**
      * @brief gets the previous MS1 scan till historySize
      */ 
-    Scan* getLastFullScan(int historySize = 50);
+    Scan* getLastFullScan(int historySize = 50) const;
     
     /**
      * @brief gets the full-scan m/z-int readings that fall within the isolation window of the precursor
      */
-    vector<mzPoint> getIsolatedRegion(float isolationWindowAmu = 1.0);
+    vector<mzPoint> getIsolatedRegion(float isolationWindowAmu = 1.0) const;
 
     vector<float> smoothenIntensitites();
     /**
     *@brief compare the current intensity with the left and the right intensity and store the largest amongest them
     */
-    void findLocalMaximaInIntensitySpace(int vsize, vector<float> *cMz, vector<float> *cIntensity, vector<float> *spline);
-    void updateIntensityWithTheLocalMaximas(vector<float> *cMz, vector<float> *cIntensity);
+    void findLocalMaximaInIntensitySpace(int vsize, vector<mzValue> *cMz, vector<float> *cIntensity, vector<float> *spline);
+    void updateIntensityWithTheLocalMaximas(vector<mzValue> *cMz, vector<float> *cIntensity);
 };
 #endif
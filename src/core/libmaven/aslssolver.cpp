@@ -0,0 +1,202 @@
+#include <cmath>
+#include <limits>
+
+#include <Eigen>
+
+#include "aslssolver.h"
+#include "doctest.h"
+
+using namespace std;
+
+namespace mzUtils
+{
+    AsLSSolver::AsLSSolver() : _n(0)
+    {
+    }
+
+    AsLSSolver& AsLSSolver::forCurrentThread()
+    {
+        static thread_local AsLSSolver solver;
+        return solver;
+    }
+
+    int AsLSSolver::solve(const vector<double>& signal,
+                          double lambda,
+                          double p,
+                          int maxIterations,
+                          vector<double>& baseline)
+    {
+        size_t n = signal.size();
+        baseline.assign(n, 0.0);
+        if (n == 0)
+            return 0;
+
+        _prepare(n);
+        fill(begin(_weights), end(_weights), 1.0);
+
+        int iteration = 0;
+        while (iteration < maxIterations) {
+            // with some weights at zero the system may become singular, the
+            // baseline from the previous iteration is kept in that case
+            if (!_solveSystem(signal, lambda, baseline))
+                break;
+            ++iteration;
+
+            bool weightsChanged = false;
+            for (size_t i = 0; i < n; ++i) {
+                double residual = signal[i] - baseline[i];
+                double weight = 0.0;
+                if (residual > 0.0) {
+                    weight = p;
+                } else if (residual < 0.0) {
+                    weight = 1.0 - p;
+                }
+                if (weight != _weights[i]) {
+                    _weights[i] = weight;
+                    weightsChanged = true;
+                }
+            }
+            if (!weightsChanged)
+                break;
+        }
+        return iteration;
+    }
+
+    void AsLSSolver::_prepare(size_t n)
+    {
+        if (n == _n)
+            return;
+
+        _n = n;
+        _penalty0.assign(n, 0.0);
+        _penalty1.assign(n, 0.0);
+        _penalty2.assign(n, 0.0);
+
+        // accumulate the outer product of each row [1, -2, 1] of D
+        const double row[3] = {1.0, -2.0, 1.0};
+        for (size_t r = 0; r + 2 < n; ++r) {
+            for (size_t k = 0; k < 3; ++k) {
+                _penalty0[r + k] += row[k] * row[k];
+                if (k < 2)
+                    _penalty1[r + k] += row[k] * row[k + 1];
+            }
+            _penalty2[r] += row[0] * row[2];
+        }
+
+        _weights.resize(n);
+        _pivots.resize(n);
+        _lower1.resize(n);
+        _lower2.resize(n);
+        _work.resize(n);
+    }
+
+    bool AsLSSolver::_solveSystem(const vector<double>& signal,
+                                  double lambda,
+                                  vector<double>& solution)
+    {
+        size_t n = _n;
+
+        // factorize A = L·Dg·Lᵀ, band by band
+        for (size_t i = 0; i < n; ++i) {
+            double diagonal = _weights[i] + lambda * _penalty0[i];
+            double pivot = diagonal;
+            double offDiagonal = lambda * _penalty1[i];
+            if (i >= 1) {
+                pivot -= _lower1[i - 1] * _lower1[i - 1] * _pivots[i - 1];
+                if (i >= 2) {
+                    pivot -= _lower2[i - 2] * _lower2[i - 2] * _pivots[i - 2];
+                }
+                offDiagonal -= _lower2[i - 1] * _lower1[i - 1] * _pivots[i - 1];
+            }
+            if (!(pivot > numeric_limits<double>::epsilon() * diagonal))
+                return false;
+
+            _pivots[i] = pivot;
+            _lower1[i] = offDiagonal / pivot;
+            _lower2[i] = lambda * _penalty2[i] / pivot;
+        }
+
+        // forward substitution with L and scaling by Dg
+        for (size_t i = 0; i < n; ++i) {
+            double value = _weights[i] * signal[i];
+            if (i >= 1)
+                value -= _lower1[i - 1] * _work[i - 1];
+            if (i >= 2)
+                value -= _lower2[i - 2] * _work[i - 2];
+            _work[i] = value;
+        }
+        for (size_t i = 0; i < n; ++i)
+            _work[i] /= _pivots[i];
+
+        // backward substitution with Lᵀ
+        for (size_t i = n; i-- > 0;) {
+            double value = _work[i];
+            if (i + 1 < n)
+                value -= _lower1[i] * _work[i + 1];
+            if (i + 2 < n)
+                value -= _lower2[i] * _work[i + 2];
+            _work[i] = value;
+        }
+
+        copy(begin(_work), end(_work), begin(solution));
+        return true;
+    }
+
+    TEST_CASE("Testing banded AsLS solver")
+    {
+        // a peak on top of a sloping baseline
+        vector<double> signal;
+        for (int i = 0; i < 200; ++i) {
+            double x = (i - 120) / 8.0;
+            signal.push_back(1000.0 + 2.0 * i + 5.0e4 * exp(-x * x));
+        }
+
+        double lambda = 100.0;
+        double p = 0.05;
+        int maxIterations = 10;
+
+        // reference: the same iterations using a sparse Cholesky solver
+        using namespace Eigen;
+        int n = signal.size();
+        SparseMatrix<double> D(n - 2, n);
+        for (int r = 0; r < n - 2; ++r) {
+            D.insert(r, r) = 1.0;
+            D.insert(r, r + 1) = -2.0;
+            D.insert(r, r + 2) = 1.0;
+        }
+        SparseMatrix<double> penalty = lambda * (D.transpose() * D);
+        VectorXd y = Map<VectorXd>(signal.data(), n);
+        VectorXd w = VectorXd::Ones(n);
+        VectorXd z;
+        SimplicialCholesky<SparseMatrix<double>> cholesky;
+        for (int i = 0; i < maxIterations; ++i) {
+            SparseMatrix<double> A = SparseMatrix<double>(w.asDiagonal())
+                                     + penalty;
+            cholesky.compute(A);
+            z = cholesky.solve(VectorXd(w.array() * y.array()));
+            for (int j = 0; j < n; ++j) {
+                if (y[j] > z[j]) {
+                    w[j] = p;
+                } else if (y[j] < z[j]) {
+                    w[j] = 1.0 - p;
+                } else {
+                    w[j] = 0.0;
+                }
+            }
+        }
+
+        vector<double> baseline;
+        AsLSSolver& solver = AsLSSolver::forCurrentThread();
+        int iterations = solver.solve(signal, lambda, p, maxIterations, baseline);
+        REQUIRE(iterations <= maxIterations);
+        REQUIRE(baseline.size() == signal.size());
+        for (int j = 0; j < n; ++j)
+            REQUIRE(baseline[j] == doctest::Approx(z[j]).epsilon(1e-6));
+
+        // a second signal of the same length reuses the workspaces
+        vector<double> flat(signal.size(), 10.0);
+        solver.solve(flat, lambda, p, maxIterations, baseline);
+        for (auto value : baseline)
+            REQUIRE(value == doctest::Approx(10.0));
+    }
+}
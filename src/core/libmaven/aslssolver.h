@@ -0,0 +1,85 @@
+#ifndef ASLSSOLVER_H
+#define ASLSSOLVER_H
+
+#include <vector>
+
+namespace mzUtils
+{
+    /**
+     * @brief Asymmetric least squares (AsLS) baseline estimation using a
+     * banded solver.
+     *
+     * @details Every AsLS iteration solves (W + λ·DᵀD)·z = W·y, where W is the
+     * diagonal matrix of weights and D the second-order difference operator.
+     * The system matrix is symmetric and pentadiagonal, so it is factorized
+     * as L·Dg·Lᵀ with L unit lower triangular of bandwidth two, in linear time
+     * and without any symbolic analysis. The bands of DᵀD only depend on the
+     * length of the signal and are kept for the next signal of the same
+     * length, along with all the buffers used by the factorization.
+     *
+     * Iterations stop as soon as the weights do not change anymore, since
+     * the next solution would then be the same as the current one.
+     *
+     * A solver is not thread-safe, use the one returned by `forCurrentThread`.
+     */
+    class AsLSSolver
+    {
+      public:
+        AsLSSolver();
+
+        /**
+         * @brief The solver owned by the calling thread.
+         */
+        static AsLSSolver& forCurrentThread();
+
+        /**
+         * @brief Estimate the baseline of a signal.
+         * @param signal Values for which the baseline is estimated.
+         * @param lambda Smoothness of the baseline.
+         * @param p Asymmetry, i.e. the weight given to points above the
+         * baseline. Points below it are weighted by `1 - p`.
+         * @param maxIterations Maximum number of reweighting iterations.
+         * @param baseline Output vector, resized to the size of the signal.
+         * @return The number of iterations performed.
+         */
+        int solve(const std::vector<double>& signal,
+                  double lambda,
+                  double p,
+                  int maxIterations,
+                  std::vector<double>& baseline);
+
+      private:
+        /**
+         * @brief Compute the bands of DᵀD for signals of length `n` and size
+         * the workspaces, unless this was already done for that length.
+         */
+        void _prepare(size_t n);
+
+        /**
+         * @brief Factorize W + λ·DᵀD and solve the system for the current
+         * weights and signal.
+         * @return False if the system is not positive definite, in which case
+         * `solution` is left unchanged.
+         */
+        bool _solveSystem(const std::vector<double>& signal,
+                          double lambda,
+                          std::vector<double>& solution);
+
+        size_t _n;
+
+        // diagonal, first and second superdiagonals of DᵀD
+        std::vector<double> _penalty0;
+        std::vector<double> _penalty1;
+        std::vector<double> _penalty2;
+
+        std::vector<double> _weights;
+
+        // diagonal of Dg and the two subdiagonals of L
+        std::vector<double> _pivots;
+        std::vector<double> _lower1;
+        std::vector<double> _lower2;
+        std::vector<double> _work;
+    };
+}
+
+#endif  // ASLSSOLVER_H
@@ -1,101 +1,370 @@
 #include "base64.h"
 #include "mzUtils.h"
 
+#ifdef ZLIB
+#include <zlib.h>
+#endif
+
 using namespace std;
 
 namespace base64 {
-    string decodeString(const char *data, const size_t len)
+    static const unsigned char B64index[256] = {
+        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  62, 63, 62, 62, 63,
+        52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 0,  0,  0,  0,  0,  0,
+        0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14,
+        15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 0,  0,  0,  0,  63,
+        0,  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+        41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51
+    };
+
+    size_t decodedSize(const char* data, const size_t len)
+    {
+        const unsigned char* p = (const unsigned char*)data;
+        int pad = len > 0 && (len % 4 || p[len - 1] == '=');
+        const size_t L = ((len + 3) / 4 - pad) * 4;
+        size_t size = L / 4 * 3 + pad;
+        if (pad && len > L + 2 && p[L + 2] != '=')
+            size++;
+        return size;
+    }
+
+    size_t decodeInto(const char* data, const size_t len, char* dest)
     {
-        unsigned char* p = (unsigned char*)data;
+        const unsigned char* p = (const unsigned char*)data;
+        unsigned char* out = (unsigned char*)dest;
         int pad = len > 0 && (len % 4 || p[len - 1] == '=');
         const size_t L = ((len + 3) / 4 - pad) * 4;
-        std::string str(L / 4 * 3 + pad, '\0');
-
-        const int B64index[256] = {
-            0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-            0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-            0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  62, 63, 62, 62, 63,
-            52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 0,  0,  0,  0,  0,  0,
-            0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14,
-            15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 0,  0,  0,  0,  63,
-            0,  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-            41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51
-        };
-
-        for (size_t i = 0, j = 0; i < L; i += 4)
-        {
-            int n = B64index[p[i]] << 18 | B64index[p[i + 1]] << 12
-                    | B64index[p[i + 2]] << 6 | B64index[p[i + 3]];
-            str[j++] = n >> 16;
-            str[j++] = n >> 8 & 0xFF;
-            str[j++] = n & 0xFF;
+
+        size_t j = 0;
+        for (size_t i = 0; i < L; i += 4) {
+            uint32_t n = B64index[p[i]] << 18 | B64index[p[i + 1]] << 12
+                         | B64index[p[i + 2]] << 6 | B64index[p[i + 3]];
+            out[j] = n >> 16;
+            out[j + 1] = n >> 8 & 0xFF;
+            out[j + 2] = n & 0xFF;
+            j += 3;
         }
-        if (pad)
-        {
-            int n = B64index[p[L]] << 18 | B64index[p[L + 1]] << 12;
-            str[str.size() - 1] = n >> 16;
+        if (pad) {
+            uint32_t n = B64index[p[L]] << 18 | B64index[p[L + 1]] << 12;
+            out[j++] = n >> 16;
 
-            if (len > L + 2 && p[L + 2] != '=')
-            {
+            if (len > L + 2 && p[L + 2] != '=') {
                 n |= B64index[p[L + 2]] << 6;
-                str.push_back(n >> 8 & 0xFF);
+                out[j++] = n >> 8 & 0xFF;
             }
         }
+        return j;
+    }
+
+    string decodeString(const char *data, const size_t len)
+    {
+        std::string str(decodedSize(data, len), '\0');
+        if (!str.empty())
+            decodeInto(data, len, &str[0]);
         return str;
     }
 
-    vector<float> decodeBase64(const string& src,
-                               int float_size,
-                               bool neworkorder,
-                               bool decompress)
+#ifdef ZLIB
+    /**
+     * @brief Inflate a zlib stream into a buffer, growing it as needed.
+     * @param size Set to the number of bytes written to the start of the
+     * buffer.
+     * @return False if the stream is corrupt or ends before it is complete.
+     */
+    static bool inflateInto(const char* compressed,
+                            size_t len,
+                            string& buffer,
+                            size_t& size)
     {
-        string destStr = decodeString(src.c_str(), src.size());
+        size = 0;
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit(&stream) != Z_OK)
+            return false;
 
-        if (decompress) {
+        if (buffer.size() < len * 4)
+            buffer.resize(len * 4 + 1);
+
+        stream.next_in = (Bytef*)compressed;
+        stream.avail_in = len;
+        size_t written = 0;
+        int status = Z_OK;
+        while (status == Z_OK) {
+            if (written == buffer.size())
+                buffer.resize(buffer.size() * 2);
+            stream.next_out = (Bytef*)&buffer[written];
+            stream.avail_out = buffer.size() - written;
+            status = inflate(&stream, Z_NO_FLUSH);
+            written = buffer.size() - stream.avail_out;
+        }
+        inflateEnd(&stream);
+
+        // anything but the end of the stream (e.g., Z_DATA_ERROR, or
+        // Z_BUF_ERROR for input that stops short) leaves the data incomplete
+        if (status != Z_STREAM_END)
+            return false;
+        size = written;
+        return true;
+    }
+#endif
+
+    /**
+     * @brief Decode (and inflate) base64 data into raw bytes.
+     * @details Buffers are reused between calls made from the same thread.
+     * @return Pointer to the decoded bytes, valid until the next call on
+     * this thread, or NULL if compressed data could not be inflated.
+     */
+    static const char* decodeBytes(const char* src,
+                                   size_t len,
+                                   bool decompress,
+                                   size_t& size)
+    {
+        static thread_local string decoded;
+        static thread_local string inflated;
+
+        size = decodedSize(src, len);
+        if (decoded.size() < size)
+            decoded.resize(size);
+        if (size > 0)
+            size = decodeInto(src, len, &decoded[0]);
+
+        // empty arrays are written without a zlib stream
+        if (decompress && size > 0) {
 #ifdef ZLIB
-            destStr = mzUtils::decompressString(destStr);
+            size_t inflatedSize = 0;
+            if (inflateInto(decoded.data(), size, inflated, inflatedSize)) {
+                size = inflatedSize;
+                return inflated.data();
+            }
 #endif
+            size = 0;
+            return NULL;
         }
+        return decoded.data();
+    }
+
+    static inline uint32_t byteSwapped(uint32_t x) { return swapbytes(x); }
+    static inline uint64_t byteSwapped(uint64_t x) { return swapbytes64(x); }
+
+    /**
+     * @brief Read the i-th floating point value of a raw binary array.
+     */
+    template <typename Word, typename Real, bool swap>
+    static inline Real valueAt(const char* bytes, size_t i)
+    {
+        Word u;
+        memcpy(&u, bytes + i * sizeof(Word), sizeof(Word));
+        if (swap)
+            u = byteSwapped(u);
+        Real value;
+        memcpy(&value, &u, sizeof(Word));
+        return value;
+    }
 
+    /**
+     * @brief Convert a raw binary array to values of the output type.
+     */
+    template <typename Word, typename Real, bool swap, typename Out>
+    static void convert(const char* bytes, size_t count, Out* values)
+    {
+        for (size_t i = 0; i < count; i++)
+            values[i] = static_cast<Out>(valueAt<Word, Real, swap>(bytes, i));
+    }
+
+    /**
+     * @brief Split a raw binary array of interleaved pairs into two arrays,
+     * keeping only pairs of positive values.
+     * @return Number of pairs kept.
+     */
+    template <typename Word, typename Real, bool swap, typename First>
+    static size_t convertPairs(const char* bytes,
+                               size_t pairs,
+                               First* first,
+                               float* second)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < pairs; i++) {
+            Real a = valueAt<Word, Real, swap>(bytes, 2 * i);
+            Real b = valueAt<Word, Real, swap>(bytes, 2 * i + 1);
+            if (a > 0 && b > 0) {
+                first[kept] = static_cast<First>(a);
+                second[kept] = static_cast<float>(b);
+                kept++;
+            }
+        }
+        return kept;
+    }
+
+    /**
+     * @brief Whether decoded values need their bytes swapped.
+     */
+    static inline bool swapNeeded(bool neworkorder)
+    {
 #if (LITTLE_ENDIAN == 1)
          cerr << "INFO: little endian… inverted network order.";
          neworkorder=!neworkorder;
 #endif
+        return neworkorder;
+    }
 
-        int size = 1 + (destStr.size() - 4) / float_size;
-
-        // we will cast everything as a float may be this is not wise,
-        // but have not found a need for double precission yet.
-        vector<float> decodedArray(size);
-        const char* dest = destStr.c_str();
-
-        if ( float_size == 8 ) {
-            if ( neworkorder == false ) {
-                for (int i=0; i<size; i++)
-                    decodedArray[i] = (float) ((double*) dest)[i];
-            } else {
-                uint64_t *u = (uint64_t *) dest;
-                double data=0;
-                for (int i=0; i<size; i++) {
-                    uint64_t t = swapbytes64(u[i]);
-                    memcpy(&data,&t,8);
-                    decodedArray[i] = (float) data;
-                }
-            }
-        } else if (float_size == 4 ) {
-            if ( neworkorder == false) {
-                for (int i=0; i<size; i++) decodedArray[i] = ((float*)dest)[i];
-            } else {
-                uint32_t *u = (uint32_t *) dest;
-                float data=0;
-                for (int i=0; i<size; i++) {
-                    uint32_t t = swapbytes(u[i]);
-                    memcpy(&data,&t,4);
-                    decodedArray[i] = data;
-                }
-            }
+    template <typename Out>
+    static bool decodeValues(const char* src,
+                             size_t len,
+                             int float_size,
+                             bool neworkorder,
+                             bool decompress,
+                             vector<Out>& values)
+    {
+        values.clear();
+        if (float_size != 4 && float_size != 8)
+            return false;
+
+        size_t size = 0;
+        const char* bytes = decodeBytes(src, len, decompress, size);
+        if (bytes == NULL)
+            return false;
+        bool swap = swapNeeded(neworkorder);
+
+        size_t count = size / float_size;
+        values.resize(count);
+        if (count == 0)
+            return true;
+
+        if (float_size == 8 && swap) {
+            convert<uint64_t, double, true>(bytes, count, values.data());
+        } else if (float_size == 8) {
+            convert<uint64_t, double, false>(bytes, count, values.data());
+        } else if (swap) {
+            convert<uint32_t, float, true>(bytes, count, values.data());
+        } else {
+            convert<uint32_t, float, false>(bytes, count, values.data());
+        }
+        return true;
+    }
+
+    template <typename First>
+    static bool decodePairs(const char* src,
+                            size_t len,
+                            int float_size,
+                            bool neworkorder,
+                            bool decompress,
+                            vector<First>& first,
+                            vector<float>& second,
+                            size_t& count)
+    {
+        first.clear();
+        second.clear();
+        count = 0;
+        if (float_size != 4 && float_size != 8)
+            return false;
+
+        size_t size = 0;
+        const char* bytes = decodeBytes(src, len, decompress, size);
+        if (bytes == NULL)
+            return false;
+        bool swap = swapNeeded(neworkorder);
+
+        count = size / float_size;
+        size_t pairs = count / 2;
+        first.resize(pairs);
+        second.resize(pairs);
+
+        size_t kept = 0;
+        if (pairs == 0)
+            return true;
+
+        if (float_size == 8 && swap) {
+            kept = convertPairs<uint64_t, double, true>(
+                bytes, pairs, first.data(), second.data());
+        } else if (float_size == 8) {
+            kept = convertPairs<uint64_t, double, false>(
+                bytes, pairs, first.data(), second.data());
+        } else if (swap) {
+            kept = convertPairs<uint32_t, float, true>(
+                bytes, pairs, first.data(), second.data());
+        } else {
+            kept = convertPairs<uint32_t, float, false>(
+                bytes, pairs, first.data(), second.data());
         }
+        first.resize(kept);
+        second.resize(kept);
+        return true;
+    }
+
+    bool decodeBase64(const char* src,
+                      size_t len,
+                      int float_size,
+                      bool neworkorder,
+                      bool decompress,
+                      vector<float>& values)
+    {
+        return decodeValues(
+            src, len, float_size, neworkorder, decompress, values);
+    }
 
+    bool decodeBase64(const char* src,
+                      size_t len,
+                      int float_size,
+                      bool neworkorder,
+                      bool decompress,
+                      vector<double>& values)
+    {
+        return decodeValues(
+            src, len, float_size, neworkorder, decompress, values);
+    }
+
+    vector<float> decodeBase64(const string& src,
+                               int float_size,
+                               bool neworkorder,
+                               bool decompress)
+    {
+        vector<float> decodedArray;
+        decodeBase64(src.data(),
+                     src.size(),
+                     float_size,
+                     neworkorder,
+                     decompress,
+                     decodedArray);
         return decodedArray;
     }
+
+    bool decodeBase64Pairs(const char* src,
+                           size_t len,
+                           int float_size,
+                           bool neworkorder,
+                           bool decompress,
+                           vector<float>& first,
+                           vector<float>& second,
+                           size_t& count)
+    {
+        return decodePairs(src,
+                           len,
+                           float_size,
+                           neworkorder,
+                           decompress,
+                           first,
+                           second,
+                           count);
+    }
+
+    bool decodeBase64Pairs(const char* src,
+                           size_t len,
+                           int float_size,
+                           bool neworkorder,
+                           bool decompress,
+                           vector<double>& first,
+                           vector<float>& second,
+                           size_t& count)
+    {
+        return decodePairs(src,
+                           len,
+                           float_size,
+                           neworkorder,
+                           decompress,
+                           first,
+                           second,
+                           count);
+    }
 } // namespace
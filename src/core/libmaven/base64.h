@@ -46,13 +46,98 @@ namespace base64 {
      * @param decompress Whether the string needs to be decompressed after
      * decoding step.
      * @return A vector of floating point values extracted from undecoded binary
-     * data.
+     * data, empty if the data could not be decoded.
      */
     vector<float> decodeBase64(const string& src,
                                int float_size,
                                bool neworkorder,
                                bool decompress);
 
+    /**
+     * @brief Decode a base64 encoded binary data array into an existing
+     * vector, without intermediate copies of the data.
+     * @param src Start of the base64 encoded data.
+     * @param len Length of the encoded data.
+     * @param float_size Value denoting precision of floating point data.
+     * @param neworkorder Boolean indication network order.
+     * @param decompress Whether the data is zlib compressed.
+     * @param values Set to the decoded floating point values.
+     * @return False if the data could not be decoded (e.g., a corrupt or
+     * truncated zlib stream), in which case no values are set.
+     */
+    bool decodeBase64(const char* src,
+                      size_t len,
+                      int float_size,
+                      bool neworkorder,
+                      bool decompress,
+                      vector<float>& values);
+
+    /**
+     * @brief Same as above, but keeps 64-bit data in double precision.
+     */
+    bool decodeBase64(const char* src,
+                      size_t len,
+                      int float_size,
+                      bool neworkorder,
+                      bool decompress,
+                      vector<double>& values);
+
+    /**
+     * @brief Decode a base64 encoded array of interleaved pairs (such as
+     * m/z-intensity pairs of mzXML) straight into two arrays.
+     * @details Pairs in which either value is not positive are skipped.
+     * @param src Start of the base64 encoded data.
+     * @param len Length of the encoded data.
+     * @param float_size Value denoting precision of floating point data.
+     * @param neworkorder Boolean indication network order.
+     * @param decompress Whether the data is zlib compressed.
+     * @param first Set to the first value of each pair that was kept.
+     * @param second Set to the second value of each pair that was kept.
+     * @param count Set to the number of values decoded, including those of
+     * skipped pairs.
+     * @return False if the data could not be decoded (e.g., a corrupt or
+     * truncated zlib stream), in which case no pairs are set.
+     */
+    bool decodeBase64Pairs(const char* src,
+                           size_t len,
+                           int float_size,
+                           bool neworkorder,
+                           bool decompress,
+                           vector<float>& first,
+                           vector<float>& second,
+                           size_t& count);
+
+    /**
+     * @brief Same as above, but keeps the first value of each pair (e.g.,
+     * m/z) in double precision.
+     */
+    bool decodeBase64Pairs(const char* src,
+                           size_t len,
+                           int float_size,
+                           bool neworkorder,
+                           bool decompress,
+                           vector<double>& first,
+                           vector<float>& second,
+                           size_t& count);
+
+    /**
+     * @brief Size of the data encoded in a base64 string.
+     * @param data A raw base64-encoded buffer.
+     * @param len Length of the buffer containing base64 data.
+     * @return Number of bytes written by base64::decodeInto.
+     */
+    size_t decodedSize(const char* data, const size_t len);
+
+    /**
+     * @brief Decode a plain base64-encoded buffer into memory owned by the
+     * caller.
+     * @param data A raw base64-encoded buffer.
+     * @param len Length of the buffer containing base64 data.
+     * @param dest Destination, at least base64::decodedSize bytes long.
+     * @return Number of bytes written.
+     */
+    size_t decodeInto(const char* data, const size_t len, char* dest);
+
     /**
      * @brief Decode a plain base64-encoded string.
      * @param data A raw base64-encoded buffer.
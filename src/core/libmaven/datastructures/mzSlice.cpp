@@ -5,7 +5,7 @@
 #include "mzMassCalculator.h"
 #include "mzUtils.h"
 
-mzSlice::mzSlice(float minMz, float maxMz, float minRt, float maxRt)
+mzSlice::mzSlice(mzValue minMz, mzValue maxMz, float minRt, float maxRt)
 {
 	mzmin = minMz;
 	mzmax = maxMz;
@@ -67,10 +67,10 @@ bool mzSlice::operator==(const mzSlice &b) const
 
 bool mzSlice::calculateMzMinMax(MassCutoff *compoundMassCutoffWindow, int charge)
 {
-    float adjustedMass = 0.0f;
+    mzValue adjustedMass = 0.0f;
     if (!mzUtils::almostEqual(isotope.mass, 0.0)) {
         // computing the mass (and bounds) based on isotopologue mass
-        adjustedMass = static_cast<float>(isotope.mass);
+        adjustedMass = static_cast<mzValue>(isotope.mass);
     } else if (adduct != nullptr && !compound->formula().empty()) {
         // computing the mass (and bounds) adjusted for adduct's mass
         auto mass = MassCalculator::computeNeutralMass(compound->formula());
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "isotope.h"
+#include "standardincludes.h"
 
 class Compound;
 class MassCutoff;
@@ -33,10 +34,10 @@ class mzSlice
         * @brief Average mz of a mzSlice. Zero in case mzSlice is based on filterline
         * or constructor is empty
         */
-        float mz;
+        mzValue mz;
 
-        float mzmin;
-        float mzmax;
+        mzValue mzmin;
+        mzValue mzmax;
         float rtmin;
         float rtmax;
         float ionCount;
@@ -52,7 +53,7 @@ class mzSlice
         * @param minRt rt minimum of a mzSlice
         * @param maxRt rt maximum of a mzSlice
         */
-        mzSlice(float minMz, float maxMz, float minRt, float maxRt);
+        mzSlice(mzValue minMz, mzValue maxMz, float minRt, float maxRt);
 
         /**
         * @brief Constructor for class mzSlice having a filterline
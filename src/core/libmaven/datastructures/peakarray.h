@@ -0,0 +1,146 @@
+#ifndef PEAKARRAY_H
+#define PEAKARRAY_H
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Values of one kind (m/z or intensity) for the peaks of a scan.
+ * @details The values are either owned by the array, or viewed in a
+ * contiguous buffer that belongs to something else (e.g., the columnar
+ * store of a sample) and is kept alive by a shared owner. Both are read in
+ * the same way, through a pointer and a length, and copying a view shares
+ * the viewed buffer instead of copying its values. Values can only be
+ * edited through `values`, which turns a view into owned values first.
+ */
+template <typename T>
+class PeakArray
+{
+public:
+    PeakArray() : _view(nullptr), _viewSize(0) {}
+
+    PeakArray(const std::vector<T>& values)
+        : _values(values), _view(nullptr), _viewSize(0)
+    {
+    }
+
+    PeakArray& operator=(const std::vector<T>& values)
+    {
+        _release();
+        _values = values;
+        return *this;
+    }
+
+    size_t size() const { return _view ? _viewSize : _values.size(); }
+    bool empty() const { return size() == 0; }
+
+    const T* data() const { return _view ? _view : _values.data(); }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    const T& operator[](size_t i) const { return data()[i]; }
+    const T& front() const { return data()[0]; }
+    const T& back() const { return data()[size() - 1]; }
+
+    bool operator==(const PeakArray& other) const
+    {
+        return size() == other.size()
+               && std::equal(begin(), end(), other.begin());
+    }
+
+    bool operator!=(const PeakArray& other) const { return !(*this == other); }
+
+    /**
+     * @brief Check whether the values are viewed in a buffer owned by
+     * something else.
+     */
+    bool isView() const { return _view != nullptr; }
+
+    /**
+     * @brief Values owned by this array, for editing.
+     * @details A view is first replaced by a copy of the viewed values.
+     */
+    std::vector<T>& values()
+    {
+        if (_view) {
+            std::vector<T> copy(_view, _view + _viewSize);
+            _release();
+            _values.swap(copy);
+        }
+        return _values;
+    }
+
+    template <typename InputIt>
+    void assign(InputIt first, InputIt last)
+    {
+        _release();
+        _values.assign(first, last);
+    }
+
+    void assign(size_t n, const T& value)
+    {
+        _release();
+        _values.assign(n, value);
+    }
+
+    void push_back(const T& value) { values().push_back(value); }
+    void reserve(size_t n) { values().reserve(n); }
+    void resize(size_t n) { values().resize(n); }
+
+    /**
+     * @brief Exchange the owned values with `other`, e.g. to replace them
+     * without copying. A view is dropped, so its values are not handed to
+     * `other`.
+     */
+    void swap(std::vector<T>& other)
+    {
+        _release();
+        _values.swap(other);
+    }
+
+    /**
+     * @brief Drop all values, releasing owned memory or the viewed buffer.
+     */
+    void clear()
+    {
+        _release();
+        std::vector<T>().swap(_values);
+    }
+
+    /**
+     * @brief View `size` values starting at `first`, replacing the current
+     * values.
+     * @param owner Shared owner of the buffer holding the values, kept
+     * alive for as long as this array (or a copy of it) views them.
+     */
+    void view(const T* first, size_t size, std::shared_ptr<const void> owner)
+    {
+        clear();
+        _view = first;
+        _viewSize = size;
+        _owner = owner;
+        if (_view == nullptr)
+            _owner.reset();
+    }
+
+    /**
+     * @brief Memory held by this array itself, excluding any viewed buffer.
+     */
+    size_t ownedBytes() const { return _values.capacity() * sizeof(T); }
+
+private:
+    std::vector<T> _values;
+    const T* _view;
+    size_t _viewSize;
+    std::shared_ptr<const void> _owner;
+
+    void _release()
+    {
+        _view = nullptr;
+        _viewSize = 0;
+        _owner.reset();
+    }
+};
+
+#endif  // PEAKARRAY_H
@@ -0,0 +1,97 @@
+#include <cmath>
+
+#include "scanmzindex.h"
+#include "Scan.h"
+
+ScanMzIndex::ScanMzIndex()
+    : _origin(0.0),
+      _binWidth(0.0f),
+      _numBins(0),
+      _numScans(0),
+      _wordsPerBin(0)
+{
+}
+
+void ScanMzIndex::build(const std::deque<Scan*>& scans, float binWidth)
+{
+    clear();
+    if (scans.empty() || !(binWidth > 0.0f))
+        return;
+
+    mzValue minMz = 0;
+    mzValue maxMz = 0;
+    bool hasPeaks = false;
+    for (auto scan : scans) {
+        for (auto mz : scan->mz) {
+            if (!hasPeaks || mz < minMz)
+                minMz = mz;
+            if (!hasPeaks || mz > maxMz)
+                maxMz = mz;
+            hasPeaks = true;
+        }
+    }
+    if (!hasPeaks)
+        return;
+
+    double range = static_cast<double>(maxMz) - static_cast<double>(minMz);
+    if (range / binWidth >= maxBins)
+        binWidth = range / (maxBins - 1);
+
+    _origin = minMz;
+    _binWidth = binWidth;
+    _numBins = static_cast<size_t>(_bin(maxMz)) + 1;
+    _numScans = scans.size();
+    _wordsPerBin = (_numScans + 63) / 64;
+    _bits.assign(_numBins * _wordsPerBin, 0);
+
+    for (size_t i = 0; i < scans.size(); i++) {
+        uint64_t bit = uint64_t(1) << (i % 64);
+        size_t word = i / 64;
+
+        //peaks are sorted, so each bin is only marked once per scan
+        long long lastBin = -1;
+        for (auto mz : scans[i]->mz) {
+            long long bin = static_cast<long long>(_bin(mz));
+            if (bin == lastBin)
+                continue;
+            _bits[bin * _wordsPerBin + word] |= bit;
+            lastBin = bin;
+        }
+    }
+}
+
+void ScanMzIndex::clear()
+{
+    std::vector<uint64_t>().swap(_bits);
+    _origin = 0.0;
+    _binWidth = 0.0f;
+    _numBins = 0;
+    _numScans = 0;
+    _wordsPerBin = 0;
+}
+
+bool ScanMzIndex::mayContain(size_t scanIndex,
+                             mzValue mzmin,
+                             mzValue mzmax) const
+{
+    if (empty() || scanIndex >= _numScans)
+        return true;
+
+    //clamp before converting, windows may extend far beyond the index
+    double lastBin = static_cast<double>(_numBins) - 1;
+    long long first = std::max(_bin(mzmin), 0.0);
+    long long last = std::min(_bin(mzmax), lastBin);
+
+    uint64_t bit = uint64_t(1) << (scanIndex % 64);
+    size_t word = scanIndex / 64;
+    for (long long bin = first; bin <= last; bin++) {
+        if (_bits[bin * _wordsPerBin + word] & bit)
+            return true;
+    }
+    return false;
+}
+
+double ScanMzIndex::_bin(mzValue mz) const
+{
+    return std::floor((static_cast<double>(mz) - _origin) / _binWidth);
+}
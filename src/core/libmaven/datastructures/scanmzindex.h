@@ -0,0 +1,84 @@
+#ifndef SCANMZINDEX_H
+#define SCANMZINDEX_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "standardincludes.h"
+
+class Scan;
+
+/**
+ * @brief Coarse inverted index from m/z bins to the scans having peaks in
+ * them.
+ * @details The m/z range of a sample is split into bins of equal width, and
+ * every bin holds a bitmap with one bit per scan, set if the scan has at
+ * least one peak in the bin. Scans are referred to by their position in
+ * mzSample::scans, which is also their scan number. Extracting an EIC for a
+ * narrow window can then skip scans that have no peak near the window
+ * without looking at their peaks, which pays off for sparse data (MS2, SIM
+ * or narrow range scans) and for lazily loaded samples.
+ */
+class ScanMzIndex
+{
+public:
+    ScanMzIndex();
+
+    /**
+     * @brief Index the peaks of the given scans, replacing the contents of
+     * the index.
+     * @param scans Scans of a sample, with their peaks in memory.
+     * @param binWidth Width of the m/z bins. It is increased if the m/z range
+     * of the scans would otherwise need more than `maxBins` bins.
+     */
+    void build(const std::deque<Scan*>& scans, float binWidth = 1.0f);
+
+    /**
+     * @brief Release all memory held by the index.
+     */
+    void clear();
+
+    bool empty() const { return _bits.empty(); }
+
+    /**
+     * @brief Check whether a scan may have peaks within an m/z range.
+     * @details Scans that were not indexed are assumed to have peaks
+     * anywhere.
+     * @param scanIndex Position of the scan in the indexed scans.
+     * @return False only if the scan certainly has no peak within
+     * [mzmin, mzmax].
+     */
+    bool mayContain(size_t scanIndex, mzValue mzmin, mzValue mzmax) const;
+
+    /**
+     * @brief Width of the m/z bins actually used.
+     */
+    float binWidth() const { return _binWidth; }
+
+    size_t numBins() const { return _numBins; }
+
+    /**
+     * @brief Number of bytes held by the bitmaps.
+     */
+    size_t memoryUsage() const { return _bits.capacity() * sizeof(uint64_t); }
+
+    static const size_t maxBins = 1 << 16;
+
+private:
+    /**
+     * @brief Bin of an m/z value, which may lie outside of [0, numBins).
+     */
+    double _bin(mzValue mz) const;
+
+    double _origin;
+    float _binWidth;
+    size_t _numBins;
+    size_t _numScans;
+    size_t _wordsPerBin;
+
+    /** bitmaps of all bins, back to back */
+    std::vector<uint64_t> _bits;
+};
+
+#endif // SCANMZINDEX_H
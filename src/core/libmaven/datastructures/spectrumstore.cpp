@@ -0,0 +1,102 @@
+#include "spectrumstore.h"
+#include "Scan.h"
+
+void SpectrumStore::build(const std::deque<Scan*>& scans)
+{
+    clear();
+
+    size_t totalObservations = 0;
+    for (auto scan : scans)
+        totalObservations += scan->nobs();
+
+    auto allMz = std::make_shared<std::vector<mzValue>>();
+    auto allIntensity = std::make_shared<std::vector<float>>();
+    allMz->reserve(totalObservations);
+    allIntensity->reserve(totalObservations);
+    offsets.reserve(scans.size() + 1);
+    rt.reserve(scans.size());
+    mslevel.reserve(scans.size());
+    precursorMz.reserve(scans.size());
+    polarity.reserve(scans.size());
+    filterLineId.reserve(scans.size());
+
+    std::map<std::string, int> filterLineIds;
+    offsets.push_back(0);
+    for (unsigned int row = 0; row < scans.size(); row++) {
+        Scan* scan = scans[row];
+        allMz->insert(allMz->end(), scan->mz.begin(), scan->mz.end());
+        allIntensity->insert(allIntensity->end(),
+                             scan->intensity.begin(),
+                             scan->intensity.end());
+        offsets.push_back(allMz->size());
+
+        rt.push_back(scan->rt);
+        mslevel.push_back(scan->mslevel);
+        precursorMz.push_back(scan->precursorMz);
+        polarity.push_back(scan->getPolarity());
+
+        auto inserted = filterLineIds.insert(
+            std::make_pair(scan->filterLine, static_cast<int>(filterLines.size())));
+        if (inserted.second)
+            filterLines.push_back(scan->filterLine);
+        filterLineId.push_back(inserted.first->second);
+
+        // release the peaks of the scan as soon as they have been copied
+        scan->mz.clear();
+        scan->intensity.clear();
+
+        _rowsByMsLevel[scan->mslevel].push_back(row);
+    }
+    mz = allMz;
+    intensity = allIntensity;
+
+    // nothing is appended anymore, scans can point into the arrays
+    for (unsigned int row = 0; row < scans.size(); row++) {
+        size_t nobs = offsets[row + 1] - offsets[row];
+        scans[row]->mz.view(mz->data() + offsets[row], nobs, mz);
+        scans[row]->intensity.view(intensity->data() + offsets[row],
+                                   nobs,
+                                   intensity);
+    }
+}
+
+void SpectrumStore::updateRetentionTimes(const std::deque<Scan*>& scans)
+{
+    if (scans.size() != rt.size())
+        return;
+
+    for (unsigned int row = 0; row < scans.size(); row++)
+        rt[row] = scans[row]->rt;
+}
+
+void SpectrumStore::clear()
+{
+    mz.reset();
+    intensity.reset();
+    std::vector<size_t>().swap(offsets);
+    std::vector<float>().swap(rt);
+    std::vector<int>().swap(mslevel);
+    std::vector<float>().swap(precursorMz);
+    std::vector<int>().swap(polarity);
+    std::vector<int>().swap(filterLineId);
+    filterLines.clear();
+    _rowsByMsLevel.clear();
+}
+
+const std::vector<unsigned int>& SpectrumStore::rowsAtMsLevel(int level) const
+{
+    static const std::vector<unsigned int> noRows;
+    auto it = _rowsByMsLevel.find(level);
+    if (it == _rowsByMsLevel.end())
+        return noRows;
+    return it->second;
+}
+
+int SpectrumStore::findFilterLine(const std::string& filterLine) const
+{
+    for (unsigned int i = 0; i < filterLines.size(); i++) {
+        if (filterLines[i] == filterLine)
+            return i;
+    }
+    return -1;
+}
@@ -0,0 +1,93 @@
+#ifndef SPECTRUMSTORE_H
+#define SPECTRUMSTORE_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "standardincludes.h"
+
+class Scan;
+
+/**
+ * @brief Columnar (struct-of-arrays) storage of all spectra of a sample.
+ * @details The m/z and intensity values of every scan are packed back to
+ * back in two contiguous arrays, scan `i` occupying the positions
+ * [offsets[i], offsets[i + 1]). The scans do not keep a copy of their
+ * peaks, they view their row of these arrays instead, which remain alive
+ * for as long as any scan views them. Scan metadata is kept in parallel
+ * columns that are indexed by the position of the scan in mzSample::scans,
+ * so a row number of the store is the same as the scan number used by
+ * EICs.
+ */
+class SpectrumStore
+{
+public:
+    std::shared_ptr<const std::vector<mzValue>> mz;
+    std::shared_ptr<const std::vector<float>> intensity;
+    std::vector<size_t> offsets;
+
+    std::vector<float> rt;
+    std::vector<int> mslevel;
+    std::vector<float> precursorMz;
+    std::vector<int> polarity;
+    std::vector<int> filterLineId;
+
+    /** distinct filterlines, referred to by filterLineId */
+    std::vector<std::string> filterLines;
+
+    /**
+     * @brief Pack the given scans into the store, replacing its contents.
+     * @details The peaks of each scan are replaced by a view of its row, so
+     * that they are never held twice.
+     * @param scans Scans of a sample, in retention time order.
+     */
+    void build(const std::deque<Scan*>& scans);
+
+    /**
+     * @brief Copy the current retention times of the scans into the rt column.
+     * @details Must be called whenever the retention times of the scans that
+     * were used to build the store are modified (e.g., after alignment).
+     * @param scans Scans that were used to build the store.
+     */
+    void updateRetentionTimes(const std::deque<Scan*>& scans);
+
+    /**
+     * @brief Release all memory held by the store. The peak arrays are only
+     * released once no scan views them anymore.
+     */
+    void clear();
+
+    bool empty() const { return offsets.empty(); }
+
+    /**
+     * @brief Number of scans (rows) in the store.
+     */
+    size_t size() const { return empty() ? 0 : offsets.size() - 1; }
+
+    /**
+     * @brief Number of observations in the given row.
+     */
+    size_t nobs(size_t row) const { return offsets[row + 1] - offsets[row]; }
+
+    /**
+     * @brief Rows of all scans at a given MS level, in retention time order.
+     * @param level MS level of interest.
+     * @return Row numbers (empty if there are no scans at this level).
+     */
+    const std::vector<unsigned int>& rowsAtMsLevel(int level) const;
+
+    /**
+     * @brief Find the id of a filterline.
+     * @param filterLine Filterline to look for.
+     * @return Index into filterLines, or -1 if no scan has this filterline.
+     */
+    int findFilterLine(const std::string& filterLine) const;
+
+private:
+    std::map<int, std::vector<unsigned int>> _rowsByMsLevel;
+};
+
+#endif // SPECTRUMSTORE_H
@@ -0,0 +1,182 @@
+#include <functional>
+
+#include "eiccache.h"
+#include "EIC.h"
+#include "mzSample.h"
+
+bool EICCache::Key::operator==(const Key& other) const
+{
+    return sample == other.sample
+           && mzmin == other.mzmin
+           && mzmax == other.mzmax
+           && rtmin == other.rtmin
+           && rtmax == other.rtmax
+           && mslevel == other.mslevel
+           && eicType == other.eicType
+           && filterline == other.filterline;
+}
+
+size_t EICCache::KeyHash::operator()(const Key& key) const
+{
+    size_t seed = hash<const mzSample*>()(key.sample);
+    auto combine = [&seed](size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    };
+    combine(hash<mzValue>()(key.mzmin));
+    combine(hash<mzValue>()(key.mzmax));
+    combine(hash<float>()(key.rtmin));
+    combine(hash<float>()(key.rtmax));
+    combine(hash<int>()(key.mslevel));
+    combine(hash<int>()(key.eicType));
+    combine(hash<string>()(key.filterline));
+    return seed;
+}
+
+EICCache::EICCache(size_t memoryLimit)
+    : _memoryLimit(memoryLimit),
+      _memoryUsage(0),
+      _hits(0),
+      _misses(0),
+      _evictions(0)
+{
+}
+
+EICCache::~EICCache()
+{
+    clear();
+}
+
+EIC* EICCache::find(const Key& key)
+{
+    lock_guard<mutex> lock(_mutex);
+    auto entry = _entries.find(key);
+    if (entry == _entries.end()) {
+        ++_misses;
+        return nullptr;
+    }
+
+    ++_hits;
+    _recency.splice(_recency.begin(), _recency, entry->second.position);
+    return entry->second.eic->cloneTrace();
+}
+
+void EICCache::insert(const Key& key, const EIC* eic)
+{
+    if (eic == nullptr)
+        return;
+
+    size_t bytes = _sizeOf(eic);
+    if (bytes > _memoryLimit)
+        return;
+
+    // copy outside the lock, traces can be long
+    EIC* copy = eic->cloneTrace();
+
+    lock_guard<mutex> lock(_mutex);
+    if (_entries.count(key) > 0) {
+        // another thread has extracted the same trace in the meantime
+        delete copy;
+        return;
+    }
+
+    _recency.push_front(key);
+    _entries[key] = {copy, bytes, _recency.begin()};
+    _memoryUsage += bytes;
+    _evict();
+}
+
+EIC* EICCache::getEIC(mzSample* sample,
+                      mzValue mzmin,
+                      mzValue mzmax,
+                      float rtmin,
+                      float rtmax,
+                      int mslevel,
+                      int eicType,
+                      const string& filterline)
+{
+    Key key = {sample,
+               mzmin,
+               mzmax,
+               rtmin,
+               rtmax,
+               mslevel,
+               eicType,
+               filterline};
+    EIC* eic = find(key);
+    if (eic != nullptr)
+        return eic;
+
+    eic = sample->getEIC(mzmin,
+                         mzmax,
+                         rtmin,
+                         rtmax,
+                         mslevel,
+                         eicType,
+                         filterline);
+    insert(key, eic);
+    return eic;
+}
+
+void EICCache::clear()
+{
+    lock_guard<mutex> lock(_mutex);
+    for (auto& elem : _entries)
+        delete elem.second.eic;
+    _entries.clear();
+    _recency.clear();
+    _memoryUsage = 0;
+}
+
+size_t EICCache::hits() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _hits;
+}
+
+size_t EICCache::misses() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _misses;
+}
+
+size_t EICCache::evictions() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _evictions;
+}
+
+size_t EICCache::size() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _entries.size();
+}
+
+size_t EICCache::memoryUsage() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _memoryUsage;
+}
+
+size_t EICCache::_sizeOf(const EIC* eic)
+{
+    size_t n = eic->intensity.size();
+    size_t bytes = sizeof(EIC) + eic->sampleName.capacity();
+    bytes += n * (sizeof(int) + sizeof(float) + sizeof(mzValue) + sizeof(float));
+    if (eic->baseline != nullptr)
+        bytes += n * sizeof(float);
+    if (eic->spline != nullptr)
+        bytes += n * sizeof(float);
+    return bytes;
+}
+
+void EICCache::_evict()
+{
+    while (_memoryUsage > _memoryLimit && !_recency.empty()) {
+        auto entry = _entries.find(_recency.back());
+        _memoryUsage -= entry->second.bytes;
+        delete entry->second.eic;
+        _entries.erase(entry);
+        _recency.pop_back();
+        ++_evictions;
+    }
+}
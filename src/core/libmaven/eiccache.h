@@ -0,0 +1,138 @@
+#ifndef EICCACHE_H
+#define EICCACHE_H
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "standardincludes.h"
+
+class EIC;
+class mzSample;
+
+using namespace std;
+
+/**
+ * @brief Memory-capped cache of EIC traces, shared by the stages of a single
+ * peak detection run.
+ *
+ * @details During a detection run, the same m/z windows can be extracted
+ * several times: when peaks are detected and again when isotopologues are
+ * searched for. The cache keeps the
+ * traces pulled for a (sample, window) pair, so that each of them is
+ * extracted only once per run. Entries hold raw traces, and are evicted in
+ * least-recently-used order when their total size exceeds the memory limit.
+ *
+ * Entries are never invalidated, the cache is therefore only meant to live as
+ * long as a run in which samples (and their retention times) do not change.
+ * All methods can be called concurrently.
+ */
+class EICCache
+{
+  public:
+    /**
+     * @brief Everything that decides the contents of a cached trace.
+     */
+    struct Key
+    {
+        const mzSample* sample;
+        mzValue mzmin;
+        mzValue mzmax;
+        float rtmin;
+        float rtmax;
+        int mslevel;
+        int eicType;
+        string filterline;
+
+        bool operator==(const Key& other) const;
+    };
+
+    /**
+     * @brief Create an empty cache.
+     * @param memoryLimit Maximum number of bytes held by cached traces.
+     */
+    EICCache(size_t memoryLimit);
+
+    ~EICCache();
+
+    /**
+     * @brief Find a cached trace.
+     * @return A copy of the trace, owned by the caller, or nullptr if there is
+     * none for this key.
+     */
+    EIC* find(const Key& key);
+
+    /**
+     * @brief Store a copy of a trace. Peaks of the EIC are not stored.
+     * @details Traces larger than the memory limit are not cached at all.
+     */
+    void insert(const Key& key, const EIC* eic);
+
+    /**
+     * @brief Get the raw trace for a window of a sample, extracting it with
+     * `mzSample::getEIC` if it has not been cached yet.
+     * @return A new EIC, owned by the caller.
+     */
+    EIC* getEIC(mzSample* sample,
+                mzValue mzmin,
+                mzValue mzmax,
+                float rtmin,
+                float rtmax,
+                int mslevel,
+                int eicType,
+                const string& filterline);
+
+    /**
+     * @brief Remove all entries. Hit and miss counts are kept.
+     */
+    void clear();
+
+    size_t hits() const;
+    size_t misses() const;
+    size_t evictions() const;
+    size_t size() const;
+
+    /**
+     * @brief Number of bytes currently held by cached traces.
+     */
+    size_t memoryUsage() const;
+
+    size_t memoryLimit() const { return _memoryLimit; }
+
+  private:
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry
+    {
+        EIC* eic;
+        size_t bytes;
+        list<Key>::iterator position;
+    };
+
+    /**
+     * @brief Approximate number of bytes used by the data of an EIC.
+     */
+    static size_t _sizeOf(const EIC* eic);
+
+    /**
+     * @brief Evict least recently used entries until the cache is within its
+     * memory limit. Must be called with the lock held.
+     */
+    void _evict();
+
+    size_t _memoryLimit;
+    size_t _memoryUsage;
+    size_t _hits;
+    size_t _misses;
+    size_t _evictions;
+
+    /** keys, most recently used first */
+    list<Key> _recency;
+    unordered_map<Key, Entry, KeyHash> _entries;
+    mutable mutex _mutex;
+};
+
+#endif  // EICCACHE_H
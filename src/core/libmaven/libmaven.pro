@@ -104,6 +104,9 @@ SOURCES = base64.cpp \
           comparesampleslogic.cpp \
           isotopelogic.cpp \
           eiclogic.cpp \
+          eiccache.cpp \
+          smoothingengine.cpp \
+          aslssolver.cpp \
           database.cpp \
           PolyAligner.cpp \
           jsonReports.cpp \
@@ -112,11 +115,14 @@ SOURCES = base64.cpp \
           groupFiltering.cpp \
           datastructures/adduct.cpp \
           datastructures/mzSlice.cpp \
+          datastructures/spectrumstore.cpp \
+          datastructures/scanmzindex.cpp \
           groupClassifier.cpp \
           groupFeatures.cpp \
           svmPredictor.cpp \
           zlib.cpp \
           spectrallibexport.cpp \
+          xmlelementreader.cpp \
           datastructures/isotope.cpp
 
 HEADERS += constants.h \
@@ -144,6 +150,9 @@ HEADERS += constants.h \
            comparesampleslogic.h \
            isotopelogic.h \
            eiclogic.h \
+           eiccache.h \
+           smoothingengine.h \
+           aslssolver.h \
            EIC.h \
 	       Scan.h \
            SRMList.h \
@@ -155,9 +164,13 @@ HEADERS += constants.h \
            groupFiltering.h \
            datastructures/adduct.h \
            datastructures/mzSlice.h \
+           datastructures/spectrumstore.h \
+           datastructures/scanmzindex.h \
+           datastructures/peakarray.h \
            settings.h \
            groupClassifier.h \
            groupFeatures.h \
            svmPredictor.h \
            spectrallibexport.h \
+           xmlelementreader.h \
            datastructures/isotope.h
@@ -1,3 +1,6 @@
+#include <array>
+#include <atomic>
+
 #include <omp.h>
 
 #include <boost/signals2.hpp>
@@ -19,7 +22,8 @@
 
 using namespace mzUtils;
 
-MassSlicer::MassSlicer(MavenParameters* mp) : _mavenParameters(mp)
+MassSlicer::MassSlicer(MavenParameters* mp)
+    : partitionSlices(true), _mavenParameters(mp)
 {
     _samples = _mavenParameters->samples;
 }
@@ -253,11 +257,15 @@ void MassSlicer::findFeatureSlices(bool clearPrevious)
 
     sendSignal("Status", 0 , 1);
 
+    // candidates are kept by value until they have been reduced, only the
+    // ones that survive become slices
+    vector<SliceCandidate> candidates;
+
     // looping over every sample
     for (unsigned int i = 0; i < _samples.size(); i++) {
         // Check if peak detection has been cancelled by the user
         if (_mavenParameters->stop) {
-            clearSlices();
+            candidates.clear();
             break;
         }
 
@@ -276,7 +284,7 @@ void MassSlicer::findFeatureSlices(bool clearPrevious)
         for (auto scan : _samples[i]->scans) {
             // Check if Peak detection has been cancelled by the user
             if (_mavenParameters->stop) {
-                clearSlices();
+                candidates.clear();
                 break;
             }
 
@@ -291,12 +299,13 @@ void MassSlicer::findFeatureSlices(bool clearPrevious)
 
             float rt = scan->rt;
 
-            for (unsigned int k = 0; k < scan->nobs(); k++) {
-                float mz = scan->mz[k];
-                float intensity = scan->intensity[k];
+            auto scanData = _samples[i]->loadScanData(scan);
+            for (unsigned int k = 0; k < scanData->nobs(); k++) {
+                mzValue mz = scanData->mz[k];
+                float intensity = scanData->intensity[k];
 
                 // Checking if mz, intensity are within specified ranges
-                if (!isBetweenInclusive(mz, minFeatureMz, maxFeatureMz))
+                if (!isBetweenInclusive<mzValue>(mz, minFeatureMz, maxFeatureMz))
                     continue;
 
                 if (!isBetweenInclusive(intensity,
@@ -305,16 +314,17 @@ void MassSlicer::findFeatureSlices(bool clearPrevious)
                     continue;
                 }
 
-                // create new slice with the given bounds
+                // create new candidate slice with the given bounds
                 float cutoff = massCutoff->massCutoffValue(mz);
-                mzSlice* s = new mzSlice(mz - cutoff,
-                                         mz + cutoff,
-                                         rt - rtWindow,
-                                         rt + rtWindow);
-                s->ionCount = intensity;
-                s->rt = scan->rt;
-                s->mz = mz;
-                slices.push_back(s);
+                SliceCandidate candidate;
+                candidate.mzmin = mz - cutoff;
+                candidate.mzmax = mz + cutoff;
+                candidate.rtmin = rt - rtWindow;
+                candidate.rtmax = rt + rtWindow;
+                candidate.ionCount = intensity;
+                candidate.rt = scan->rt;
+                candidate.mz = mz;
+                candidates.push_back(candidate);
             }
 
             // progress update 
@@ -324,25 +334,38 @@ void MassSlicer::findFeatureSlices(bool clearPrevious)
                                       + " out of "
                                       + to_string(_mavenParameters->samples.size())
                                       + " sample(s)…\n"
-                                      + to_string(slices.size())
+                                      + to_string(candidates.size())
                                       + " slices created";
                 sendSignal(progressText,currentScans,totalScans);
             }
         }
     }
 
-    cerr << "Found " << slices.size() << " slices" << endl;
+    cerr << "Found " << candidates.size() << " slices" << endl;
 
     // before reduction sort by mz first then by rt
-    sort(begin(slices),
-         end(slices),
-         [](const mzSlice* slice, const mzSlice* compSlice) {
-             if (slice->mz == compSlice->mz) {
-                 return slice->rt < compSlice->rt;
+    sort(begin(candidates),
+         end(candidates),
+         [](const SliceCandidate& slice, const SliceCandidate& compSlice) {
+             if (slice.mz == compSlice.mz) {
+                 return slice.rt < compSlice.rt;
              }
-             return slice->mz < compSlice->mz;
+             return slice.mz < compSlice.mz;
          });
-    _reduceSlices(massCutoff);
+    _reduceSlices(candidates, massCutoff);
+
+    slices.reserve(slices.size() + candidates.size());
+    for (const auto& candidate : candidates) {
+        mzSlice* slice = new mzSlice(candidate.mzmin,
+                                     candidate.mzmax,
+                                     candidate.rtmin,
+                                     candidate.rtmax);
+        slice->ionCount = candidate.ionCount;
+        slice->rt = candidate.rt;
+        slice->mz = candidate.mz;
+        slices.push_back(slice);
+    }
+    vector<SliceCandidate>().swap(candidates);
 
     cerr << "Reduced to " << slices.size() << " slices" << endl;
 
@@ -357,90 +380,191 @@ void MassSlicer::findFeatureSlices(bool clearPrevious)
     sendSignal("Mass slicing done.", 1 , 1);
 }
 
-void MassSlicer::_reduceSlices(MassCutoff* massCutoff)
+void MassSlicer::_reduceSlices(vector<SliceCandidate>& candidates,
+                               MassCutoff* massCutoff)
 {
-    for (auto first = begin(slices); first != end(slices); ++first) {
-        if (_mavenParameters->stop) {
-            clearSlices();
-            break;
+    // A candidate is only ever compared with the ones that follow it, until
+    // one starts beyond its original upper m/z bound. Candidates are sorted by
+    // m/z, so wherever none of the preceding candidates reach the lower bound
+    // of the next one, the vector can be cut into parts that are reduced
+    // independently, and still give the same result as a single pass.
+    vector<pair<size_t, size_t>> partitions;
+    size_t partitionStart = 0;
+    mzValue reach = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (i > partitionStart && reach < candidates[i].mzmin) {
+            partitions.push_back(make_pair(partitionStart, i));
+            partitionStart = i;
         }
-
-        auto firstSlice = *first;
-        if (mzUtils::almostEqual(firstSlice->ionCount, -1.0f))
+        reach = i == partitionStart ? candidates[i].mzmax
+                                    : std::max(reach, candidates[i].mzmax);
+    }
+    if (partitionStart < candidates.size())
+        partitions.push_back(make_pair(partitionStart, candidates.size()));
+    if (!partitionSlices && !partitions.empty())
+        partitions = {make_pair(size_t(0), candidates.size())};
+
+    atomic<size_t> reduced(0);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (size_t p = 0; p < partitions.size(); ++p) {
+        if (_mavenParameters->stop)
             continue;
 
-        // we will use this to terminate large shifts in slices, where they
-        // might end up losing their original information completely
-        auto originalMax = firstSlice->mzmax;
+        auto partitionBegin = begin(candidates) + partitions[p].first;
+        auto partitionEnd = begin(candidates) + partitions[p].second;
+        for (auto first = partitionBegin; first != partitionEnd; ++first) {
+            auto& firstSlice = *first;
+            if (mzUtils::almostEqual(firstSlice.ionCount, -1.0f))
+                continue;
 
-        for (auto second = next(first); second != end(slices); ++second) {
-            auto secondSlice = *second;
+            // we will use this to terminate large shifts in slices, where
+            // they might end up losing their original information completely
+            auto originalMax = firstSlice.mzmax;
 
-            // stop iterating if the rest of the slices are too far
-            if (originalMax < secondSlice->mzmin
-                || firstSlice->mzmax < secondSlice->mzmin)
-                break;
+            for (auto second = next(first); second != partitionEnd; ++second) {
+                auto& secondSlice = *second;
 
-            if (mzUtils::almostEqual(secondSlice->ionCount, -1.0f))
-                continue;
+                // stop iterating if the rest of the slices are too far
+                if (originalMax < secondSlice.mzmin
+                    || firstSlice.mzmax < secondSlice.mzmin)
+                    break;
 
-            // check if center of one of the slices lies in the other
-            if ((firstSlice->mz > secondSlice->mzmin
-                 && firstSlice->mz < secondSlice->mzmax
-                 && firstSlice->rt > secondSlice->rtmin
-                 && firstSlice->rt < secondSlice->rtmax)
-                ||
-                (secondSlice->mz > firstSlice->mzmin
-                 && secondSlice->mz < firstSlice->mzmax
-                 && secondSlice->rt > firstSlice->rtmin
-                 && secondSlice->rt < firstSlice->rtmax)) {
-                firstSlice->ionCount = std::max(firstSlice->ionCount,
-                                                secondSlice->ionCount);
-                firstSlice->rtmax = std::max(firstSlice->rtmax,
-                                             secondSlice->rtmax);
-                firstSlice->rtmin = std::min(firstSlice->rtmin,
-                                             secondSlice->rtmin);
-                firstSlice->mzmax = std::max(firstSlice->mzmax,
-                                             secondSlice->mzmax);
-                firstSlice->mzmin = std::min(firstSlice->mzmin,
-                                             secondSlice->mzmin);
-
-                firstSlice->mz = (firstSlice->mzmin + firstSlice->mzmax) / 2.0f;
-                firstSlice->rt = (firstSlice->rtmin + firstSlice->rtmax) / 2.0f;
-                float cutoff = massCutoff->massCutoffValue(firstSlice->mz);
-
-                // make sure that mz window does not get out of control
-                if (firstSlice->mzmin < firstSlice->mz - cutoff)
-                    firstSlice->mzmin =  firstSlice->mz - cutoff;
-                if (firstSlice->mzmax > firstSlice->mz + cutoff)
-                    firstSlice->mzmax =  firstSlice->mz + cutoff;
-
-                // recalculate center mz in case bounds changed
-                firstSlice->mz = (firstSlice->mzmin + firstSlice->mzmax) / 2.0f;
-
-                // flag this slice as already merged, and ignore henceforth
-                secondSlice->ionCount = -1.0f;
+                if (mzUtils::almostEqual(secondSlice.ionCount, -1.0f))
+                    continue;
+
+                // check if center of one of the slices lies in the other
+                if ((firstSlice.mz > secondSlice.mzmin
+                     && firstSlice.mz < secondSlice.mzmax
+                     && firstSlice.rt > secondSlice.rtmin
+                     && firstSlice.rt < secondSlice.rtmax)
+                    ||
+                    (secondSlice.mz > firstSlice.mzmin
+                     && secondSlice.mz < firstSlice.mzmax
+                     && secondSlice.rt > firstSlice.rtmin
+                     && secondSlice.rt < firstSlice.rtmax)) {
+                    firstSlice.ionCount = std::max(firstSlice.ionCount,
+                                                   secondSlice.ionCount);
+                    firstSlice.rtmax = std::max(firstSlice.rtmax,
+                                                secondSlice.rtmax);
+                    firstSlice.rtmin = std::min(firstSlice.rtmin,
+                                                secondSlice.rtmin);
+                    firstSlice.mzmax = std::max(firstSlice.mzmax,
+                                                secondSlice.mzmax);
+                    firstSlice.mzmin = std::min(firstSlice.mzmin,
+                                                secondSlice.mzmin);
+
+                    firstSlice.mz = (firstSlice.mzmin + firstSlice.mzmax)
+                                    / 2.0f;
+                    firstSlice.rt = (firstSlice.rtmin + firstSlice.rtmax)
+                                    / 2.0f;
+                    float cutoff = massCutoff->massCutoffValue(firstSlice.mz);
+
+                    // make sure that mz window does not get out of control
+                    if (firstSlice.mzmin < firstSlice.mz - cutoff)
+                        firstSlice.mzmin =  firstSlice.mz - cutoff;
+                    if (firstSlice.mzmax > firstSlice.mz + cutoff)
+                        firstSlice.mzmax =  firstSlice.mz + cutoff;
+
+                    // recalculate center mz in case bounds changed
+                    firstSlice.mz = (firstSlice.mzmin + firstSlice.mzmax)
+                                    / 2.0f;
+
+                    // flag this slice as already merged, and ignore henceforth
+                    secondSlice.ionCount = -1.0f;
+                }
             }
         }
-        sendSignal("Reducing redundant slices…",
-                   first - begin(slices),
-                   slices.size());
+
+        // progress is only reported from the calling thread
+        reduced += partitions[p].second - partitions[p].first;
+        if (omp_get_thread_num() == 0)
+            sendSignal("Reducing redundant slices…",
+                       reduced,
+                       candidates.size());
+    }
+
+    if (_mavenParameters->stop) {
+        candidates.clear();
+        return;
     }
 
     // remove merged slices
-    vector<size_t> indexesToErase;
+    candidates.erase(remove_if(begin(candidates),
+                               end(candidates),
+                               [](const SliceCandidate& candidate) {
+                                   return candidate.ionCount == -1.0f;
+                               }),
+                     end(candidates));
+}
+
+void MassSlicer::_mergeSlices(const MassCutoff* massCutoff,
+                              const float rtTolerance)
+{
+    // Two slices are only compared if the centres of their m/z windows are
+    // within 20 times the mass cutoff of each other, otherwise iteration stops
+    // (see `_compareSlices`). Merged slices never grow beyond the combined
+    // bounds of the slices they were made from, so wherever the gap between
+    // the bounds of consecutive slices is wider than that, slices on either
+    // side can never be merged and the parts are merged independently.
+    // lowest bound of each slice and all the ones after it
+    vector<mzValue> lowestAfter(slices.size());
+    for (size_t i = slices.size(); i-- > 0;) {
+        lowestAfter[i] = slices[i]->mzmin;
+        if (i + 1 < slices.size())
+            lowestAfter[i] = std::min(lowestAfter[i], lowestAfter[i + 1]);
+    }
+
+    vector<vector<mzSlice*>> partitions;
+    mzValue reach = 0;
     for (size_t i = 0; i < slices.size(); ++i) {
-        auto slice = slices[i];
-        if (slice->ionCount == -1.0f) {
-            delete slice;
-            indexesToErase.push_back(i);
+        if (partitions.empty()) {
+            partitions.emplace_back();
+            reach = slices[i]->mzmax;
+        } else if (partitionSlices) {
+            // with some margin over 20x the cutoff, for rounding errors
+            mzValue center = (lowestAfter[i] + reach) / 2.0f;
+            mzValue gap = lowestAfter[i] - reach;
+            if (gap > 25.0f * massCutoff->massCutoffValue(center))
+                partitions.emplace_back();
         }
+        reach = std::max(reach, slices[i]->mzmax);
+        partitions.back().push_back(slices[i]);
+    }
+
+    // with a single partition, threads are better used to compare slices
+    bool parallelPartitions = partitions.size() > 1;
+    atomic<size_t> merged(0);
+    size_t total = slices.size();
+#pragma omp parallel for schedule(dynamic, 1) if (parallelPartitions)
+    for (size_t p = 0; p < partitions.size(); ++p) {
+        if (_mavenParameters->stop)
+            continue;
+
+        // the very first slice is never compared with the ones after it
+        _mergeSlicesInPartition(partitions[p], p == 0, massCutoff, rtTolerance);
+
+        // progress is only reported from the calling thread
+        merged += partitions[p].size();
+        if (omp_get_thread_num() == 0)
+            sendSignal("Merging adjacent slices…", merged, total);
+    }
+
+    // slices deleted while merging have only been removed from partitions
+    slices.clear();
+    if (_mavenParameters->stop) {
+        for (auto& partition : partitions)
+            delete_all(partition);
+        return;
     }
-    mzUtils::eraseIndexes(slices, indexesToErase);
+
+    for (auto& partition : partitions)
+        slices.insert(end(slices), begin(partition), end(partition));
 }
 
-void MassSlicer::_mergeSlices(const MassCutoff* massCutoff,
-                              const float rtTolerance)
+void MassSlicer::_mergeSlicesInPartition(vector<mzSlice*>& partition,
+                                         bool isFirstPartition,
+                                         const MassCutoff* massCutoff,
+                                         const float rtTolerance)
 {
     // lambda to help expand a given slice by merging a vector of slices into it
     auto expandSlice = [&](mzSlice* mergeInto, vector<mzSlice*> slices) {
@@ -469,23 +593,15 @@ void MassSlicer::_mergeSlices(const MassCutoff* massCutoff,
         mergeInto->mz = (mergeInto->mzmin + mergeInto->mzmax) / 2.0f;
     };
 
-    for(auto it = begin(slices); it != end(slices); ++it) {
-        if (_mavenParameters->stop) {
-            clearSlices();
+    for(auto it = begin(partition); it != end(partition); ++it) {
+        if (_mavenParameters->stop)
             break;
-        }
-
-        sendSignal("Merging adjacent slices…",
-                   it - begin(slices),
-                   slices.size());
 
         auto slice = *it;
         vector<mzSlice*> slicesToMerge;
 
         // search ahead
-        for (auto ahead = next(it);
-             ahead != end(slices) && it != end(slices);
-             ++ahead) {
+        for (auto ahead = next(it); ahead != end(partition); ++ahead) {
             auto comparisonSlice = *ahead;
             auto comparison = _compareSlices(_samples,
                                              slice,
@@ -500,10 +616,12 @@ void MassSlicer::_mergeSlices(const MassCutoff* massCutoff,
                 break;
         }
 
-        // search behind
-        for (auto behind = prev(it);
-             behind != begin(slices) && it != begin(slices);
-             --behind) {
+        // search behind, down to the first slice of the partition (but not
+        // the first of all slices)
+        auto lowest = isFirstPartition ? next(begin(partition))
+                                       : begin(partition);
+        for (auto behind = it; it != begin(partition) && behind != lowest;) {
+            --behind;
             auto comparisonSlice = *behind;
             auto comparison = _compareSlices(_samples,
                                              slice,
@@ -523,14 +641,14 @@ void MassSlicer::_mergeSlices(const MassCutoff* massCutoff,
         // merged
         expandSlice(slice, slicesToMerge);
         for (auto merged : slicesToMerge) {
-            slices.erase(remove_if(begin(slices),
-                                   end(slices),
-                                   [&](mzSlice* s) { return s == merged; }),
-                         slices.end());
+            partition.erase(remove_if(begin(partition),
+                                      end(partition),
+                                      [&](mzSlice* s) { return s == merged; }),
+                            partition.end());
             delete merged;
         }
-        it = find_if(begin(slices),
-                     end(slices),
+        it = find_if(begin(partition),
+                     end(partition),
                      [&](mzSlice* s) { return s == slice; });
     }
 }
@@ -581,60 +699,64 @@ pair<bool, bool> MassSlicer::_compareSlices(vector<mzSample*>& samples,
     if (commonLowerRt == 0.0f && commonUpperRt == 0.0f)
         return make_pair(false, true);
 
+    // maxima are stored per sample and compared in sample order afterwards,
+    // so that ties are broken the same way regardless of thread scheduling
+    vector<array<float, 3>> eicValues(samples.size());
+    vector<array<float, 3>> comparisonEicValues(samples.size());
+#pragma omp parallel for
+    for (size_t i = 0; i < samples.size(); ++i) {
+        auto sample = samples.at(i);
+
+        // obtain the highest points of the EICs for the two slices, without
+        // creating the EICs themselves
+        float maxIntensity, rtAtMax;
+        mzValue mzAtMax;
+        sample->getEICMaximum(mzMin,
+                              mzMax,
+                              rtMin,
+                              rtMax,
+                              1,
+                              1,
+                              "",
+                              maxIntensity,
+                              rtAtMax,
+                              mzAtMax);
+        eicValues[i] = {maxIntensity, rtAtMax, static_cast<float>(mzAtMax)};
+
+        sample->getEICMaximum(comparisonMzMin,
+                              comparisonMzMax,
+                              comparisonRtMin,
+                              comparisonRtMax,
+                              1,
+                              1,
+                              "",
+                              maxIntensity,
+                              rtAtMax,
+                              mzAtMax);
+        comparisonEicValues[i] = {maxIntensity,
+                                  rtAtMax,
+                                  static_cast<float>(mzAtMax)};
+    }
+
+    // obtain the highest intensity's mz and rt
     auto highestIntensity = 0.0f;
     auto mzAtHighestIntensity = 0.0f;
     auto rtAtHighestIntensity = 0.0f;
     auto highestCompIntensity = 0.0f;
     auto mzAtHighestCompIntensity = 0.0f;
     auto rtAtHighestCompIntensity = 0.0f;
-#pragma omp parallel
-    {
-        vector<vector<float>> eicValues;
-        vector<vector<float>> comparisonEicValues;
-#pragma omp for nowait
-        for (size_t i = 0; i < samples.size(); ++i) {
-            auto sample = samples.at(i);
-
-            // obtain EICs for the two slices
-            auto eic = sample->getEIC(mzMin,
-                                      mzMax,
-                                      rtMin,
-                                      rtMax,
-                                      1,
-                                      1,
-                                      "");
-            auto comparisonEic = sample->getEIC(comparisonMzMin,
-                                                comparisonMzMax,
-                                                comparisonRtMin,
-                                                comparisonRtMax,
-                                                1,
-                                                1,
-                                                "");
-            eicValues.push_back({eic->maxIntensity,
-                                 eic->rtAtMaxIntensity,
-                                 eic->mzAtMaxIntensity});
-            comparisonEicValues.push_back({comparisonEic->maxIntensity,
-                                           comparisonEic->rtAtMaxIntensity,
-                                           comparisonEic->mzAtMaxIntensity});
-            delete eic;
-            delete comparisonEic;
-        }
-#pragma omp critical
-        // obtain the highest intensity's mz and rt
-        // these updates should happen in a single thread
-        for (auto values : eicValues) {
-            if (highestIntensity < values[0]) {
-                highestIntensity = values[0];
-                rtAtHighestIntensity = values[1];
-                mzAtHighestIntensity = values[2];
-            }
+    for (const auto& values : eicValues) {
+        if (highestIntensity < values[0]) {
+            highestIntensity = values[0];
+            rtAtHighestIntensity = values[1];
+            mzAtHighestIntensity = values[2];
         }
-        for (auto values : comparisonEicValues) {
-            if (highestCompIntensity < values[0]) {
-                highestCompIntensity = values[0];
-                rtAtHighestCompIntensity = values[1];
-                mzAtHighestCompIntensity = values[2];
-            }
+    }
+    for (const auto& values : comparisonEicValues) {
+        if (highestCompIntensity < values[0]) {
+            highestCompIntensity = values[0];
+            rtAtHighestCompIntensity = values[1];
+            mzAtHighestCompIntensity = values[2];
         }
     }
 
@@ -668,6 +790,7 @@ void MassSlicer::_adjustSlices(MassCutoff* massCutoff)
             break;
         }
 
+        // the slice bounds change below, so these EICs are not cached
         auto eics = PeakDetector::pullEICs(slice,
                                            _mavenParameters->samples,
                                            _mavenParameters);
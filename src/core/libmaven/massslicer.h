@@ -54,7 +54,30 @@ class MassSlicer {
          */
         void clearSlices();
 
+        /**
+         * @brief Whether slices found for features are reduced and merged in
+         * independent m/z partitions, in parallel. The resulting slices are
+         * the same either way.
+         */
+        bool partitionSlices;
+
     private:
+        /**
+         * @brief A slice around a single observation, considered while slicing
+         * for features. Candidates are kept by value since there can be tens
+         * of millions of them before they are reduced.
+         */
+        struct SliceCandidate
+        {
+            mzValue mz;
+            mzValue mzmin;
+            mzValue mzmax;
+            float rt;
+            float rtmin;
+            float rtmax;
+            float ionCount;
+        };
+
         vector<mzSample*> _samples;
         MavenParameters* _mavenParameters;
 
@@ -76,10 +99,26 @@ class MassSlicer {
          * "closeness" of two points in two different slices.
          * @param updateMessage A string message that will be emitted along with
          * progress updates on the completion of the merge operation.
+         * Slices are merged in independent m/z partitions, in parallel, unless
+         * `partitionSlices` is unset.
          */
         void _mergeSlices(const MassCutoff* massCutoff,
                           const float rtTolerance);
 
+        /**
+         * @brief Merge slices of an m/z partition, as done by `_mergeSlices`.
+         * Slices merged into others are deleted and removed from the
+         * partition.
+         * @param partition Slices sorted by m/z, none of which can be merged
+         * with slices outside the partition.
+         * @param isFirstPartition Whether the partition starts with the first
+         * of all slices, which is never compared with the slices after it.
+         */
+        void _mergeSlicesInPartition(vector<mzSlice*>& partition,
+                                     bool isFirstPartition,
+                                     const MassCutoff* massCutoff,
+                                     const float rtTolerance);
+
         /**
          * @brief A function that takes in a vector of `mzSample` objects, and
          * two pointers to the mzSlices that need to be compared.
@@ -107,12 +146,17 @@ class MassSlicer {
                                         const float rtTolerance);
 
         /**
-         * @brief This method will reduce the internal slice vector by merging
-         * and resizing them if they share a signifant region of interest.
+         * @brief This method will reduce a vector of candidate slices by
+         * merging and resizing them if they share a signifant region of
+         * interest. Candidates are reduced in independent m/z partitions,
+         * in parallel, unless `partitionSlices` is unset.
+         * @param candidates Candidate slices, sorted by m/z and then by rt.
+         * Merged candidates are removed from it.
          * @param massCutoff A `MassCutoff` object that will be used to check
          * proximity of two slices in m/z domain.
          */
-        void _reduceSlices(MassCutoff *massCutoff);
+        void _reduceSlices(vector<SliceCandidate>& candidates,
+                           MassCutoff *massCutoff);
 
         /**
          * @brief Adjust all slices in m/z domain such that they are centered
@@ -63,6 +63,8 @@ MavenParameters::MavenParameters(string settingsPath):lastUsedSettingsPath(setti
         baseline_dropTopX = 80;
         aslsSmoothness = 2;
         aslsAsymmetry = 80;
+        baselineWindowMode = false;
+        baselineWindowPadding = 1.0f;
 
         isIsotopeEqualPeakFilter = false;
         minSignalBaselineDifference = 0;
@@ -71,6 +73,7 @@ MavenParameters::MavenParameters(string settingsPath):lastUsedSettingsPath(setti
         minIsotopicPeakQuality = 0.0;
 
         eicType = 0;
+        eicCacheSize = 0;
 
         // peak grouping across samples
         grouping_maxRtWindow = 0.5;
@@ -118,6 +121,8 @@ MavenParameters::MavenParameters(string settingsPath):lastUsedSettingsPath(setti
 
         alignMaxIterations = 10;  //TODO: Sahil - Kiran, Added while merging mainwindow
         alignPolynomialDegree = 5; //TODO: Sahil - Kiran, Added while merging mainwindow
+        obiWarpDropEmptyColumns = false;
+        obiWarpMaxRtShift = 0.0f;
         
         quantileQuality = 0.0;
         quantileIntensity = 0.0;
@@ -227,6 +232,8 @@ void MavenParameters::copyFrom(const MavenParameters& mp)
     baseline_dropTopX = mp.baseline_dropTopX;
     aslsSmoothness = mp.aslsSmoothness;
     aslsAsymmetry = mp.aslsAsymmetry;
+    baselineWindowMode = mp.baselineWindowMode;
+    baselineWindowPadding = mp.baselineWindowPadding;
 
     isIsotopeEqualPeakFilter = mp.isIsotopeEqualPeakFilter;
     minSignalBaselineDifference = mp.minSignalBaselineDifference;
@@ -235,6 +242,7 @@ void MavenParameters::copyFrom(const MavenParameters& mp)
     minIsotopicPeakQuality = mp.minIsotopicPeakQuality;
 
     eicType = mp.eicType;
+    eicCacheSize = mp.eicCacheSize;
 
     grouping_maxRtWindow = mp.grouping_maxRtWindow;
 
@@ -284,6 +292,8 @@ void MavenParameters::copyFrom(const MavenParameters& mp)
 
     alignMaxIterations = mp.alignMaxIterations;
     alignPolynomialDegree = mp.alignPolynomialDegree;
+    obiWarpDropEmptyColumns = mp.obiWarpDropEmptyColumns;
+    obiWarpMaxRtShift = mp.obiWarpMaxRtShift;
 
     quantileQuality = mp.quantileQuality;
     quantileIntensity = mp.quantileIntensity;
@@ -574,6 +584,21 @@ void MavenParameters::setOptionsDialogSettings(const char* key, const char* valu
         }
     }
 
+    if (strcmp(key, "spectrumStore") == 0)
+        mzSample::setUseSpectrumStore(stoi(value) == 1);
+
+    if (strcmp(key, "lazyScanLoading") == 0)
+        mzSample::setLazyScanLoading(stoi(value) == 1);
+
+    if (strcmp(key, "scanCacheSize") == 0)
+        mzSample::setScanCacheSize(stoi(value));
+
+    if (strcmp(key, "obiWarpDropEmptyColumns") == 0)
+        obiWarpDropEmptyColumns = stoi(value) == 1;
+
+    if (strcmp(key, "obiWarpMaxRtShift") == 0)
+        obiWarpMaxRtShift = atof(value);
+
     if(strcmp(key, "eicSmoothingAlgorithm") == 0)
         eic_smoothingAlgorithm = atof(value);
 
@@ -598,6 +623,12 @@ void MavenParameters::setOptionsDialogSettings(const char* key, const char* valu
     if(strcmp(key, "aslsAsymmetry") == 0)
         aslsAsymmetry = atoi(value);
 
+    if(strcmp(key, "baselineWindowMode") == 0)
+        baselineWindowMode = static_cast<bool>(atoi(value));
+
+    if(strcmp(key, "baselineWindowPadding") == 0)
+        baselineWindowPadding = atof(value);
+
     if(strcmp(key, "isotopeFilterEqualPeak") == 0)
         isIsotopeEqualPeakFilter = atof(value);    
 
@@ -616,6 +647,9 @@ void MavenParameters::setOptionsDialogSettings(const char* key, const char* valu
     if(strcmp(key, "eicType") == 0)
         eicType = atof(value);
 
+    if(strcmp(key, "eicCacheSize") == 0)
+        eicCacheSize = atoi(value);
+
     if(strcmp(key, "useOverlap") == 0)
         useOverlap = atof(value);
 
@@ -137,6 +137,18 @@ class MavenParameters
         int aslsSmoothness;
         int aslsAsymmetry;
 
+        /**
+        * extract EICs (and estimate their baselines) only over the RT range
+        * of a slice, padded on both sides, instead of the whole sample
+        */
+        bool baselineWindowMode;
+
+        /**
+        * padding (in minutes) added on each side of a slice's RT range in
+        * window mode
+        */
+        float baselineWindowPadding;
+
         bool isIsotopeEqualPeakFilter;
         double minSignalBaselineDifference;
         double isotopicMinSignalBaselineDifference;
@@ -145,6 +157,12 @@ class MavenParameters
 
         int eicType;
 
+        /**
+        * memory (in MB) available for caching EICs during a detection run,
+        * caching is disabled if zero (the default)
+        */
+        int eicCacheSize;
+
         //peak filtering
         float minSignalBlankRatio;
         float minNoNoiseObs;
@@ -259,6 +277,18 @@ class MavenParameters
         int alignMaxIterations; //TODO: Sahil - Kiran, Added while merging mainwindow
         int alignPolynomialDegree; //TODO: Sahil - Kiran, Added while merging mainwindow
 
+        /**
+        * leave out m/z bins that are empty in both samples when aligning
+        * with OBI-Warp
+        */
+        bool obiWarpDropEmptyColumns;
+
+        /**
+        * largest retention time shift (in minutes) searched by OBI-Warp,
+        * the whole score matrix is searched if zero
+        */
+        float obiWarpMaxRtShift;
+
         /**
         * [print parameter Settings]
         * @method printSettings
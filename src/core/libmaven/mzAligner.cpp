@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include <QJsonArray>
 #include <QJsonValue>
 
@@ -91,6 +93,7 @@ void Aligner::restoreFit() {
 		for(unsigned int ii=0; ii < samples[i]->scans.size(); ii++ ) {
 			samples[i]->scans[ii]->rt = fit[i][ii];
 		}
+		samples[i]->retentionTimesUpdated();
 	}
 }
 vector<double> Aligner::groupMeanRt() {
@@ -161,6 +164,7 @@ void Aligner::PolyFit(int poly_align_degree) {
                     for(unsigned int ii=0; ii < sample->scans.size(); ii++ ) {
                         sample->scans[ii]->rt = stats->predict(sample->scans[ii]->rt);
                     }
+                    sample->retentionTimesUpdated();
 
                     for(unsigned int ii=0; ii < allgroups.size(); ii++ ) {
                         Peak* p = allgroups[ii]->getPeak(sample);
@@ -289,6 +293,7 @@ void Aligner::Fit(int ideg) {
                     failedTransformation++;
                 }
             }
+            sample->retentionTimesUpdated();
 
             for(unsigned int ii=0; ii < allgroups.size(); ii++ ) {
                 Peak* p = allgroups[ii]->getPeak(sample);
@@ -336,32 +341,45 @@ bool Aligner::alignSampleRts(mzSample* sample,
     }
 
     vector<float> rtPoints;
-    vector<vector<float> > mxn;
+    vector<Scan*> binnedScans;
 
     int intervalCounter = 0;
     for(auto scan: sample->scans) {
         if (mp->stop) return (true);
         if (scan->mslevel == 1 && (intervalCounter % rtBinSize == 0 || scan == sample->scans.back())) {
             rtPoints.push_back(scan->originalRt);
-            mxn.push_back(vector<float> (mzPoints.size()));
+            binnedScans.push_back(scan);
         }
         ++intervalCounter;
     }
 
-    intervalCounter = 0;
-    int mxnCount = 0;
-    for(auto scan: sample->scans) {
-        if (scan->mslevel == 1 && (intervalCounter % rtBinSize == 0 || scan == sample->scans.back())) {
-            mxnCount++;
-            for(int i = 0; i <  scan->mz.size(); i++) {
-                if (mp->stop) return (true);
-                if (scan->mz.at(i) < mzPoints.front() || scan->mz.at(i) > mzPoints.back())
-                    continue;
-                int index = upper_bound(mzPoints.begin(), mzPoints.end(), scan->mz.at(i)) - mzPoints.begin() -1;
-                mxn[mxnCount - 1][index] = max(mxn[mxnCount -1][index], scan->intensity.at(i));
-            }
+    // bin intensities straight into the matrix used by ObiWarp, with one row
+    // per retention time and one column per m/z bin
+    MatF mxn(rtPoints.size(), mzPoints.size(), 0.0f);
+    float mzStart = mzPoints.front();
+    float mzEnd = mzPoints.back();
+    int lastBin = mzPoints.size() - 1;
+    double mzStep = lastBin > 0 ? (mzEnd - mzStart) / lastBin : 1.0;
+    for (size_t row = 0; row < binnedScans.size(); ++row) {
+        if (mp->stop) return (true);
+        auto scan = sample->loadScanData(binnedScans[row]);
+        float* binnedIntensities = mxn.rowData(row);
+        for (size_t i = 0; i < scan->nobs(); ++i) {
+            mzValue mz = scan->mz[i];
+            if (mz < mzStart || mz > mzEnd)
+                continue;
+
+            // bins are evenly spaced up to the rounding of their edges, so
+            // the estimated bin is at most a few bins away from the last
+            // edge that is not greater than the m/z
+            int index = min(static_cast<int>((mz - mzStart) / mzStep), lastBin);
+            while (index < lastBin && mzPoints[index + 1] <= mz)
+                ++index;
+            while (index > 0 && mzPoints[index] > mz)
+                --index;
+            binnedIntensities[index] = max(binnedIntensities[index],
+                                           scan->intensity[i]);
         }
-        ++intervalCounter;
     }
 
     if (setAsReference) {
@@ -369,7 +387,7 @@ bool Aligner::alignSampleRts(mzSample* sample,
         obiWarp.setReferenceData(rtPoints, mzPoints, mxn);
     }
     else {
-        vector<float> updatedRtPoints = obiWarp.align(rtPoints, mzPoints, mxn);
+        vector<float> updatedRtPoints = obiWarp.align(rtPoints, mxn);
         if (updatedRtPoints.empty())
             return(true);
 
@@ -437,9 +455,10 @@ bool Aligner::alignWithObiWarp(vector<mzSample*> samples,
     for(const auto scan: refSample->scans) {
         // PRM/DDA data have both mslevel 1 and mslevel 2 scans. We only want to align mslevel 1 scans
         if(scan->mslevel == 1) {
-            for(const auto mz: scan->mz) {
-                minMzRange = min(minMzRange, mz);
-                maxMzRange = max(maxMzRange, mz);
+            auto scanData = refSample->loadScanData(scan);
+            for(const auto mz: scanData->mz) {
+                minMzRange = min(minMzRange, static_cast<float>(mz));
+                maxMzRange = max(maxMzRange, static_cast<float>(mz));
             }
         }
     }
@@ -464,30 +483,37 @@ bool Aligner::alignWithObiWarp(vector<mzSample*> samples,
 
     _alignmentSegments.clear();
     setSamples(samples);
+
+    // the reference data is only read from now on, all samples are aligned
+    // against the same ObiWarp object concurrently
     int samplesAligned = 0;
+    atomic<bool> interrupted(false);
     #pragma omp parallel
     {
         map<string,vector<AlignmentSegment>> alignmentSegment_private;
-        samplesAligned = 0;
-        #pragma for shared(samplesAligned)
+        #pragma omp for schedule(dynamic)
         for (int i = 0; i < samples.size(); ++i) {
             if (samples[i] == refSample)
                 continue;
-            if (mp->stop || stopped) {
-                stopped = true;
-            }
+            if (mp->stop || interrupted)
+                continue;
 
             if (alignSampleRts(samples[i], mzPoints, *obiWarp, false, mp, alignmentSegment_private)) {
-                stopped = true;
-            } else {
+                interrupted = true;
+                continue;
+            }
+
+            #pragma omp critical(alignmentProgress)
+            {
                 samplesAligned++;
                 setAlignmentProgress("Aligning samples", samplesAligned, samples.size()-1);
             }
         }
-    #pragma critical
+        #pragma omp critical(alignmentSegments)
         _alignmentSegments.insert(alignmentSegment_private.begin(),
                                   alignmentSegment_private.end());
     }
+    stopped = interrupted || mp->stop;
 
     setAlignmentProgress("Performing post-alignment interpolation…", 1, 1);
     performSegmentedAlignment();
@@ -496,10 +522,14 @@ bool Aligner::alignWithObiWarp(vector<mzSample*> samples,
     return(stopped);
 }
 
-float AlignmentSegment::updateRt(float oldRt)
+float AlignmentSegment::updateRt(float oldRt) const
 {
     // fractional distance from start of a segement
     if (oldRt >= segStart and oldRt <= segEnd) {
+        // an empty segment only holds its end
+        if (segEnd == segStart)
+            return newEnd;
+
         float frac = (oldRt - segStart) / (segEnd - segStart);
         return newStart + frac * (newEnd - newStart);
     } else {
@@ -515,37 +545,70 @@ float AlignmentSegment::updateRt(float oldRt)
     }
 }
 
+AlignmentSegmentTable::AlignmentSegmentTable(
+    const vector<AlignmentSegment>& segments)
+    : _segments(segments)
+{
+    auto byEnd = [](const AlignmentSegment& a, const AlignmentSegment& b) {
+        return a.segEnd < b.segEnd;
+    };
+    if (!is_sorted(begin(_segments), end(_segments), byEnd))
+        stable_sort(begin(_segments), end(_segments), byEnd);
+
+    _segEnds.reserve(_segments.size());
+    for (const auto& segment : _segments)
+        _segEnds.push_back(segment.segEnd);
+}
+
+const AlignmentSegment* AlignmentSegmentTable::segmentFor(float rt) const
+{
+    // segments before the first one ending at or after rt cannot hold it,
+    // and as each segment starts where the previous one ends, neither can
+    // the ones following a segment that starts after rt
+    auto it = lower_bound(begin(_segEnds), end(_segEnds), rt);
+    if (it == end(_segEnds))
+        return nullptr;
+
+    const AlignmentSegment& segment = _segments[it - begin(_segEnds)];
+    if (segment.segStart > rt)
+        return nullptr;
+    return &segment;
+}
+
 void Aligner::performSegmentedAlignment()
 {
+    // only look up the segments of each sample once
+    vector<pair<mzSample*, vector<AlignmentSegment>*>> sampleSegments;
     for (auto sample : samples) {
         if (sample == nullptr)
             continue;
 
-        string sampleName = sample->sampleName;
-        if (_alignmentSegments.count(sampleName) == 0) {
+        auto segments = _alignmentSegments.find(sample->sampleName);
+        if (segments == _alignmentSegments.end())
             continue;
-        }
 
-        for (auto scan : sample->scans) {
-            AlignmentSegment* seg = nullptr;
-            for (auto segment : _alignmentSegments[sampleName]) {
-                if (scan->rt >= segment.segStart
-                    && scan->rt <= segment.segEnd) {
-                    seg = &segment;
-                    break;
-                }
-            }
+        sampleSegments.push_back(make_pair(sample, &segments->second));
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned int i = 0; i < sampleSegments.size(); i++) {
+        mzSample* sample = sampleSegments[i].first;
+        AlignmentSegmentTable table(*sampleSegments[i].second);
 
+        for (auto scan : sample->scans) {
+            const AlignmentSegment* seg = table.segmentFor(scan->rt);
             if (seg) {
                 double newRt = seg->updateRt(scan->rt);
                 scan->rt = newRt;
             } else {
+                #pragma omp critical(segmentedAlignmentLog)
                 cerr << "Cannot find segment for: "
-                     << sampleName
+                     << sample->sampleName
                      << "\t"
                      << scan->rt
                      << endl;
             }
         }
+        sample->retentionTimesUpdated();
     }
 }
@@ -20,7 +20,35 @@ struct AlignmentSegment {
     float segEnd;
     float newStart;
     float newEnd;
-    float updateRt(float oldRt);
+    float updateRt(float oldRt) const;
+};
+
+/**
+ * @brief Segments mapping the original retention times of one sample to
+ * aligned ones, sorted by their original end times.
+ * @details Segments of a sample follow each other, each one starting where
+ * the previous one ends. The end times are kept in a separate contiguous
+ * array, so that the segment of a retention time is found with a binary
+ * search instead of a scan over all segments.
+ */
+class AlignmentSegmentTable
+{
+public:
+    AlignmentSegmentTable(const vector<AlignmentSegment>& segments);
+
+    /**
+     * @brief Find the segment holding a retention time.
+     * @param rt An original retention time.
+     * @return The first segment such that `segStart <= rt <= segEnd`, or
+     * nullptr if there is none.
+     */
+    const AlignmentSegment* segmentFor(float rt) const;
+
+    size_t size() const { return _segments.size(); }
+
+private:
+    vector<AlignmentSegment> _segments;
+    vector<float> _segEnds;
 };
 
 class Aligner {
@@ -74,7 +102,8 @@ class Aligner {
     /**
      * @brief Perform alignment using segments of known retention times, where
      * the rt values in-between these known (aligned) segments will be simply
-     * interpolated.
+     * interpolated. Samples are updated in parallel, each one looking up its
+     * scans in an `AlignmentSegmentTable`.
      */
     void performSegmentedAlignment();
 
@@ -10,6 +10,7 @@
 #include "Matrix.h"
 #include "EIC.h"
 #include "Scan.h"
+#include "xmlelementreader.h"
 
 #include <MavenException.h>
 
@@ -19,10 +20,26 @@ bool mzSample::filter_centroidScans = false;
 int mzSample::filter_intensityQuantile = 0;
 int mzSample::filter_polarity = 0;
 int mzSample::filter_mslevel = 0;
+bool mzSample::useSpectrumStore = false;
+bool mzSample::lazyScanLoading = false;
+int mzSample::scanCacheSize = 64;
+bool mzSample::useScanMzIndex = false;
+const vector<string> mzSample::filterChromatogram {
+    "sample",
+    "start",
+    "end",
+    "index",
+    "scan"
+};
 
 mzSample::mzSample() : _setName(""), injectionOrder(0)
 {
     _id = -1;
+    _lazyScans = false;
+    _streamOffset = -1;
+    _cachedScanBytes = 0;
+    _ionChromatogramScanCount = 0;
+    _fragmentationIndexScanCount = 0;
     _numMS1Scans = 0;
     _numMS2Scans = 0;
     maxMz = maxRt = 0;
@@ -73,24 +90,7 @@ void mzSample::addScan(Scan* s)
         return;
     }
 
-    // unsigned int sizeBefore = s->intensity.size();
-    if (mzSample::filter_centroidScans == true) {
-        s->simpleCentroid();
-    }
-
-    // unsigned int sizeAfter1 = s->intensity.size();
-
-    if (mzSample::filter_intensityQuantile > 0) {
-        s->quantileFilter(mzSample::filter_intensityQuantile);
-    }
-    // unsigned int sizeAfter2 = s->intensity.size();
-
-    if (mzSample::filter_minIntensity > 0) {
-        s->intensityFilter(mzSample::filter_minIntensity);
-    }
-    // unsigned int sizeAfter3 = s->intensity.size();
-    // cerr << "addScan " << sizeBefore <<  " " << sizeAfter1 << " " <<
-    // sizeAfter2 << " " << sizeAfter3 << endl;
+    applyScanFilters(s);
 
     if (s->mslevel == 1)
         ++_numMS1Scans;
@@ -99,6 +99,7 @@ void mzSample::addScan(Scan* s)
 
     scans.push_back(s);
     s->scannum = scans.size() - 1;
+    _scansByMsLevel[s->mslevel].push_back(s);
 
     //recalculate precursorMz of MS2 scans
     if (s->mslevel == 2 && _numMS1Scans > 0) {
@@ -107,6 +108,21 @@ void mzSample::addScan(Scan* s)
     }
 }
 
+void mzSample::applyScanFilters(Scan* s)
+{
+    if (mzSample::filter_centroidScans == true) {
+        s->simpleCentroid();
+    }
+
+    if (mzSample::filter_intensityQuantile > 0) {
+        s->quantileFilter(mzSample::filter_intensityQuantile);
+    }
+
+    if (mzSample::filter_minIntensity > 0) {
+        s->intensityFilter(mzSample::filter_minIntensity);
+    }
+}
+
 string mzSample::getFileName(const string& filename)
 {
     char sep = '/';
@@ -162,22 +178,46 @@ void mzSample::checkSampleBlank(const char* filename)
 
 void mzSample::loadSample(string filename)
 {
+    // Setting Sample name, lazily loaded scans are read back from the file
+    // while loading
+    sampleNaming(filename.c_str());
+
     // Loading and Decoding the file
     // catch any error while parsing
     try {
         loadAnySample(filename);
     } catch (MavenException& excp) {
         cerr << endl << "Error: " << excp.what() << endl;
+
+        // scans read before the error are dropped, so that the sample is
+        // not used with part of its data
+        clearScans();
     }
 
     // getting the SRM scan type
     enumerateSRMScans();
 
-    // set min and max values for rt and mz
+    // group scans by MS level for EIC extraction
+    indexScans();
+
+    // set min and max values for rt and mz, and summarize every scan
     calculateMzRtRange();
 
-    // Setting Sample name
-    sampleNaming(filename.c_str());
+    // bitmaps of the scans with peaks in each m/z bin
+    if (mzSample::useScanMzIndex)
+        buildScanMzIndex();
+
+    // MS2 scans by precursor m/z, for fragmentation lookups
+    buildFragmentationIndex();
+
+    // peaks move into the columnar store, once summaries and indices that
+    // read them have been built; lazily loaded scans keep them in the file
+    if (mzSample::useSpectrumStore && !mzSample::lazyScanLoading)
+        buildSpectrumStore();
+
+    // peaks will be read back from the file when needed
+    if (mzSample::lazyScanLoading)
+        releaseScanData();
 
     // Checking if a sample is blank or not
     checkSampleBlank(filename.c_str());
@@ -269,7 +309,7 @@ void mzSample::writeMzCSV(const char* filename)
     mzCSV << "scannum,rt,mz,intensity,mslevel,precursorMz,polarity,srmid"
           << endl;
     for (unsigned int i = 0; i < scans.size(); i++) {
-        Scan* scan = scans[i];
+        auto scan = loadScanData(scans[i]);
         for (unsigned int j = 0; j < scan->nobs(); j++) {
             mzCSV << scan->scannum + 1 << "," << scan->rt * 60 << ","
                   << scan->mz[j] << "," << scan->intensity[j] << ","
@@ -286,8 +326,329 @@ int mzSample::getPolarity()
         return scans[0]->getPolarity();
     return 0;
 }
+bool mzSample::streamMzML(const char* filename)
+{
+    XMLElementReader reader(filename);
+    if (!reader.isOpen())
+        return false;
+
+    const vector<string> tags = {"run", "spectrum", "chromatogramList"};
+    int scannum = 0;
+    int numSpectra = 0;
+    string name, element;
+    while (reader.findStartTag(tags, name)) {
+        if (name == "run") {
+            xml_document doc;
+            string tag = reader.startTag();
+            doc.load_buffer(tag.data(), tag.size(), parse_minimal);
+            parseMzMLInjectionTimeStamp(
+                doc.first_child().attribute("startTimeStamp"));
+        } else if (name == "spectrum") {
+            xml_document doc;
+            if (!reader.readElement(element)
+                || !doc.load_buffer_inplace(&element[0],
+                                            element.size(),
+                                            parse_minimal)) {
+                clearScans();
+                return false;
+            }
+            Scan* scan = parseMzMLSpectrum(doc.first_child(), scannum);
+            if (scan) {
+                scan->fileSeekStart = reader.tagOffset();
+                scan->fileSeekEnd = scan->fileSeekStart + element.size();
+                addScan(scan);
+                scannum++;
+            }
+            numSpectra++;
+        } else {
+            // chromatograms are listed after all spectra
+            break;
+        }
+    }
+    return numSpectra > 0;
+}
+
+bool mzSample::canLoadScanHeaders()
+{
+    return mzSample::lazyScanLoading && !mzSample::useScanMzIndex
+           && !mzSample::filter_centroidScans
+           && mzSample::filter_intensityQuantile <= 0
+           && mzSample::filter_minIntensity <= 0;
+}
+
+bool mzSample::readScanIndex(const char* filename,
+                             const char* indexName,
+                             vector<pair<long long, long long> >& ranges)
+{
+    ranges.clear();
+    ifstream file(filename, ios::in | ios::binary);
+    if (!file.is_open())
+        return false;
+
+    // the offset of the index is written at the very end of the file
+    file.seekg(0, ios::end);
+    long long fileSize = file.tellg();
+    long long tailStart = max(0LL, fileSize - 4096);
+    string tail(fileSize - tailStart, '\0');
+    file.seekg(tailStart);
+    if (tail.empty() || !file.read(&tail[0], tail.size()))
+        return false;
+
+    size_t offsetTag = tail.rfind("<indexListOffset>");
+    if (offsetTag == string::npos)
+        offsetTag = tail.rfind("<indexOffset>");
+    if (offsetTag == string::npos)
+        return false;
+    long long indexOffset =
+        strtoll(tail.c_str() + tail.find('>', offsetTag) + 1, NULL, 10);
+    long long indexEnd = tailStart + offsetTag;
+    if (indexOffset <= 0 || indexOffset >= indexEnd)
+        return false;
+
+    string index(indexEnd - indexOffset, '\0');
+    file.seekg(indexOffset);
+    if (!file.read(&index[0], index.size()))
+        return false;
+
+    // parse the indices on their own, without the list holding them
+    size_t first = index.find("<index ");
+    size_t last = index.rfind("</index>");
+    if (first == string::npos || last == string::npos || last < first)
+        return false;
+    xml_document doc;
+    if (!doc.load_buffer_inplace(&index[first],
+                                 last + strlen("</index>") - first,
+                                 parse_minimal | parse_fragment)) {
+        return false;
+    }
+
+    vector<long long> starts;
+    vector<long long> bounds(1, indexOffset);
+    for (xml_node node = doc.child("index"); node;
+         node = node.next_sibling("index")) {
+        bool isScanIndex = strcmp(node.attribute("name").value(), indexName)
+                           == 0;
+        for (xml_node offset = node.child("offset"); offset;
+             offset = offset.next_sibling("offset")) {
+            long long position = strtoll(offset.child_value(), NULL, 10);
+            if (position <= 0 || position >= indexOffset)
+                return false;
+            bounds.push_back(position);
+            if (isScanIndex)
+                starts.push_back(position);
+        }
+    }
+
+    sort(starts.begin(), starts.end());
+    starts.erase(unique(starts.begin(), starts.end()), starts.end());
+    sort(bounds.begin(), bounds.end());
+    for (auto start : starts) {
+        long long end = *upper_bound(bounds.begin(), bounds.end(), start);
+        ranges.push_back(make_pair(start, end));
+    }
+    return !ranges.empty();
+}
+
+bool mzSample::readScanHeader(ifstream& file,
+                              const pair<long long, long long>& range,
+                              const string& tag,
+                              const string& peaksTag,
+                              string& header)
+{
+    const string startTag = "<" + tag;
+    const string endTag = "</" + tag + ">";
+    const string peaksStartTag = "<" + peaksTag;
+    const size_t chunkSize = 4096;
+
+    header.clear();
+    file.clear();
+    file.seekg(range.first);
+    long long remaining = range.second - range.first;
+    size_t searchFrom = 0;
+    while (remaining > 0) {
+        size_t size = min(static_cast<long long>(chunkSize), remaining);
+        size_t start = header.size();
+        header.resize(start + size);
+        if (!file.read(&header[start], size))
+            return false;
+        remaining -= size;
+
+        if (start == 0 && header.compare(0, startTag.size(), startTag) != 0)
+            return false;
+
+        size_t peaks = header.find(peaksStartTag, searchFrom);
+        size_t end = header.find(endTag, searchFrom);
+        if (end != string::npos && (peaks == string::npos || end < peaks)) {
+            header.clear();
+            return true;
+        }
+        if (peaks != string::npos) {
+            header.resize(peaks);
+            header += endTag;
+            return true;
+        }
+
+        // tags may straddle the chunks read
+        size_t overlap = max(endTag.size(), peaksStartTag.size());
+        searchFrom = header.size() > overlap ? header.size() - overlap : 0;
+    }
+    return false;
+}
+
+// value of one unit in the last decimal place of a number written in a
+// file, e.g. 0.001 for "70.065"
+static double lastDigitUnit(const char* value)
+{
+    const char* exponent = strpbrk(value, "eE");
+    const char* end = exponent ? exponent : value + strlen(value);
+    const char* point = strchr(value, '.');
+    int decimals = (point && point < end) ? end - point - 1 : 0;
+    int power = exponent ? atoi(exponent + 1) : 0;
+    return pow(10.0, power - decimals);
+}
+
+// summarize a scan whose peaks are left in the file from the values written
+// in its header, widening the m/z bounds by the precision they were written
+// with; false if any of the values is missing
+static bool setHeaderSummary(Scan* scan,
+                             unsigned int nobs,
+                             const char* lowMz,
+                             const char* highMz,
+                             const char* basePeakMz,
+                             const char* basePeakIntensity,
+                             const char* totalIntensity)
+{
+    if (nobs == 0) {
+        scan->setSummary(0, 0, 0, 0, 0, 0);
+        return true;
+    }
+    if (*lowMz == '\0' || *highMz == '\0' || *basePeakMz == '\0'
+        || *basePeakIntensity == '\0' || *totalIntensity == '\0') {
+        return false;
+    }
+
+    scan->setSummary(nobs,
+                     strtod(lowMz, NULL) - lastDigitUnit(lowMz),
+                     strtod(highMz, NULL) + lastDigitUnit(highMz),
+                     strtod(basePeakMz, NULL),
+                     strtod(basePeakIntensity, NULL),
+                     strtod(totalIntensity, NULL));
+    return true;
+}
+
+bool mzSample::loadMzMLHeaders(const char* filename)
+{
+    vector<pair<long long, long long> > ranges;
+    if (!readScanIndex(filename, "spectrum", ranges))
+        return false;
+
+    // the injection time is written on the run, ahead of the spectra
+    XMLElementReader reader(filename, 1 << 16);
+    const vector<string> tags = {"run", "spectrum"};
+    string name;
+    if (reader.findStartTag(tags, name) && name == "run") {
+        xml_document doc;
+        string tag = reader.startTag();
+        doc.load_buffer(tag.data(), tag.size(), parse_minimal);
+        parseMzMLInjectionTimeStamp(
+            doc.first_child().attribute("startTimeStamp"));
+    }
+
+    // MS1 scans are read back while loading, to recalculate the precursor
+    // m/z of MS2 scans
+    _lazyScans = true;
+
+    ifstream file(filename, ios::in | ios::binary);
+    int scannum = 0;
+    string header;
+    bool loaded = true;
+    for (const auto& range : ranges) {
+        xml_document doc;
+        if (!readScanHeader(file,
+                            range,
+                            "spectrum",
+                            "binaryDataArrayList",
+                            header)
+            || (!header.empty()
+                && !doc.load_buffer_inplace(&header[0],
+                                            header.size(),
+                                            parse_minimal))) {
+            loaded = false;
+            break;
+        }
+
+        // spectra without binary data are skipped, as when parsing them
+        if (header.empty())
+            continue;
+
+        xml_node spectrum = doc.first_child();
+        const char* lowMz = "";
+        const char* highMz = "";
+        const char* basePeakMz = "";
+        const char* basePeakIntensity = "";
+        const char* totalIntensity = "";
+        for (xml_node cv = spectrum.child("cvParam"); cv;
+             cv = cv.next_sibling("cvParam")) {
+            switch (mzMLTerm(cv)) {
+            case MzMLTerm::LowestObservedMz:
+                lowMz = cv.attribute("value").value();
+                break;
+            case MzMLTerm::HighestObservedMz:
+                highMz = cv.attribute("value").value();
+                break;
+            case MzMLTerm::BasePeakMz:
+                basePeakMz = cv.attribute("value").value();
+                break;
+            case MzMLTerm::BasePeakIntensity:
+                basePeakIntensity = cv.attribute("value").value();
+                break;
+            case MzMLTerm::TotalIonCurrent:
+                totalIntensity = cv.attribute("value").value();
+                break;
+            default:
+                break;
+            }
+        }
+
+        Scan* scan = parseMzMLSpectrumHeader(spectrum, scannum);
+        if (scan == NULL
+            || !setHeaderSummary(
+                   scan,
+                   spectrum.attribute("defaultArrayLength").as_uint(),
+                   lowMz,
+                   highMz,
+                   basePeakMz,
+                   basePeakIntensity,
+                   totalIntensity)) {
+            delete scan;
+            loaded = false;
+            break;
+        }
+        scan->fileSeekStart = range.first;
+        scan->fileSeekEnd = range.second;
+        addScan(scan);
+        scannum++;
+    }
+
+    if (!loaded) {
+        clearScans();
+        _lazyScans = false;
+    }
+    return loaded;
+}
+
 void mzSample::parseMzML(const char* filename)
 {
+    // with lazy loading, read just the headers of the spectra of indexed
+    // files and leave their peaks in the file
+    if (canLoadScanHeaders() && loadMzMLHeaders(filename))
+        return;
+
+    // read spectra one at a time, falling back to loading the whole
+    // document for files that cannot be streamed (e.g. chromatograms only)
+    if (streamMzML(filename))
+        return;
+
     xml_document doc;
 
     const unsigned int parse_options = parse_minimal;
@@ -362,10 +723,12 @@ void mzSample::parseMzMLChromatogramList(const xml_node& chromatogramList)
 
         xml_node activationNode =
             chromatogram.first_element_by_path("precursor/activation");
-        map<string, string> activationParams = mzML_cvParams(activationNode);
         float collisionEnergy = 0.0f;
-        if (activationParams.count("collision energy"))
-            collisionEnergy = string2float(activationParams["collision energy"]);
+        for (xml_node cv = activationNode.child("cvParam"); cv;
+             cv = cv.next_sibling("cvParam")) {
+            if (mzMLTerm(cv) == MzMLTerm::CollisionEnergy)
+                collisionEnergy = string2float(cv.attribute("value").value());
+        }
 
         int scanPolarity = -1;
         for (xml_node binaryDataArray = binaryDataArrayList.child("binaryDataArray");
@@ -373,34 +736,68 @@ void mzSample::parseMzMLChromatogramList(const xml_node& chromatogramList)
              binaryDataArray =
                  binaryDataArray.next_sibling("binaryDataArray")) {
 
-            map<string, string> attr = mzML_cvParams(binaryDataArray);
-
             int precision = 64;
-            if (attr.count("32-bit float"))
-                precision = 32;
-
             bool decompress = false;
-            if(attr.count("zlib compression"))
-                decompress=true;
+            bool isTimeArray = false;
+            bool isIntensityArray = false;
+            bool positiveScan = false;
+            bool negativeScan = false;
+            for (xml_node cv = binaryDataArray.child("cvParam"); cv;
+                 cv = cv.next_sibling("cvParam")) {
+                switch (mzMLTerm(cv)) {
+                case MzMLTerm::Float32:
+                    precision = 32;
+                    break;
+                case MzMLTerm::ZlibCompression:
+                    decompress = true;
+                    break;
+                case MzMLTerm::TimeArray:
+                    isTimeArray = true;
+                    break;
+                case MzMLTerm::IntensityArray:
+                    isIntensityArray = true;
+                    break;
+                case MzMLTerm::PositiveScan:
+                    positiveScan = true;
+                    break;
+                case MzMLTerm::NegativeScan:
+                    negativeScan = true;
+                    break;
+                default:
+                    break;
+                }
+            }
 
-            if (attr.count("positive scan")) {
+            if (positiveScan) {
                 scanPolarity = 1;
-            } else if (attr.count("negative scan")) {
+            } else if (negativeScan) {
                 scanPolarity = -1;
             }
 
-            string binaryDataStr =
+            const char* binaryData =
                 binaryDataArray.child("binary").child_value();
-            vector<float> binaryData = base64::decodeBase64(binaryDataStr,
-                                                             precision / 8,
-                                                             false,
-                                                             decompress);
-
-            if (attr.count("time array")) {
-                timeVector = binaryData;
+            size_t binaryLength = strlen(binaryData);
+            bool decoded = true;
+            if (isTimeArray) {
+                decoded = base64::decodeBase64(binaryData,
+                                               binaryLength,
+                                               precision / 8,
+                                               false,
+                                               decompress,
+                                               timeVector);
+            }
+            if (isIntensityArray) {
+                decoded = base64::decodeBase64(binaryData,
+                                               binaryLength,
+                                               precision / 8,
+                                               false,
+                                               decompress,
+                                               intsVector);
             }
-            if (attr.count("intensity array")) {
-                intsVector = binaryData;
+            if (!decoded) {
+                throw MavenException(ErrorMsg::ParsemzMl,
+                                     "could not decode chromatogram "
+                                         + chromatogramId);
             }
         }
 
@@ -473,13 +870,19 @@ int mzSample::getSampleNoChromatogram(const string& chromatogramId)
 
 void mzSample::cleanFilterLine(string &filterline) {
 
-    string filterRegex;
-    regex rx;
-    for (const string& filterId : filterChromatogram) {
-        filterRegex = filterId + "\ *\=\ *[0-9]*\.?[0-9]+";
-        rx = filterRegex;
+    // compiling the expressions costs more than parsing a spectrum, so it
+    // is done once
+    static const vector<regex> filterRegexes = []() {
+        vector<regex> regexes;
+        for (const string& filterId : filterChromatogram) {
+            string filterRegex = filterId + "\ *\=\ *[0-9]*\.?[0-9]+";
+            regexes.push_back(regex(filterRegex));
+        }
+        return regexes;
+    }();
+
+    for (const regex& rx : filterRegexes)
         filterline = std::regex_replace(filterline, rx, "");
-	}
 }
 
 void mzSample::parseMzMLSpectrumList(const xml_node& spectrumList)
@@ -489,146 +892,262 @@ void mzSample::parseMzMLSpectrumList(const xml_node& spectrumList)
 
     for (xml_node spectrum = spectrumList.child("spectrum"); spectrum;
          spectrum = spectrum.next_sibling("spectrum")) {
-        string spectrumId = spectrum.attribute("id").value();
+        Scan* scan = parseMzMLSpectrum(spectrum, scannum);
+        if (scan) {
+            addScan(scan);
+            scannum++;
+        }
+    }
+}
 
-        if (spectrum.empty())
-            continue;
-        map<string, string> cvParams = mzML_cvParams(spectrum);
+Scan* mzSample::parseMzMLSpectrum(const xml_node& spectrum, int scannum)
+{
+    vector<mzValue> mzVector;
+    vector<float> intsVector;
+    if (!parseMzMLBinaryData(spectrum, mzVector, intsVector))
+        return NULL;
 
-        int mslevel = 1;
-        int scanpolarity = 0;
-        float rt = 0;
-        vector<float> mzVector;
-        vector<float> intsVector;
+    Scan* scan = parseMzMLSpectrumHeader(spectrum, scannum);
+    scan->intensity.swap(intsVector);
+    scan->mz.swap(mzVector);
+    return scan;
+}
 
-        if (cvParams.count("ms level")) {
-            string msLevelStr = cvParams["ms level"];
-            mslevel = (int)string2float(msLevelStr);
-        }
+Scan* mzSample::parseMzMLSpectrumHeader(const xml_node& spectrum,
+                                        int scannum)
+{
+    string spectrumId = spectrum.attribute("id").value();
 
-        if (cvParams.count("positive scan"))
-            scanpolarity = 1;
-        else if (cvParams.count("negative scan"))
-            scanpolarity = -1;
-        else
-            scanpolarity = 0;
-
-        xml_node scanNode = spectrum.first_element_by_path("scanList/scan");
-        map<string, string> scanAttr = mzML_cvParams(scanNode);
-        if (scanAttr.count("scan start time minute")) {
-            string rtStr = scanAttr["scan start time minute"];
-            rt = string2float(rtStr);
-        } else if (scanAttr.count("scan start time second")) {
-            string rtStr = scanAttr["scan start time second"];
-            rt = string2float(rtStr) / 60.0f;
-        }
-
-        if (scanAttr.count("filter string")) {
-            spectrumId = scanAttr["filter string"];
-        }
-        cleanFilterLine(spectrumId);
-
-        map<string, string> isolationWindow =
-            mzML_cvParams(spectrum.first_element_by_path(
-                "precursorList/precursor/isolationWindow"));
-        string precursorMzStr = isolationWindow["isolation window target m/z"];
-        float precursorMz = 0;
-        if (string2float(precursorMzStr) > 0)
-            precursorMz = string2float(precursorMzStr);
-
-        string precursorIsolationStrLower =
-            isolationWindow["isolation window lower offset"];
-        string precursorIsolationStrUpper =
-            isolationWindow["isolation window upper offset"];
-
-        float precursorIsolationWindow = 0.0f;
-        if (string2float(precursorIsolationStrLower) > 0.0f)
-            precursorIsolationWindow +=
-                string2float(precursorIsolationStrLower);
-        if (string2float(precursorIsolationStrUpper) > 0.0f)
-            precursorIsolationWindow +=
-                string2float(precursorIsolationStrUpper);
-        if (precursorIsolationWindow <= 0.0f)
-            precursorIsolationWindow = 1.0f;
+    if (spectrum.empty())
+        return NULL;
 
-        string productMzStr =
-            spectrum.first_element_by_path("product/isolationWindow/cvParam")
-                .attribute("value")
-                .value();
-        float productMz = 0;
-        if (string2float(productMzStr) > 0)
-            productMz = string2float(productMzStr);
+    int mslevel = 1;
+    int scanpolarity = 0;
+    float rt = 0;
 
-        xml_node binaryDataArrayList = spectrum.child("binaryDataArrayList");
-        if (!binaryDataArrayList or binaryDataArrayList.empty())
-            continue;
+    bool positiveScan = false;
+    bool negativeScan = false;
+    for (xml_node cv = spectrum.child("cvParam"); cv;
+         cv = cv.next_sibling("cvParam")) {
+        switch (mzMLTerm(cv)) {
+        case MzMLTerm::MsLevel:
+            mslevel = (int)string2float(cv.attribute("value").value());
+            break;
+        case MzMLTerm::PositiveScan:
+            positiveScan = true;
+            break;
+        case MzMLTerm::NegativeScan:
+            negativeScan = true;
+            break;
+        default:
+            break;
+        }
+    }
 
-        for (xml_node binaryDataArray =
-                 binaryDataArrayList.child("binaryDataArray");
-             binaryDataArray;
-             binaryDataArray =
-                 binaryDataArray.next_sibling("binaryDataArray")) {
-            if (!binaryDataArray or binaryDataArray.empty())
-                continue;
+    if (positiveScan)
+        scanpolarity = 1;
+    else if (negativeScan)
+        scanpolarity = -1;
+    else
+        scanpolarity = 0;
 
-            map<string, string> attr = mzML_cvParams(binaryDataArray);
+    xml_node scanNode = spectrum.first_element_by_path("scanList/scan");
+    for (xml_node cv = scanNode.child("cvParam"); cv;
+         cv = cv.next_sibling("cvParam")) {
+        switch (mzMLTerm(cv)) {
+        case MzMLTerm::ScanStartTime: {
+            const char* unit = cv.attribute("unitName").value();
+            if (strcmp(unit, "minute") == 0)
+                rt = string2float(cv.attribute("value").value());
+            else if (strcmp(unit, "second") == 0)
+                rt = string2float(cv.attribute("value").value()) / 60.0f;
+            break;
+        }
+        case MzMLTerm::FilterString:
+            spectrumId = cv.attribute("value").value();
+            break;
+        default:
+            break;
+        }
+    }
+    cleanFilterLine(spectrumId);
 
-            int precision = 64;
-            if (attr.count("32-bit float"))
-                precision = 32;
+    float precursorMz = 0;
+    float precursorIsolationLower = 0.0f;
+    float precursorIsolationUpper = 0.0f;
+    xml_node isolationWindow = spectrum.first_element_by_path(
+        "precursorList/precursor/isolationWindow");
+    for (xml_node cv = isolationWindow.child("cvParam"); cv;
+         cv = cv.next_sibling("cvParam")) {
+        switch (mzMLTerm(cv)) {
+        case MzMLTerm::IsolationWindowTargetMz:
+            precursorMz = string2float(cv.attribute("value").value());
+            break;
+        case MzMLTerm::IsolationWindowLowerOffset:
+            precursorIsolationLower =
+                string2float(cv.attribute("value").value());
+            break;
+        case MzMLTerm::IsolationWindowUpperOffset:
+            precursorIsolationUpper =
+                string2float(cv.attribute("value").value());
+            break;
+        default:
+            break;
+        }
+    }
+    if (precursorMz < 0)
+        precursorMz = 0;
+
+    float precursorIsolationWindow = 0.0f;
+    if (precursorIsolationLower > 0.0f)
+        precursorIsolationWindow += precursorIsolationLower;
+    if (precursorIsolationUpper > 0.0f)
+        precursorIsolationWindow += precursorIsolationUpper;
+    if (precursorIsolationWindow <= 0.0f)
+        precursorIsolationWindow = 1.0f;
+
+    string productMzStr =
+        spectrum.first_element_by_path("product/isolationWindow/cvParam")
+            .attribute("value")
+            .value();
+    float productMz = 0;
+    if (string2float(productMzStr) > 0)
+        productMz = string2float(productMzStr);
+
+    Scan* scan =
+        new Scan(this, scannum, mslevel, rt, precursorMz, scanpolarity);
+    scan->isolationWindow = precursorIsolationWindow;
+    scan->productMz = productMz;
+    scan->filterLine = spectrumId;
+    return scan;
+}
 
-            bool decompress = false;
-            if(attr.count("zlib compression"))
-                decompress=true;
+bool mzSample::parseMzMLBinaryData(const xml_node& spectrum,
+                                   vector<mzValue>& mzVector,
+                                   vector<float>& intsVector)
+{
+    xml_node binaryDataArrayList = spectrum.child("binaryDataArrayList");
+    if (!binaryDataArrayList or binaryDataArrayList.empty())
+        return false;
+
+    for (xml_node binaryDataArray =
+             binaryDataArrayList.child("binaryDataArray");
+         binaryDataArray;
+         binaryDataArray =
+             binaryDataArray.next_sibling("binaryDataArray")) {
+        if (!binaryDataArray or binaryDataArray.empty())
+            continue;
 
-            string binaryDataStr =
-                binaryDataArray.child("binary").child_value();
-            if (!binaryDataStr.empty()) {
-                vector<float> binaryData = base64::decodeBase64(binaryDataStr,
-                                                                 precision / 8,
-                                                                 false,
-                                                                 decompress);
-                if (attr.count("m/z array")) {
-                    mzVector = binaryData;
-                }
-                if (attr.count("intensity array")) {
-                    intsVector = binaryData;
-                }
+        int precision = 64;
+        bool decompress = false;
+        bool isMzArray = false;
+        bool isIntensityArray = false;
+        for (xml_node cv = binaryDataArray.child("cvParam"); cv;
+             cv = cv.next_sibling("cvParam")) {
+            switch (mzMLTerm(cv)) {
+            case MzMLTerm::Float32:
+                precision = 32;
+                break;
+            case MzMLTerm::ZlibCompression:
+                decompress = true;
+                break;
+            case MzMLTerm::MzArray:
+                isMzArray = true;
+                break;
+            case MzMLTerm::IntensityArray:
+                isIntensityArray = true;
+                break;
+            default:
+                break;
             }
         }
 
-        Scan* scan =
-            new Scan(this, scannum++, mslevel, rt, precursorMz, scanpolarity);
-        scan->isolationWindow = precursorIsolationWindow;
-        scan->productMz = productMz;
-        scan->filterLine = spectrumId;
-        scan->intensity = intsVector;
-        scan->mz = mzVector;
-        addScan(scan);
+        // decode straight into the destination array
+        const char* binaryData =
+            binaryDataArray.child("binary").child_value();
+        size_t binaryLength = strlen(binaryData);
+        if (binaryLength > 0) {
+            bool decoded = true;
+            if (isMzArray) {
+                decoded = base64::decodeBase64(binaryData,
+                                               binaryLength,
+                                               precision / 8,
+                                               false,
+                                               decompress,
+                                               mzVector);
+            }
+            if (isIntensityArray) {
+                decoded = base64::decodeBase64(binaryData,
+                                               binaryLength,
+                                               precision / 8,
+                                               false,
+                                               decompress,
+                                               intsVector);
+            }
+            if (!decoded) {
+                throw MavenException(ErrorMsg::ParsemzMl,
+                                     string("could not decode spectrum ")
+                                         + spectrum.attribute("id").value());
+            }
+        }
     }
+    return true;
 }
 
-map<string, string> mzSample::mzML_cvParams(xml_node node)
+mzSample::MzMLTerm mzSample::mzMLTerm(const xml_node& cvParam)
 {
-    map<string, string> attr;
-    if (!node || node.empty())
-        return attr;
-    for (xml_node cv = node.child("cvParam"); cv;
-         cv = cv.next_sibling("cvParam")) {
-        string name = cv.attribute("name").value();
-        string value = cv.attribute("value").value();
-        if (name == "scan start time") {
-            string unit = cv.attribute("unitName").value();
-            name += " " + unit;
+    struct TermName {
+        MzMLTerm term;
+        const char* name;
+    };
+    static const TermName terms[] = {
+        {MzMLTerm::ScanStartTime, "scan start time"},
+        {MzMLTerm::CollisionEnergy, "collision energy"},
+        {MzMLTerm::NegativeScan, "negative scan"},
+        {MzMLTerm::PositiveScan, "positive scan"},
+        {MzMLTerm::TotalIonCurrent, "total ion current"},
+        {MzMLTerm::BasePeakMz, "base peak m/z"},
+        {MzMLTerm::BasePeakIntensity, "base peak intensity"},
+        {MzMLTerm::MsLevel, "ms level"},
+        {MzMLTerm::FilterString, "filter string"},
+        {MzMLTerm::MzArray, "m/z array"},
+        {MzMLTerm::IntensityArray, "intensity array"},
+        {MzMLTerm::Float32, "32-bit float"},
+        {MzMLTerm::Float64, "64-bit float"},
+        {MzMLTerm::HighestObservedMz, "highest observed m/z"},
+        {MzMLTerm::LowestObservedMz, "lowest observed m/z"},
+        {MzMLTerm::ZlibCompression, "zlib compression"},
+        {MzMLTerm::TimeArray, "time array"},
+        {MzMLTerm::IsolationWindowTargetMz, "isolation window target m/z"},
+        {MzMLTerm::IsolationWindowLowerOffset, "isolation window lower offset"},
+        {MzMLTerm::IsolationWindowUpperOffset, "isolation window upper offset"}};
+
+    // PSI-MS accessions are "MS:" followed by the number of the term
+    const char* accession = cvParam.attribute("accession").value();
+    if (strncmp(accession, "MS:", 3) == 0) {
+        int number = atoi(accession + 3);
+        for (const auto& term : terms) {
+            if (static_cast<int>(term.term) == number)
+                return term.term;
         }
-        attr[name] = value;
-        // cerr << name << "->" << value << endl;
+        return MzMLTerm::Unknown;
     }
-    return (attr);
+
+    // fall back to names for files that leave out accessions
+    const char* name = cvParam.attribute("name").value();
+    for (const auto& term : terms) {
+        if (strcmp(term.name, name) == 0)
+            return term.term;
+    }
+    return MzMLTerm::Unknown;
 }
 
 void mzSample::parseMzData(const char* filename)
 {
+    // read spectra one at a time, unless the file cannot be streamed
+    if (streamMzData(filename))
+        return;
+
     xml_document doc;
 
     const unsigned int parse_options = parse_minimal;
@@ -647,74 +1166,108 @@ void mzSample::parseMzData(const char* filename)
     for (xml_node spectrum = spectrumstore.child("spectrum"); spectrum;
          spectrum = spectrum.next_sibling("spectrum")) {
         scannum++;
-        float rt = 0;
-        float precursorMz = 0;
-        char scanpolarity = 0;  // default case
-
-        xml_node spectrumInstrument = spectrum.first_element_by_path(
-            "spectrumDesc/spectrumSettings/spectrumInstrument");
-        int mslevel = spectrumInstrument.attribute("msLevel").as_int();
-        // cerr << mslevel << " " << spectrum.attribute("msLevel").value() <<
-        // endl;
-
-        for (xml_node cvParam = spectrumInstrument.child("cvParam"); cvParam;
-             cvParam = cvParam.next_sibling("cvParam")) {
-            //	cout << "cvParam=" << cvParam.attribute("name").value() << endl;
-            //
-            if (strncasecmp(
-                    cvParam.attribute("name").value(), "TimeInMinutes", 10)
-                == 0) {
-                rt = cvParam.attribute("value").as_float();
-                // cout << "rt=" << rt << endl;
-            }
+        parseMzDataSpectrum(spectrum, scannum);
+    }
+}
 
-            if (strncasecmp(
-                    cvParam.attribute("name").value(), "time in seconds", 10)
-                == 0) {
-                rt = cvParam.attribute("value").as_float() / 60;
-                // cout << "rt=" << rt << endl;
-            }
+void mzSample::parseMzDataSpectrum(const xml_node& spectrum, int scannum)
+{
+    float rt = 0;
+    float precursorMz = 0;
+    char scanpolarity = 0;  // default case
+
+    xml_node spectrumInstrument = spectrum.first_element_by_path(
+        "spectrumDesc/spectrumSettings/spectrumInstrument");
+    int mslevel = spectrumInstrument.attribute("msLevel").as_int();
+    // cerr << mslevel << " " << spectrum.attribute("msLevel").value() <<
+    // endl;
+
+    for (xml_node cvParam = spectrumInstrument.child("cvParam"); cvParam;
+         cvParam = cvParam.next_sibling("cvParam")) {
+        //	cout << "cvParam=" << cvParam.attribute("name").value() << endl;
+        //
+        if (strncasecmp(
+                cvParam.attribute("name").value(), "TimeInMinutes", 10)
+            == 0) {
+            rt = cvParam.attribute("value").as_float();
+            // cout << "rt=" << rt << endl;
+        }
 
-            if (strncasecmp(cvParam.attribute("name").value(), "polarity", 5)
-                == 0) {
-                if (cvParam.attribute("value").value()[0] == 'p'
-                    || cvParam.attribute("value").value()[0] == 'P') {
-                    scanpolarity = +1;
-                } else {
-                    scanpolarity = -1;
-                }
-            }
+        if (strncasecmp(
+                cvParam.attribute("name").value(), "time in seconds", 10)
+            == 0) {
+            rt = cvParam.attribute("value").as_float() / 60;
+            // cout << "rt=" << rt << endl;
         }
 
-        // cout <<
-        // spectrum.first_element_by_path("spectrumDesc/spectrumSettings/spectrumInstrument").child_value()
-        // << endl
-        if (mslevel <= 0)
-            mslevel = 1;
-        Scan* scan =
-            new Scan(this, scannum, mslevel, rt, precursorMz, scanpolarity);
-        addScan(scan);
+        if (strncasecmp(cvParam.attribute("name").value(), "polarity", 5)
+            == 0) {
+            if (cvParam.attribute("value").value()[0] == 'p'
+                || cvParam.attribute("value").value()[0] == 'P') {
+                scanpolarity = +1;
+            } else {
+                scanpolarity = -1;
+            }
+        }
+    }
 
-        int precision1 = spectrum.child("intenArrayBinary")
-                             .child("data")
-                             .attribute("precision")
-                             .as_int();
-        string b64intensity =
-            spectrum.child("intenArrayBinary").child("data").child_value();
-        scan->intensity =
-            base64::decodeBase64(b64intensity, precision1 / 8, false, false);
+    // cout <<
+    // spectrum.first_element_by_path("spectrumDesc/spectrumSettings/spectrumInstrument").child_value()
+    // << endl
+    if (mslevel <= 0)
+        mslevel = 1;
+    Scan* scan =
+        new Scan(this, scannum, mslevel, rt, precursorMz, scanpolarity);
+
+    int precision1 = spectrum.child("intenArrayBinary")
+                         .child("data")
+                         .attribute("precision")
+                         .as_int();
+    string b64intensity =
+        spectrum.child("intenArrayBinary").child("data").child_value();
+    scan->intensity =
+        base64::decodeBase64(b64intensity, precision1 / 8, false, false);
+
+    // cout << "mz" << endl;
+    int precision2 = spectrum.child("mzArrayBinary")
+                         .child("data")
+                         .attribute("precision")
+                         .as_int();
+    string b64mz =
+        spectrum.child("mzArrayBinary").child("data").child_value();
+    base64::decodeBase64(b64mz.data(),
+                         b64mz.size(),
+                         precision2 / 8,
+                         false,
+                         false,
+                         scan->mz.values());
+
+    // add the scan only once its data is in place, since it may be filtered
+    addScan(scan);
+}
 
-        // cout << "mz" << endl;
-        int precision2 = spectrum.child("mzArrayBinary")
-                             .child("data")
-                             .attribute("precision")
-                             .as_int();
-        string b64mz =
-            spectrum.child("mzArrayBinary").child("data").child_value();
-        scan->mz = base64::decodeBase64(b64mz, precision2 / 8, false, false);
+bool mzSample::streamMzData(const char* filename)
+{
+    XMLElementReader reader(filename);
+    if (!reader.isOpen())
+        return false;
 
-        // cout << "spectrum " << spectrum.attribute("title").value() << endl;
+    const vector<string> tags = {"spectrum"};
+    int scannum = 0;
+    string name, element;
+    while (reader.findStartTag(tags, name)) {
+        xml_document doc;
+        if (!reader.readElement(element)
+            || !doc.load_buffer_inplace(&element[0],
+                                        element.size(),
+                                        parse_minimal)) {
+            clearScans();
+            return false;
+        }
+        scannum++;
+        parseMzDataSpectrum(doc.first_child(), scannum);
     }
+    return scannum > 0;
 }
 
 xml_node mzSample::getmzXMLSpectrumData(xml_document& doc, const char* filename)
@@ -799,8 +1352,119 @@ void mzSample::parseMzXMLData(const xml_node& spectrumstore)
     }
 }
 
+bool mzSample::streamMzXML(const char* filename)
+{
+    XMLElementReader reader(filename);
+    if (!reader.isOpen())
+        return false;
+
+    const vector<string> tags = {"msInstrument", "scan"};
+    int numScans = 0;
+    string name, element;
+    while (reader.findStartTag(tags, name)) {
+        xml_document doc;
+        if (!reader.readElement(element)
+            || !doc.load_buffer_inplace(&element[0],
+                                        element.size(),
+                                        parse_minimal)) {
+            clearScans();
+            return false;
+        }
+
+        // the document acts as the parent of a single element
+        if (name == "msInstrument") {
+            setInstrumentSettigs(doc, doc);
+        } else {
+            _streamOffset = reader.tagOffset();
+            parseMzXMLData(doc);
+            _streamOffset = -1;
+            numScans++;
+        }
+    }
+    return numScans > 0;
+}
+
+bool mzSample::loadMzXMLHeaders(const char* filename)
+{
+    vector<pair<long long, long long> > ranges;
+    if (!readScanIndex(filename, "scan", ranges))
+        return false;
+
+    // instrument settings are written ahead of the scans
+    XMLElementReader reader(filename, 1 << 16);
+    const vector<string> tags = {"msInstrument", "scan"};
+    string name, element;
+    if (reader.findStartTag(tags, name) && name == "msInstrument") {
+        xml_document doc;
+        if (reader.readElement(element)
+            && doc.load_buffer_inplace(&element[0],
+                                       element.size(),
+                                       parse_minimal)) {
+            setInstrumentSettigs(doc, doc);
+        }
+    }
+
+    // MS1 scans are read back while loading, to recalculate the precursor
+    // m/z of MS2 scans
+    _lazyScans = true;
+
+    ifstream file(filename, ios::in | ios::binary);
+    int scannum = 0;
+    string header;
+    bool loaded = true;
+    for (const auto& range : ranges) {
+        xml_document doc;
+        if (!readScanHeader(file, range, "scan", "peaks", header)
+            || (!header.empty()
+                && !doc.load_buffer_inplace(&header[0],
+                                            header.size(),
+                                            parse_minimal))) {
+            loaded = false;
+            break;
+        }
+
+        // scans without peaks are skipped, as when parsing them
+        xml_node scan = doc.first_child();
+        unsigned int nobs = scan.attribute("peaksCount").as_uint();
+        if (header.empty() || nobs == 0)
+            continue;
+
+        scannum++;
+        Scan* _scan = parseMzXMLScanHeader(scan, scannum);
+        if (!setHeaderSummary(_scan,
+                              nobs,
+                              scan.attribute("lowMz").value(),
+                              scan.attribute("highMz").value(),
+                              scan.attribute("basePeakMz").value(),
+                              scan.attribute("basePeakIntensity").value(),
+                              scan.attribute("totIonCurrent").value())) {
+            delete _scan;
+            loaded = false;
+            break;
+        }
+        _scan->fileSeekStart = range.first;
+        _scan->fileSeekEnd = range.second;
+        addScan(_scan);
+    }
+
+    if (!loaded) {
+        clearScans();
+        _lazyScans = false;
+    }
+    return loaded;
+}
+
 void mzSample::parseMzXML(const char* filename)
 {
+    // with lazy loading, read just the headers of the scans of indexed
+    // files and leave their peaks in the file
+    if (canLoadScanHeaders() && loadMzXMLHeaders(filename))
+        return;
+
+    // read scans one at a time, unless the file cannot be streamed
+    if (streamMzXML(filename))
+        return;
+
     xml_document doc;
 
     xml_node spectrumstore = getmzXMLSpectrumData(doc, filename);
@@ -867,75 +1531,55 @@ int mzSample::getPolarityFromfilterLine(string filterLine)
     return scanpolarity;
 }
 
-vector<float> mzSample::parsePeaksFromMzXML(const xml_node& scan)
+size_t mzSample::parsePeaksFromMzXML(const xml_node& scan,
+                                    vector<mzValue>& mzs,
+                                    vector<float>& intensities)
 {
     xml_node peaks = scan.child("peaks");
-    vector<float> mzint;
-
-    if (!peaks.empty()) {
-        string b64String(peaks.child_value());
-
-        // no m/z intensity values
-        if (b64String.empty())
-            return mzint;
-
-        // if the data is been compressed in zlib format this part will
-        // take care.
-        bool decompress = false;
-        if (strncasecmp(peaks.attribute("compressionType").value(), "zlib", 4) == 0) {
-            decompress = true;
-        }
-
-        bool networkorder = false;  // naman The scope of the variable
-                                    // 'networkorder' can be reduced.
-
-        if (peaks.attribute("byteOrder").empty()
-            || strncasecmp(peaks.attribute("byteOrder").value(), "network", 5)
-                   == 0) {
-            networkorder = true;
-        }
-
-        int precision =
-            32;  // naman The scope of the variable 'precision' can be reduced.
-
-        if (!peaks.attribute("precision").empty()) {
-            precision = peaks.attribute("precision").as_int();
-        }
-
-        // cerr << "new scan=" << scannum << " msL=" << msLevel << " rt=" << rt
-        // << " precMz=" << precursorMz << " polar=" << scanpolarity
-        //    << " prec=" << precision << endl;
-
-        mzint = base64::decodeBase64(
-            b64String, precision / 8, networkorder, decompress);
-
-        return mzint;
-    }
-
-    return mzint;
-}
-
-void mzSample::populateMzAndIntensity(const vector<float>& mzint, Scan* _scan)
-{
-    int j = 0, count = 0, size = mzint.size() / 2;
-
-    // sizing the mz variable and the intensity variable
-    _scan->mz.resize(size);
-    _scan->intensity.resize(size);
+    if (peaks.empty())
+        return 0;
 
-    for (int i = 0; i < size; i++) {
-        float mzValue = mzint[j++];
-        float intensityValue = mzint[j++];
-        // cerr << mzValue << " " << intensityValue << endl;
-        if (mzValue > 0 && intensityValue > 0) {
-            _scan->mz[count] = mzValue;
-            _scan->intensity[count] = intensityValue;
-            count++;
-        }
-    }
+    // no m/z intensity values
+    const char* b64String = peaks.child_value();
+    size_t b64Length = strlen(b64String);
+    if (b64Length == 0)
+        return 0;
 
-    _scan->mz.resize(count);
-    _scan->intensity.resize(count);
+    // if the data is been compressed in zlib format this part will
+    // take care.
+    bool decompress = false;
+    if (strncasecmp(peaks.attribute("compressionType").value(), "zlib", 4) == 0) {
+        decompress = true;
+    }
+
+    bool networkorder = false;
+    if (peaks.attribute("byteOrder").empty()
+        || strncasecmp(peaks.attribute("byteOrder").value(), "network", 5)
+               == 0) {
+        networkorder = true;
+    }
+
+    int precision = 32;
+    if (!peaks.attribute("precision").empty()) {
+        precision = peaks.attribute("precision").as_int();
+    }
+
+    // split interleaved m/z-intensity pairs while decoding, dropping
+    // pairs without a positive m/z and intensity
+    size_t count = 0;
+    if (!base64::decodeBase64Pairs(b64String,
+                                   b64Length,
+                                   precision / 8,
+                                   networkorder,
+                                   decompress,
+                                   mzs,
+                                   intensities,
+                                   count)) {
+        throw MavenException(ErrorMsg::ParsemzXml,
+                             string("could not decode peaks of scan ")
+                                 + scan.attribute("num").value());
+    }
+    return count;
 }
 
 void mzSample::populateFilterline(const string& filterLine, Scan* _scan)
@@ -952,11 +1596,37 @@ void mzSample::populateFilterline(const string& filterLine, Scan* _scan)
 }
 
 void mzSample::parseMzXMLScan(const xml_node& scan, const int& scannum)
+{
+    vector<mzValue> mzs;
+    vector<float> intensities;
+
+    // no m/z intensity values
+    if (parsePeaksFromMzXML(scan, mzs, intensities) == 0) {
+        return;
+    }
+
+    Scan* _scan = parseMzXMLScanHeader(scan, scannum);
+    _scan->mz.swap(mzs);
+    _scan->intensity.swap(intensities);
+
+    // remember where the peaks are in the file, when streaming it
+    if (_streamOffset >= 0) {
+        xml_node peaks = scan.child("peaks");
+        _scan->fileSeekStart = _streamOffset + scan.offset_debug() - 1;
+        _scan->fileSeekEnd = _streamOffset
+                             + peaks.first_child().offset_debug()
+                             + strlen(peaks.child_value())
+                             + strlen("</peaks>");
+    }
+
+    addScan(_scan);
+}
+
+Scan* mzSample::parseMzXMLScanHeader(const xml_node& scan, int scannum)
 {
     float rt = 0.0, precursorMz = 0.0f, productMz = 0, collisionEnergy = 0;
     int scanpolarity = 0, msLevel = 1;
     string filterLine, scanType;
-    vector<float> mzint;
 
     for (xml_attribute attr = scan.first_attribute(); attr;
          attr = attr.next_attribute()) {
@@ -998,12 +1668,6 @@ void mzSample::parseMzXMLScan(const xml_node& scan, const int& scannum)
         scanpolarity = getPolarityFromfilterLine(filterLine);
     }
 
-    // no m/z intensity values
-    mzint = parsePeaksFromMzXML(scan);
-    if (mzint.empty()) {
-        return;
-    }
-
     Scan* _scan =
         new Scan(this, scannum, msLevel, rt, precursorMz, scanpolarity);
 
@@ -1032,11 +1696,8 @@ void mzSample::parseMzXMLScan(const xml_node& scan, const int& scannum)
 
     _scan->collisionEnergy = collisionEnergy;
 
-    populateMzAndIntensity(mzint, _scan);
-
     populateFilterline(filterLine, _scan);
-
-    addScan(_scan);
+    return _scan;
 }
 
 void mzSample::summary()
@@ -1066,6 +1727,21 @@ void mzSample::calculateMzRtRange()
     unsigned int numOfScans = scans.size();
     for (unsigned int j = 0; j < numOfScans; j++) {
         Scan* currentScan = scans[j];
+        if (!currentScan->hasSummary())
+            currentScan->updateSummary();
+
+        // scans loaded from their headers only have their summary
+        if (currentScan->nobs() == 0 && currentScan->maxMz() > 0) {
+            totalIntensity += currentScan->totalIntensity();
+            if (currentScan->minMz() < minMz && currentScan->minMz() > 0)
+                minMz = currentScan->minMz();
+            if (currentScan->maxMz() > maxMz && currentScan->maxMz() < 1e9)
+                maxMz = currentScan->maxMz();
+            if (currentScan->maxIntensity() > maxIntensity)
+                maxIntensity = currentScan->maxIntensity();
+            continue;
+        }
+
         unsigned int mzSize = currentScan->mz.size();
         for (unsigned int i = 0; i < mzSize; i++) {
             float intensity = currentScan->intensity[i];
@@ -1135,6 +1811,219 @@ void mzSample::enumerateSRMScans()
     }
 }
 
+void mzSample::indexScans()
+{
+    _scansByMsLevel.clear();
+    for (unsigned int i = 0; i < scans.size(); i++) {
+        _scansByMsLevel[scans[i]->mslevel].push_back(scans[i]);
+    }
+}
+
+const vector<Scan*>& mzSample::scansAtMsLevel(int mslevel) const
+{
+    static const vector<Scan*> noScans;
+    auto it = _scansByMsLevel.find(mslevel);
+    if (it == _scansByMsLevel.end())
+        return noScans;
+    return it->second;
+}
+
+void mzSample::buildSpectrumStore()
+{
+    if (_lazyScans || hasSpectrumStore())
+        return;
+
+    _spectrumStore.build(scans);
+}
+
+void mzSample::releaseSpectrumStore()
+{
+    if (!hasSpectrumStore())
+        return;
+
+    // scans get their own copy of the rows they view
+    for (auto scan : scans) {
+        scan->mz.values();
+        scan->intensity.values();
+    }
+    _spectrumStore.clear();
+}
+
+void mzSample::buildScanMzIndex()
+{
+    _scanMzIndex.build(scans);
+}
+
+void mzSample::releaseScanMzIndex()
+{
+    _scanMzIndex.clear();
+}
+
+bool mzSample::scanMayContainMz(const Scan* scan,
+                                mzValue mzmin,
+                                mzValue mzmax) const
+{
+    if (!scan->overlapsMzRange(mzmin, mzmax))
+        return false;
+    return _scanMzIndex.mayContain(scan->scannum, mzmin, mzmax);
+}
+
+void mzSample::retentionTimesUpdated()
+{
+    if (hasSpectrumStore())
+        _spectrumStore.updateRetentionTimes(scans);
+
+    lock_guard<mutex> lock(_ionChromatogramMutex);
+    _ionChromatograms.clear();
+}
+
+void mzSample::clearScans()
+{
+    {
+        lock_guard<mutex> lock(_scanCacheMutex);
+        _cachedScans.clear();
+        _cachedScanPos.clear();
+        _cachedScanBytes = 0;
+    }
+
+    delete_all(scans);
+    scans.clear();
+    _scansByMsLevel.clear();
+    _scanMzIndex.clear();
+    _spectrumStore.clear();
+    _numMS1Scans = 0;
+    _numMS2Scans = 0;
+
+    {
+        lock_guard<mutex> lock(_fragmentationIndexMutex);
+        _fragmentationIndex.clear();
+    }
+
+    lock_guard<mutex> lock(_ionChromatogramMutex);
+    _ionChromatograms.clear();
+}
+
+void mzSample::releaseScanData()
+{
+    lock_guard<mutex> lock(_scanCacheMutex);
+    _cachedScans.clear();
+    _cachedScanPos.clear();
+    _cachedScanBytes = 0;
+
+    for (auto scan : scans) {
+        if (scan->fileSeekStart < 0)
+            continue;
+        scan->mz.clear();
+        scan->intensity.clear();
+        _lazyScans = true;
+    }
+}
+
+static size_t peakBytes(const Scan* scan)
+{
+    return scan->nobs() * (sizeof(mzValue) + sizeof(float));
+}
+
+shared_ptr<const Scan> mzSample::loadScanData(Scan* scan)
+{
+    if (scan == NULL)
+        return nullptr;
+
+    // only scans of this sample can have been released, anything else
+    // (e.g., a copy handed out below) already holds its peaks
+    bool released = _lazyScans && scan->fileSeekStart >= 0
+                    && scan->scannum >= 0
+                    && static_cast<size_t>(scan->scannum) < scans.size()
+                    && scans[scan->scannum] == scan;
+    if (!released)
+        return shared_ptr<const Scan>(shared_ptr<const Scan>(), scan);
+
+    lock_guard<mutex> lock(_scanCacheMutex);
+    auto pos = _cachedScanPos.find(scan);
+    if (pos != _cachedScanPos.end()) {
+        _cachedScans.splice(_cachedScans.begin(), _cachedScans, pos->second);
+        return pos->second->second;
+    }
+
+    shared_ptr<Scan> scanData(new Scan(this,
+                                       scan->scannum,
+                                       scan->mslevel,
+                                       scan->rt,
+                                       scan->precursorMz,
+                                       scan->getPolarity()));
+    scanData->deepcopy(scan);
+    if (!readScanData(scan, scanData.get())) {
+        cerr << "Error: could not read scan " << scan->scannum << " from "
+             << fileName << endl;
+        return shared_ptr<const Scan>(shared_ptr<const Scan>(), scan);
+    }
+
+    _cachedScans.push_front(make_pair(scan, scanData));
+    _cachedScanPos[scan] = _cachedScans.begin();
+    _cachedScanBytes += peakBytes(scanData.get());
+
+    // forget least recently used copies, always keeping the one just read;
+    // copies still held by callers are freed once they are done with them
+    size_t maxBytes = static_cast<size_t>(scanCacheSize) * 1024 * 1024;
+    while (_cachedScanBytes > maxBytes && _cachedScans.size() > 1) {
+        _cachedScanBytes -= peakBytes(_cachedScans.back().second.get());
+        _cachedScanPos.erase(_cachedScans.back().first);
+        _cachedScans.pop_back();
+    }
+    return scanData;
+}
+
+bool mzSample::readScanData(const Scan* scan, Scan* scanData)
+{
+    if (!_scanDataFile.is_open())
+        _scanDataFile.open(fileName.c_str(), ios::in | ios::binary);
+
+    string data(scan->fileSeekEnd - scan->fileSeekStart, '\0');
+    _scanDataFile.clear();
+    _scanDataFile.seekg(scan->fileSeekStart);
+    if (!_scanDataFile.read(&data[0], data.size()))
+        return false;
+
+    // ranges taken from the index of a file run up to the next element
+    // listed in it, so only the scan itself is parsed; peaks that cannot be
+    // decoded fail the read rather than throw, as scans are read from
+    // parallel loops
+    xml_document doc;
+    try {
+        if (data.compare(0, 9, "<spectrum") == 0) {
+            size_t end = data.find("</spectrum>");
+            if (end == string::npos
+                || !doc.load_buffer_inplace(&data[0],
+                                            end + strlen("</spectrum>"),
+                                            parse_minimal)) {
+                return false;
+            }
+            parseMzMLBinaryData(doc.first_child(),
+                                scanData->mz.values(),
+                                scanData->intensity.values());
+        } else {
+            // skip the header of an mzXML scan, and any scans nested in it
+            size_t peaks = data.find("<peaks");
+            size_t end = data.find("</peaks>", peaks);
+            if (peaks == string::npos || end == string::npos
+                || !doc.load_buffer_inplace(&data[peaks],
+                                            end + strlen("</peaks>") - peaks,
+                                            parse_minimal)) {
+                return false;
+            }
+            parsePeaksFromMzXML(doc,
+                                scanData->mz.values(),
+                                scanData->intensity.values());
+        }
+    } catch (MavenException&) {
+        return false;
+    }
+
+    applyScanFilters(scanData);
+    scanData->updateSummary();
+    return true;
+}
+
 Scan* mzSample::getScan(unsigned int scanNum)
 {
     if (scanNum >= scans.size())
@@ -1184,18 +2073,19 @@ EIC* mzSample::getEIC(float precursorMz,
         // a single mz-intensity observation). This way, we can maintain
         // compatibility with both the formats.
 
+        auto scanData = loadScanData(scan);
         float eicMz = 0;
         float eicIntensity = 0;
 
         switch ((EIC::EicType)eicType) {
         case EIC::MAX: {
-            for (unsigned int k = 0; k < scan->nobs(); k++) {
-                if (productMz != 0.0f && abs(scan->mz[k] - productMz) > amuQ3)
+            for (unsigned int k = 0; k < scanData->nobs(); k++) {
+                if (productMz != 0.0f && abs(scanData->mz[k] - productMz) > amuQ3)
                     continue;
 
-                if (scan->intensity[k] > eicIntensity) {
-                    eicIntensity = scan->intensity[k];
-                    eicMz = scan->mz[k];
+                if (scanData->intensity[k] > eicIntensity) {
+                    eicIntensity = scanData->intensity[k];
+                    eicMz = scanData->mz[k];
 
                     // We set the filterline to be the SRM ID of the first scan
                     // that matches, so that all subsequent observations also
@@ -1214,13 +2104,13 @@ EIC* mzSample::getEIC(float precursorMz,
         case EIC::SUM: {
             double sumMz = 0.0;
             double sumIntensity = 0.0;
-            for (unsigned int k = 0; k < scan->nobs(); k++) {
-                if (productMz != 0.0f && abs(scan->mz[k] - productMz) > amuQ3)
+            for (unsigned int k = 0; k < scanData->nobs(); k++) {
+                if (productMz != 0.0f && abs(scanData->mz[k] - productMz) > amuQ3)
                     continue;
 
-                double intensity = static_cast<double>(scan->intensity[k]);
+                double intensity = static_cast<double>(scanData->intensity[k]);
                 sumIntensity += intensity;
-                sumMz += static_cast<double>(scan->mz[k]) * intensity;
+                sumMz += static_cast<double>(scanData->mz[k]) * intensity;
             }
             if (sumIntensity != 0.0) {
                 eicMz = static_cast<float>(sumMz / sumIntensity);
@@ -1231,13 +2121,13 @@ EIC* mzSample::getEIC(float precursorMz,
         }
 
         default: {
-            for (unsigned int k = 0; k < scan->nobs(); k++) {
-                if (productMz != 0.0f && abs(scan->mz[k] - productMz) > amuQ3)
+            for (unsigned int k = 0; k < scanData->nobs(); k++) {
+                if (productMz != 0.0f && abs(scanData->mz[k] - productMz) > amuQ3)
                     continue;
 
-                if (scan->intensity[k] > eicIntensity) {
-                    eicIntensity = scan->intensity[k];
-                    eicMz = scan->mz[k];
+                if (scanData->intensity[k] > eicIntensity) {
+                    eicIntensity = scanData->intensity[k];
+                    eicMz = scanData->mz[k];
                     filterline = scan->filterLine;
                 }
             }
@@ -1315,7 +2205,7 @@ EIC* mzSample::getEIC(string srm, int eicType)
     if (srmScans.count(srm) > 0) {
         vector<int> srmscans = srmScans[srm];
         for (unsigned int i = 0; i < srmscans.size(); i++) {
-            Scan* scan = scans[srmscans[i]];
+            auto scan = loadScanData(scans[srmscans[i]]);
             float eicMz = 0;
             float eicIntensity = 0;
 
@@ -1399,24 +2289,15 @@ EIC* mzSample::getEIC(string srm, int eicType)
  * MS/MS
  * @return         [description]
  */
-EIC* mzSample::getEIC(float mzmin,
-                      float mzmax,
+EIC* mzSample::getEIC(mzValue mzmin,
+                      mzValue mzmax,
                       float rtmin,
                       float rtmax,
                       int mslevel,
                       int eicType,
                       string filterline)
 {
-    // Adjusting the Retension Time so that it matches with the sample
-    // retension time
-    if (rtmin < this->minRt)
-        rtmin = this->minRt;
-    if (rtmax > this->maxRt && this->maxRt > rtmin)
-        rtmax = this->maxRt;
-    if (mzmin < this->minMz)
-        mzmin = this->minMz;
-    if (mzmax > this->maxMz && this->maxMz > mzmin)
-        mzmax = this->maxMz;
+    _clampToSampleRange(mzmin, mzmax, rtmin, rtmax);
 
     EIC* e = new EIC();
     e->sampleName = sampleName;
@@ -1455,66 +2336,99 @@ EIC* mzSample::getEIC(float mzmin,
     return (e);
 }
 
-EIC* mzSample::getTIC(float rtmin, float rtmax, int mslevel)
+void mzSample::getEICMaximum(mzValue mzmin,
+                             mzValue mzmax,
+                             float rtmin,
+                             float rtmax,
+                             int mslevel,
+                             int eicType,
+                             const string& filterline,
+                             float& maxIntensity,
+                             float& rtAtMax,
+                             mzValue& mzAtMax)
 {
-    // TODO naman unused function
+    _clampToSampleRange(mzmin, mzmax, rtmin, rtmax);
 
-    // ajust EIC retention time window to match sample retentention times
+    maxIntensity = 0.0f;
+    rtAtMax = 0.0f;
+    mzAtMax = 0;
+    if (scans.empty())
+        return;
+
+    EIC::maxIntensityInSlice(this,
+                             mzmin,
+                             mzmax,
+                             rtmin,
+                             rtmax,
+                             mslevel,
+                             eicType,
+                             filterline,
+                             maxIntensity,
+                             rtAtMax,
+                             mzAtMax);
+}
+
+void mzSample::_clampToSampleRange(mzValue& mzmin,
+                                   mzValue& mzmax,
+                                   float& rtmin,
+                                   float& rtmax) const
+{
+    // Adjusting the Retension Time so that it matches with the sample
+    // retension time
     if (rtmin < this->minRt)
         rtmin = this->minRt;
-    if (rtmax > this->maxRt)
+    if (rtmax > this->maxRt && this->maxRt > rtmin)
         rtmax = this->maxRt;
+    if (mzmin < this->minMz)
+        mzmin = this->minMz;
+    if (mzmax > this->maxMz && this->maxMz > mzmin)
+        mzmax = this->maxMz;
+}
 
-    // cerr << "getEIC()" << setprecision(7) << mzmin << " " << mzmax << " " <<
-    // rtmin << " " << rtmax << endl;
-
-    EIC* e = new EIC();
-    e->sampleName = sampleName;
-    e->sample = this;
-    e->mzmin = 0;
-    e->mzmax = 0;
-    e->totalIntensity = 0;
-    e->maxIntensity = 0;
-
-    int scanCount = scans.size();
-    if (scanCount == 0)
-        return e;
-
-    for (int i = 0; i < scanCount; i++) {
-        if (scans[i]->mslevel == mslevel) {
-            Scan* scan = scans[i];
-            float y = scan->totalIntensity();
-            e->mz.push_back(0);
-            e->scannum.push_back(i);
-            e->rt.push_back(scan->rt);
-            e->intensity.push_back(y);
-            e->totalIntensity += y;
-            if (y > e->maxIntensity) {
-                e->maxIntensity = y;
-                e->rtAtMaxIntensity = scan->rt;
-                e->mzAtMaxIntensity = 0;
-            }
-        }
-    }
-    if (e->rt.size() > 0) {
-        e->rtmin = e->rt[0];
-        e->rtmax = e->rt[e->size() - 1];
-    }
-    return (e);
+EIC* mzSample::getTIC(float rtmin, float rtmax, int mslevel)
+{
+    return _getIonChromatogram(rtmin, rtmax, mslevel, false);
 }
 
 // TODO: Sahil Added this function because of merging of eicwidget
 EIC* mzSample::getBIC(float rtmin, float rtmax, int mslevel)
 {
-    // ajust EIC retention time window to match sample retentention times
-    if (rtmin < this->minRt)
-        rtmin = this->minRt;
-    if (rtmax > this->maxRt)
-        rtmax = this->maxRt;
+    return _getIonChromatogram(rtmin, rtmax, mslevel, true);
+}
 
-    // cerr << "getEIC()" << setprecision(7) << mzmin << " " << mzmax << " " <<
-    // rtmin << " " << rtmax << endl;
+void mzSample::_buildIonChromatograms()
+{
+    _ionChromatograms.clear();
+    _ionChromatogramScanCount = scans.size();
+
+    for (auto& level : _scansByMsLevel) {
+        IonChromatogram& chromatogram = _ionChromatograms[level.first];
+        const vector<Scan*>& levelScans = level.second;
+        chromatogram.scannum.reserve(levelScans.size());
+        chromatogram.rt.reserve(levelScans.size());
+        chromatogram.totalIntensity.reserve(levelScans.size());
+        chromatogram.basePeakIntensity.reserve(levelScans.size());
+        chromatogram.basePeakMz.reserve(levelScans.size());
+
+        for (auto scan : levelScans) {
+            // summaries are computed on load and kept by released scans,
+            // so only scans modified or added since are summarized here
+            if (!scan->hasSummary())
+                scan->updateSummary();
+            chromatogram.scannum.push_back(scan->scannum);
+            chromatogram.rt.push_back(scan->rt);
+            chromatogram.totalIntensity.push_back(scan->totalIntensity());
+            chromatogram.basePeakIntensity.push_back(scan->maxIntensity());
+            chromatogram.basePeakMz.push_back(scan->basePeakMz());
+        }
+    }
+}
 
+EIC* mzSample::_getIonChromatogram(float rtmin,
+                                   float rtmax,
+                                   int mslevel,
+                                   bool basePeak)
+{
     EIC* e = new EIC();
     e->sampleName = sampleName;
     e->sample = this;
@@ -1523,37 +2437,57 @@ EIC* mzSample::getBIC(float rtmin, float rtmax, int mslevel)
     e->totalIntensity = 0;
     e->maxIntensity = 0;
 
-    int scanCount = scans.size();
-    if (scanCount == 0)
+    lock_guard<mutex> lock(_ionChromatogramMutex);
+    if (_ionChromatograms.empty() || _ionChromatogramScanCount != scans.size())
+        _buildIonChromatograms();
+
+    auto it = _ionChromatograms.find(mslevel);
+    if (it == _ionChromatograms.end())
+        return e;
+    const IonChromatogram& chromatogram = it->second;
+
+    // binary search the rt range, unless the whole run is requested
+    size_t first = 0;
+    size_t last = chromatogram.rt.size();
+    if (rtmax > rtmin) {
+        first = lower_bound(begin(chromatogram.rt),
+                            end(chromatogram.rt),
+                            rtmin)
+                - begin(chromatogram.rt);
+        last = upper_bound(begin(chromatogram.rt) + first,
+                           end(chromatogram.rt),
+                           rtmax)
+               - begin(chromatogram.rt);
+    }
+    if (first >= last)
         return e;
 
-    for (int i = 0; i < scanCount; i++) {
-        if (scans[i]->mslevel == mslevel) {
-            Scan* scan = scans[i];
-            float maxMz = 0;
-            float maxIntensity = 0;
-            for (unsigned int i = 0; i < scan->intensity.size(); i++) {
-                if (scan->intensity[i] > maxIntensity) {
-                    maxIntensity = scan->intensity[i];
-                    maxMz = scan->mz[i];
-                }
-            }
-            e->mz.push_back(maxMz);
-            e->scannum.push_back(i);
-            e->rt.push_back(scan->rt);
-            e->intensity.push_back(maxIntensity);
-            e->totalIntensity += maxIntensity;
-            if (maxIntensity > e->maxIntensity) {
-                e->maxIntensity = maxIntensity;
-                e->rtAtMaxIntensity = scan->rt;
-                e->mzAtMaxIntensity = maxMz;
-            }
-        }
+    const vector<float>& intensity = basePeak
+                                         ? chromatogram.basePeakIntensity
+                                         : chromatogram.totalIntensity;
+    e->scannum.assign(begin(chromatogram.scannum) + first,
+                      begin(chromatogram.scannum) + last);
+    e->rt.assign(begin(chromatogram.rt) + first,
+                 begin(chromatogram.rt) + last);
+    e->intensity.assign(begin(intensity) + first, begin(intensity) + last);
+    if (basePeak) {
+        e->mz.assign(begin(chromatogram.basePeakMz) + first,
+                     begin(chromatogram.basePeakMz) + last);
+    } else {
+        e->mz.assign(last - first, 0);
     }
-    if (e->rt.size() > 0) {
-        e->rtmin = e->rt[0];
-        e->rtmax = e->rt[e->size() - 1];
+
+    for (size_t i = 0; i < e->intensity.size(); i++) {
+        float y = e->intensity[i];
+        e->totalIntensity += y;
+        if (y > e->maxIntensity) {
+            e->maxIntensity = y;
+            e->rtAtMaxIntensity = e->rt[i];
+            e->mzAtMaxIntensity = e->mz[i];
+        }
     }
+    e->rtmin = e->rt.front();
+    e->rtmax = e->rt.back();
     return (e);
 }
 
@@ -1813,8 +2747,8 @@ int mzSample::parseCDF(const char* filename, int is_verbose)
                 inty_pt = inty_pt * raw_global_data.intensity_factor
                           + raw_global_data.intensity_offset;
                 // cerr << "mz/int" << mass_pt << " " << inty_pt << endl;
-                myscan->intensity[i] = inty_pt;
-                myscan->mz[i] = mass_pt;
+                myscan->intensity.values()[i] = inty_pt;
+                myscan->mz.values()[i] = mass_pt;
 
                 if (raw_data.flags > 0)
                     printf("\nWarning: There are flags in scan %ld (ignored).",
@@ -1852,7 +2786,7 @@ Scan* mzSample::getAverageScan(float rtmin,
             || scans[s]->rt < rtmin || scans[s]->rt > rtmax)
             continue;
 
-        Scan* scan = scans[s];
+        auto scan = loadScanData(scans[s]);
         scanCount++;
         for (unsigned int i = 0; i < scan->mz.size(); i++) {
             float bin = FLOATROUND(scan->mz[i], sd);
@@ -1899,33 +2833,92 @@ void mzSample::restorePreviousRetentionTimes()
             scans[ii]->rt = lastSavedRTs[ii];
         }
     }
+    retentionTimesUpdated();
+}
+
+void mzSample::buildFragmentationIndex()
+{
+    lock_guard<mutex> lock(_fragmentationIndexMutex);
+    _buildFragmentationIndex();
+}
+
+void mzSample::_buildFragmentationIndex()
+{
+    const vector<Scan*>& ms2Scans = scansAtMsLevel(2);
+    _fragmentationIndex.clear();
+    _fragmentationIndex.reserve(ms2Scans.size());
+    for (auto scan : ms2Scans)
+        _fragmentationIndex.push_back({scan->precursorMz, scan});
+
+    // stable, so that events of equal precursor m/z stay in scan order
+    stable_sort(begin(_fragmentationIndex),
+                end(_fragmentationIndex),
+                [](const FragmentationEvent& a, const FragmentationEvent& b) {
+                    return a.precursorMz < b.precursorMz;
+                });
+    _fragmentationIndexScanCount = scans.size();
+}
+
+vector<mzSample::FragmentationEvent>::const_iterator
+mzSample::_findFragmentationEvent(mzValue mzmin)
+{
+    if (_fragmentationIndex.empty()
+        || _fragmentationIndexScanCount != scans.size())
+        _buildFragmentationIndex();
+
+    return lower_bound(begin(_fragmentationIndex),
+                       end(_fragmentationIndex),
+                       mzmin,
+                       [](const FragmentationEvent& event, mzValue mz) {
+                           return event.precursorMz < mz;
+                       });
 }
 
 vector<Scan*> mzSample::getFragmentationEvents(mzSlice* slice)
 {
     vector<Scan*> matchedScans;
-    for (auto scan : scans) {
-        if (scan->mslevel != 2)
-            continue;  // ms2 + scans only
-        if (scan->rt < slice->rtmin)
-            continue;
-        if (scan->rt > slice->rtmax)
-            break;
-        if (scan->precursorMz >= slice->mzmin
-            && scan->precursorMz <= slice->mzmax) {
-            matchedScans.push_back(scan);
+    {
+        lock_guard<mutex> lock(_fragmentationIndexMutex);
+        auto it = _findFragmentationEvent(slice->mzmin);
+        for (; it != _fragmentationIndex.cend(); ++it) {
+            if (it->precursorMz > slice->mzmax)
+                break;
+
+            // rt is read from the scan, so alignment does not stale the index
+            Scan* scan = it->scan;
+            if (scan->rt >= slice->rtmin && scan->rt <= slice->rtmax)
+                matchedScans.push_back(scan);
         }
     }
+
+    sort(begin(matchedScans),
+         end(matchedScans),
+         [](const Scan* a, const Scan* b) { return a->scannum < b->scannum; });
     return matchedScans;
 }
 
+size_t mzSample::countFragmentationEvents(mzSlice* slice)
+{
+    lock_guard<mutex> lock(_fragmentationIndexMutex);
+    size_t count = 0;
+    auto it = _findFragmentationEvent(slice->mzmin);
+    for (; it != _fragmentationIndex.cend(); ++it) {
+        if (it->precursorMz > slice->mzmax)
+            break;
+        if (it->scan->rt >= slice->rtmin && it->scan->rt <= slice->rtmax)
+            count++;
+    }
+    return count;
+}
+
 vector<float> mzSample::getIntensityDistribution(int mslevel)
 {
     vector<float> allintensities;
     for (unsigned int s = 0; s < this->scans.size(); s++) {
-        Scan* scan = this->scans[s];
-        if (scan->mslevel != mslevel)
+        Scan* header = this->scans[s];
+        if (header->mslevel != mslevel)
             continue;
+        auto scan = loadScanData(header);
 
         for (unsigned int i = 0; i < scan->mz.size(); i++) {
             allintensities.push_back(scan->intensity[i]);
@@ -1952,6 +2945,7 @@ void mzSample::applyPolynomialTransform()
         // newrt << endl;
         scans[i]->rt = newrt;
     }
+    retentionTimesUpdated();
 }
 
 mzLink::mzLink()
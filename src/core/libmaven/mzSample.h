@@ -3,8 +3,12 @@
 
 #include <chrono_io.h>
 #include <date.h>
+#include <list>
+#include <mutex>
 
 #include "assert.h"
+#include "datastructures/scanmzindex.h"
+#include "datastructures/spectrumstore.h"
 #include "mzUtils.h"
 #include "pugixml.hpp"
 #include "standardincludes.h"
@@ -238,6 +242,14 @@ class mzSample
     */
     void parseMzXMLScan(const xml_node &scan, const int& scannum);
 
+    /**
+    * @brief Parse the metadata of an mzXML scan into a scan without peaks
+    * @param scan xml_node object of pugixml library
+    * @param scannum scan number
+    * @return The new scan, yet to be added to the sample with addScan
+    */
+    Scan *parseMzXMLScanHeader(const xml_node &scan, int scannum);
+
     /**
     * @brief Write mzCSV file
     * @param char* mzCSV file name
@@ -245,11 +257,43 @@ class mzSample
     void writeMzCSV(const char *);
 
     /**
-    * @brief Get cv parameters of an xml_node from mzML format
-    * @param node xml_node object of pugixml lirary
-    * @return Returns a map of name and corresponding value of an xml_node object
+    * @brief Controlled vocabulary terms read from mzML cvParams
+    * @details Each value is the number of the term's PSI-MS accession,
+    * e.g., MS:1000511 for "ms level".
     */
-    static map<string, string> mzML_cvParams(xml_node node);
+    enum class MzMLTerm {
+        Unknown = 0,
+        ScanStartTime = 1000016,
+        CollisionEnergy = 1000045,
+        NegativeScan = 1000129,
+        PositiveScan = 1000130,
+        TotalIonCurrent = 1000285,
+        BasePeakMz = 1000504,
+        BasePeakIntensity = 1000505,
+        MsLevel = 1000511,
+        FilterString = 1000512,
+        MzArray = 1000514,
+        IntensityArray = 1000515,
+        Float32 = 1000521,
+        Float64 = 1000523,
+        HighestObservedMz = 1000527,
+        LowestObservedMz = 1000528,
+        ZlibCompression = 1000574,
+        TimeArray = 1000595,
+        IsolationWindowTargetMz = 1000827,
+        IsolationWindowLowerOffset = 1000828,
+        IsolationWindowUpperOffset = 1000829
+    };
+
+    /**
+    * @brief Identify the term of an mzML cvParam
+    * @details Matches the accession of the cvParam (or its name, if it has
+    * no accession) against a fixed table of the terms used while parsing,
+    * without allocating memory.
+    * @param cvParam cvParam xml_node object of pugixml library
+    * @return The matching term, or MzMLTerm::Unknown
+    */
+    static MzMLTerm mzMLTerm(const xml_node &cvParam);
 
     /**
      * @brief Update injection time stamp
@@ -274,6 +318,37 @@ class mzSample
     */
     void parseMzMLSpectrumList(const xml_node&);
 
+    /**
+    * @brief Parse a single mzML spectrum into a scan
+    * @param spectrum xml_node object of pugixml library
+    * @param scannum scan number
+    * @return The new scan, yet to be added to the sample with addScan, or
+    * NULL if the spectrum had no data
+    */
+    Scan *parseMzMLSpectrum(const xml_node &spectrum, int scannum);
+
+    /**
+    * @brief Parse the metadata of an mzML spectrum into a scan without peaks
+    * @param spectrum xml_node object of pugixml library
+    * @param scannum scan number
+    * @return The new scan, yet to be added to the sample with addScan, or
+    * NULL if the spectrum is empty
+    */
+    Scan *parseMzMLSpectrumHeader(const xml_node &spectrum, int scannum);
+
+    /**
+    * @brief Decode the m/z and intensity arrays of an mzML spectrum
+    * @param spectrum xml_node object of pugixml library
+    * @param mzVector Set to the m/z array, if present
+    * @param intsVector Set to the intensity array, if present
+    * @return False if the spectrum has no binary data
+    * @throw MavenException if an array cannot be decoded (e.g., corrupt
+    * zlib data)
+    */
+    bool parseMzMLBinaryData(const xml_node &spectrum,
+                             vector<mzValue> &mzVector,
+                             vector<float> &intsVector);
+
     /**
     * @brief Print info about sample 
     * @details Print data of sample: 1. Number of observations 2. rt range
@@ -285,7 +360,8 @@ class mzSample
     * @brief Compute min and max values for mz and rt
     * @details Compute min and max values for mz and rt by iterating over
     * the scans. Also while iterating over scans, calculate min and max
-    * Intensity
+    * Intensity, and cache the summary of each scan
+    * @see Scan::updateSummary
     */
     void calculateMzRtRange();
 
@@ -303,6 +379,123 @@ class mzSample
     */
     void enumerateSRMScans();
 
+    /**
+    * @brief Build the per MS level scan index
+    * @details Groups pointers to all scans by their MS level, preserving
+    * the retention time order of `scans`. Called once a sample has been
+    * loaded, and kept up to date by addScan afterwards.
+    * @see mzSample::scansAtMsLevel
+    */
+    void indexScans();
+
+    /**
+    * @brief Read-only view over scans of a single MS level
+    * @details The returned scans are ordered by retention time and can be
+    * binary searched directly, without copying the sample's scan list. The
+    * scannum of each scan is its position in `scans`.
+    * @param mslevel MS level of interest
+    * @return Scans at the given MS level (empty if there are none)
+    */
+    const vector<Scan *> &scansAtMsLevel(int mslevel) const;
+
+    /**
+    * @brief Pack all spectra of this sample into a columnar store
+    * @details Once built, the store holds the only copy of the peaks: the
+    * m/z and intensity arrays of each scan become views of its row in the
+    * store, so scans are read as before without copying anything back.
+    * EIC, feature slice and chromatogram extraction read contiguous
+    * per-sample arrays directly. Does nothing for samples whose peaks are
+    * read from their file on demand.
+    * @see SpectrumStore
+    */
+    void buildSpectrumStore();
+
+    /**
+    * @brief Release the columnar store, if one was built, giving each scan
+    * its own copy of the peaks it viewed
+    */
+    void releaseSpectrumStore();
+
+    /**
+    * @brief Check whether this sample has a columnar spectrum store
+    * @return True if the store has been built
+    */
+    bool hasSpectrumStore() const { return !_spectrumStore.empty(); }
+
+    /**
+    * @brief Columnar store of this sample's spectra
+    * @return Reference to the (possibly empty) store
+    */
+    const SpectrumStore &spectrumStore() const { return _spectrumStore; }
+
+    /**
+    * @brief Build the index from m/z bins to the scans with peaks in them
+    * @details Once built, EIC extraction skips scans that have no peak
+    * in the bins covered by the extracted window, without reading their
+    * peaks. Scans added afterwards are never skipped.
+    * @see ScanMzIndex
+    */
+    void buildScanMzIndex();
+
+    /**
+    * @brief Release the m/z to scan index, if one was built
+    */
+    void releaseScanMzIndex();
+
+    /**
+    * @brief Check whether this sample has an m/z to scan index
+    * @return True if the index has been built
+    */
+    bool hasScanMzIndex() const { return !_scanMzIndex.empty(); }
+
+    /**
+    * @brief Index from m/z bins to the scans of this sample
+    * @return Reference to the (possibly empty) index
+    */
+    const ScanMzIndex &scanMzIndex() const { return _scanMzIndex; }
+
+    /**
+    * @brief Check whether a scan of this sample may have peaks within an
+    * m/z range, using the cached m/z bounds of the scan and the m/z to
+    * scan index if there is one
+    * @details Does not read the peaks of lazily loaded scans.
+    * @return False if the scan certainly has no peak in [mzmin, mzmax]
+    */
+    bool scanMayContainMz(const Scan *scan, mzValue mzmin, mzValue mzmax) const;
+
+    /**
+    * @brief Notify the sample that retention times of its scans changed
+    * @details Must be called by any code that rewrites Scan::rt of the
+    * scans of this sample (alignment, restoring alignment, etc.), so that
+    * data derived from retention times (spectrum store, TIC and BIC) can be
+    * updated.
+    */
+    void retentionTimesUpdated();
+
+    /**
+    * @brief Get a scan along with its peaks
+    * @details Scans of samples loaded with lazy scan loading only keep
+    * their header in memory. For those, the returned scan is a copy holding
+    * the peaks read back from the file, shared with other callers through a
+    * least recently used cache of mzSample::getScanCacheSize megabytes.
+    * Evicting a copy from the cache only drops the reference of the cache,
+    * so the peaks stay valid for as long as the returned pointer is held,
+    * and any number of threads may read scans of the same sample. For all
+    * other scans, the scan itself is returned.
+    * @param scan Scan of this sample
+    * @return Scan with its peaks in memory (without peaks if they could not
+    * be read), or null if `scan` is null
+    * @see mzSample::setLazyScanLoading
+    */
+    shared_ptr<const Scan> loadScanData(Scan *scan);
+
+    /**
+    * @brief Check whether peaks of this sample are read on demand
+    * @return True if scans only keep their headers in memory. Samples with
+    * a columnar store keep all their peaks in memory and are not lazy.
+    */
+    bool hasLazyScans() const { return _lazyScans; }
+
     /**
     * @brief Find correlation between two EICs
     * @param mz1 m/z for first EIC
@@ -361,6 +554,8 @@ class mzSample
 
     /**
     * @brief Get scan for a given scan number
+    * @details Scans of lazily loaded samples are returned without their
+    * peaks, which are read with mzSample::loadScanData.
     * @param scanNum Scan number
     * @return Scan class object
     * @see Scan
@@ -390,7 +585,36 @@ class mzSample
     * @return EIC class object
     * @see EIC
     */
-    EIC *getEIC(float mzmin, float mzmax, float rtmin, float rtmax, int mslevel, int eicType, string filterline);
+    EIC *getEIC(mzValue mzmin, mzValue mzmax, float rtmin, float rtmax, int mslevel, int eicType, string filterline);
+
+    /**
+    * @brief Find the highest intensity of an EIC, along with its retention
+    * time and m/z, without creating the EIC.
+    * @details The values found are the `maxIntensity`, `rtAtMaxIntensity`
+    * and `mzAtMaxIntensity` of the EIC that getEIC returns for the same
+    * arguments. Callers that need nothing else can avoid allocating and
+    * filling the EIC's vectors.
+    * @param mzmin Minimum m/z
+    * @param mzmax Maximum m/z
+    * @param rtmin Minimum retention time
+    * @param rtmax Maximum retention time
+    * @param mslevel MS Level
+    * @param eicType Type of EIC (max or sum)
+    * @param filterline selected filterline
+    * @param maxIntensity Set to the highest intensity (zero if none)
+    * @param rtAtMax Set to the retention time of the highest intensity
+    * @param mzAtMax Set to the m/z of the highest intensity
+    */
+    void getEICMaximum(mzValue mzmin,
+                       mzValue mzmax,
+                       float rtmin,
+                       float rtmax,
+                       int mslevel,
+                       int eicType,
+                       const string& filterline,
+                       float& maxIntensity,
+                       float& rtAtMax,
+                       mzValue& mzAtMax);
 
     /**
     * @brief Get EIC based on srmId
@@ -416,15 +640,20 @@ class mzSample
 
     /**
     * @brief Get Total Ion Chromatogram
+    * @details Read from chromatograms computed once per sample, which are
+    * recomputed after retention times have been updated. If rtmax is not
+    * greater than rtmin, the whole run is returned.
     * @param rtmin Minimum retention time
     * @param rtmax Maximum retention time
     * @param mslevel MS level of the MS machine
     * @return EIC class object
+    * @see mzSample::retentionTimesUpdated
     */
     EIC *getTIC(float rtmin, float rtmax, int mslevel);
 
     /**
     * @brief Get Base Peak Chromatogram
+    * @details Read from chromatograms computed once per sample, see getTIC.
     * @param rtmin Minimum retention time
     * @param rtmax Maximum retention time
     * @param mslevel MS level of the MS machine
@@ -564,10 +793,30 @@ class mzSample
 
     /**
      * @brief find all MS2 scans within the slice
-     * @return vector of all matching MS2 scans
+     * @details Candidates are looked up by precursor m/z in the
+     * fragmentation index, which is built on first use if needed. Scans of
+     * lazily loaded samples are returned without their peaks, which callers
+     * read with mzSample::loadScanData if they need them.
+     * @return vector of all matching MS2 scans, in scan order
      */
     vector<Scan*> getFragmentationEvents(mzSlice* slice);
 
+    /**
+     * @brief Count the MS2 scans within the slice
+     * @details Same lookup as getFragmentationEvents, reading only the
+     * precursor m/z and rt of the scans, without collecting them.
+     * @return Number of matching MS2 scans
+     */
+    size_t countFragmentationEvents(mzSlice* slice);
+
+    /**
+    * @brief Build the index of MS2 scans sorted by precursor m/z, used to
+    * look up fragmentation events
+    * @details Rebuilt automatically when scans have been added since.
+    * @see mzSample::getFragmentationEvents
+    */
+    void buildFragmentationIndex();
+
     /**
                           * [C13Labeled?]
                           * @method C13Labeled
@@ -644,6 +893,35 @@ class mzSample
                           */
     static void setFilter_polarity(int x) { filter_polarity = x; }
 
+    /**
+    * @brief Set whether samples build a columnar spectrum store on load
+    * @param x True to build the store for every subsequently loaded sample
+    * @see mzSample::buildSpectrumStore
+    */
+    static void setUseSpectrumStore(bool x) { useSpectrumStore = x; }
+
+    /**
+    * @brief Set whether samples keep only scan headers in memory
+    * @details Applies to mzML and mzXML files. Peaks are read again from
+    * the file when needed, using the byte offsets recorded while loading.
+    * @param x True to load subsequently loaded samples lazily
+    * @see mzSample::loadScanData
+    */
+    static void setLazyScanLoading(bool x) { lazyScanLoading = x; }
+
+    /**
+    * @brief Set whether samples build an m/z to scan index on load
+    * @param x True to build the index for every subsequently loaded sample
+    * @see mzSample::buildScanMzIndex
+    */
+    static void setUseScanMzIndex(bool x) { useScanMzIndex = x; }
+
+    /**
+    * @brief Set the size of the per-sample cache of scan peaks
+    * @param x Size in megabytes, used by lazily loaded samples
+    */
+    static void setScanCacheSize(int x) { scanCacheSize = x; }
+
     /**
                           * [getFilter_minIntensity ]
                           * @method getFilter_minIntensity
@@ -679,6 +957,30 @@ class mzSample
                           */
     static int getFilter_polarity() { return filter_polarity; }
 
+    /**
+    * @brief Check whether samples build a columnar spectrum store on load
+    * @return True if the store is built while loading samples
+    */
+    static bool getUseSpectrumStore() { return useSpectrumStore; }
+
+    /**
+    * @brief Check whether samples keep only scan headers in memory
+    * @return True if samples are loaded lazily
+    */
+    static bool getLazyScanLoading() { return lazyScanLoading; }
+
+    /**
+    * @brief Size of the per-sample cache of scan peaks
+    * @return Size in megabytes
+    */
+    static int getScanCacheSize() { return scanCacheSize; }
+
+    /**
+    * @brief Check whether samples build an m/z to scan index on load
+    * @return True if the index is built while loading samples
+    */
+    static bool getUseScanMzIndex() { return useScanMzIndex; }
+
     vector<float> getIntensityDistribution(int mslevel);
 
     deque<Scan *> scans;
@@ -729,6 +1031,99 @@ class mzSample
     unsigned int _numMS1Scans;
     unsigned int _numMS2Scans;
 
+    map<int, vector<Scan *> > _scansByMsLevel; //MS level to scan mapping
+
+    SpectrumStore _spectrumStore;
+
+    ScanMzIndex _scanMzIndex;
+
+    bool _lazyScans; //scan data is read on demand
+
+    //file offset of the element being streamed, -1 for a full document
+    long long _streamOffset;
+
+    //copies of scans with their peaks read back from the file, most recently
+    //used first
+    typedef list<pair<Scan *, shared_ptr<const Scan> > > ScanCache;
+    mutex _scanCacheMutex;
+    ScanCache _cachedScans;
+    map<Scan *, ScanCache::iterator> _cachedScanPos;
+    size_t _cachedScanBytes;
+    ifstream _scanDataFile;
+
+    /**
+    * @brief Total and base peak intensities of the scans of one MS level,
+    * in retention time order
+    */
+    struct IonChromatogram
+    {
+        vector<int> scannum;
+        vector<float> rt;
+        vector<float> totalIntensity;
+        vector<float> basePeakIntensity;
+        vector<float> basePeakMz;
+    };
+
+    //chromatograms by MS level, empty until needed or stale, and the number
+    //of scans they were computed from
+    mutex _ionChromatogramMutex;
+    map<int, IonChromatogram> _ionChromatograms;
+    size_t _ionChromatogramScanCount;
+
+    /**
+    * @brief Compute the TIC and BIC of every MS level from the scan
+    * summaries. Must be called with _ionChromatogramMutex held.
+    */
+    void _buildIonChromatograms();
+
+    /**
+    * @brief An MS2 scan and its precursor m/z, copied for a cache friendly
+    * binary search
+    */
+    struct FragmentationEvent
+    {
+        float precursorMz;
+        Scan *scan;
+    };
+
+    //MS2 scans sorted by precursor m/z, empty until needed or stale, and the
+    //number of scans they were taken from
+    mutex _fragmentationIndexMutex;
+    vector<FragmentationEvent> _fragmentationIndex;
+    size_t _fragmentationIndexScanCount;
+
+    /**
+    * @brief Sort the MS2 scans by precursor m/z. Must be called with
+    * _fragmentationIndexMutex held.
+    */
+    void _buildFragmentationIndex();
+
+    /**
+    * @brief Find the first event of the fragmentation index with a precursor
+    * m/z of at least mzmin, rebuilding the index first if it is missing or
+    * stale. Must be called with _fragmentationIndexMutex held.
+    */
+    vector<FragmentationEvent>::const_iterator
+    _findFragmentationEvent(mzValue mzmin);
+
+    /**
+    * @brief Copy the part of a TIC or BIC within an rt range into a new EIC
+    * @param basePeak True for the BIC, false for the TIC
+    */
+    EIC *_getIonChromatogram(float rtmin,
+                             float rtmax,
+                             int mslevel,
+                             bool basePeak);
+
+    /**
+    * @brief Limit an m/z-rt window to the ranges covered by this sample,
+    * as done before pulling EICs.
+    */
+    void _clampToSampleRange(mzValue &mzmin,
+                             mzValue &mzmax,
+                             float &rtmin,
+                             float &rtmax) const;
+
     void sampleNaming(const char *filename);
     void checkSampleBlank(const char *filename);
 
@@ -744,14 +1139,130 @@ class mzSample
 
     static int getPolarityFromfilterLine(string filterLine);
 
-    vector<float> parsePeaksFromMzXML(const xml_node &scan);
-
-    void populateMzAndIntensity(const vector<float>& mzint, Scan *_scan);
+    /**
+    * @brief Decode the peaks of an mzXML scan
+    * @details Pairs without a positive m/z and intensity are dropped.
+    * @param scan Scan xml_node object of pugixml library
+    * @param mzs Set to the m/z values of the peaks
+    * @param intensities Set to the intensities of the peaks
+    * @return Number of values decoded (zero if the scan has no peaks)
+    * @throw MavenException if the peaks cannot be decoded
+    */
+    size_t parsePeaksFromMzXML(const xml_node &scan,
+                               vector<mzValue> &mzs,
+                               vector<float> &intensities);
 
     void populateFilterline(const string& filterLine, Scan *_scan);
 
     void loadAnySample(string filename);
 
+    /**
+    * @brief Parse an mzML file one spectrum at a time
+    * @details Only the spectrum being parsed is held in memory, instead of
+    * the whole document.
+    * @return False if the file could not be streamed, in which case no
+    * scans have been added
+    */
+    bool streamMzML(const char *filename);
+
+    /**
+    * @brief Parse an mzXML file one (top level) scan at a time
+    * @return False if the file could not be streamed, in which case no
+    * scans have been added
+    */
+    bool streamMzXML(const char *filename);
+
+    /**
+    * @brief Check whether lazily loaded scans can be read from their headers
+    * @details Scans read on load would have to be filtered or indexed
+    * through their peaks otherwise.
+    */
+    static bool canLoadScanHeaders();
+
+    /**
+    * @brief Read only the headers of the spectra of an indexed mzML file
+    * @details The spectra are found through the offset index at the end of
+    * the file, and their peaks are left in the file. Summaries of the scans
+    * are taken from the m/z range, base peak and total ion current of the
+    * spectra.
+    * @return False if the file has no index, or its spectra lack any of
+    * these values, in which case no scans have been added
+    */
+    bool loadMzMLHeaders(const char *filename);
+
+    /**
+    * @brief Read only the headers of the scans of an indexed mzXML file
+    * @details See loadMzMLHeaders. MS1 scans are still read back, while
+    * loading, to recalculate the precursor m/z of the MS2 scans that follow
+    * them.
+    * @return False if the file has no index, or its scans lack any of the
+    * values summarizing their peaks, in which case no scans have been added
+    */
+    bool loadMzXMLHeaders(const char *filename);
+
+    /**
+    * @brief Read the byte ranges of the scans listed in the offset index of
+    * an mzML or mzXML file
+    * @param indexName Name of the index of the scans, "spectrum" for mzML
+    * and "scan" for mzXML
+    * @param ranges Set to the start of each scan and the next offset found
+    * in the file (of any index, or of the index itself), in file order
+    * @return False if the file has no index listing scans
+    */
+    static bool readScanIndex(const char *filename,
+                              const char *indexName,
+                              vector<pair<long long, long long> > &ranges);
+
+    /**
+    * @brief Read the start of a scan element, up to its peaks
+    * @param file Stream of the file the scan is read from
+    * @param range Byte range of the scan in the file
+    * @param tag Name of the scan element
+    * @param peaksTag Name of the first element holding peaks
+    * @param header Set to the element without its peaks, closed so that it
+    * can be parsed on its own, or to an empty string if the element ends
+    * before any peaks
+    * @return False if the range does not hold a scan element
+    */
+    static bool readScanHeader(ifstream &file,
+                               const pair<long long, long long> &range,
+                               const string &tag,
+                               const string &peaksTag,
+                               string &header);
+
+    /**
+    * @brief Parse an mzData file one spectrum at a time
+    * @return False if the file could not be streamed, in which case no
+    * scans have been added
+    */
+    bool streamMzData(const char *filename);
+
+    void parseMzDataSpectrum(const xml_node &spectrum, int scannum);
+
+    /**
+    * @brief Delete all scans of this sample
+    */
+    void clearScans();
+
+    /**
+    * @brief Apply the global scan filters (centroiding, intensity) to the
+    * peaks of a scan
+    */
+    void applyScanFilters(Scan *s);
+
+    /**
+    * @brief Release peaks of all scans that can be read again from the file
+    */
+    void releaseScanData();
+
+    /**
+    * @brief Read the peaks of a scan from its byte range in the file
+    * @param scan Scan whose byte range is read
+    * @param scanData Scan receiving the peaks, which are filtered as on load
+    * @return False if the range could not be read or parsed
+    */
+    bool readScanData(const Scan *scan, Scan *scanData);
+
     //TODO: This should be moved
     static string getFileName(const string &filename);
     static int filter_minIntensity;
@@ -759,14 +1270,12 @@ class mzSample
     static int filter_intensityQuantile;
     static int filter_mslevel;
     static int filter_polarity;
+    static bool useSpectrumStore;
+    static bool lazyScanLoading;
+    static int scanCacheSize;
+    static bool useScanMzIndex;
 
-    vector<string> filterChromatogram {
-        "sample", 
-        "start",
-        "end",
-        "index",
-        "scan"
-    };
+    static const vector<string> filterChromatogram;
 };
 
 /**
@@ -15,6 +15,7 @@
 #include "doctest.h"
 #include "mzUtils.h"
 #include "SavGolSmoother.h"
+#include "smoothingengine.h"
 #include "csvparser.h"
 #include "masscutofftype.h"
 #include "RealFirFilter.h"
@@ -136,121 +137,48 @@ namespace mzUtils {
             return false;
     }
 
-    void smoothAverage(float *input, float* result, int smoothWindowLen,
+    void smoothAverage(const float *input, float* result, int smoothWindowLen,
                        int inputLen)
     {
-        if (smoothWindowLen == 0 ) return;
-        float* x = new float[smoothWindowLen];
-
-        for(int i = 0; i < smoothWindowLen; i++)
-            x[i] = 1.0/smoothWindowLen;
-        conv(smoothWindowLen, -smoothWindowLen/2, x, inputLen,
-                 0, input, inputLen, 0, result);
-        delete[] x;
+        SmoothingEngine::forCurrentThread().movingAverage(input,
+                                                          result,
+                                                          inputLen,
+                                                          smoothWindowLen);
     }
 
-    void conv (int xLen, int indexFirstX, float *x, int inputLen,
-              int indexFirstInput, float *input, int resultLen,
+    void conv (int xLen, int indexFirstX, const float *x, int inputLen,
+              int indexFirstInput, const float *input, int resultLen,
               int indexFirstResult, float *result)
    {
-        int ilx = indexFirstX + xLen - 1;
-        int ily = indexFirstInput + inputLen - 1;
-        int ilz = indexFirstResult + resultLen - 1;
-
-        int i, j, jlow, jhigh;
-        float sum;
-
-        x -= indexFirstX;
-        input -= indexFirstInput;
-        result -= indexFirstResult;
-
-        for (i = indexFirstResult; i <= ilz; ++i)
-        {
-            jlow = i - ily;
-            if (jlow < indexFirstX)
-                    jlow = indexFirstX;
-            jhigh = i - indexFirstInput;
-            if (jhigh > ilx)
-                jhigh = ilx;
-
-            for (j = jlow, sum = 0.0; j <= jhigh; ++j)
-                sum += x[j] * input[i-j];
-            result[i] = sum;
+        for (int i = 0; i < resultLen; ++i)
+            result[i] = 0.0;
+
+        // the outer loop runs over x so that the inner one, over contiguous
+        // results, can be vectorised; each result still sums its terms in
+        // the order of x
+        for (int k = 0; k < xLen; ++k) {
+            int j = indexFirstX + k;
+            int first = max(indexFirstResult, indexFirstInput + j);
+            int last = min(indexFirstResult + resultLen - 1,
+                           indexFirstInput + inputLen - 1 + j);
+            if (last < first)
+                continue;
+
+            int count = last - first + 1;
+            float* z = result + (first - indexFirstResult);
+            const float* y = input + (first - j - indexFirstInput);
+            float xk = x[k];
+#pragma omp simd
+            for (int i = 0; i < count; ++i)
+                z[i] += xk * y[i];
         }
     }
 
     void gaussian1d_smoothing (int numSample, int smoothWindowLen, float *data)
     {
-        int is;             /* loop counter */
-        float sum = 0.0;
-        float fcut;
-        float r;
-        float fcutr = 1.0/smoothWindowLen;
-        int n = 0;
-        int mean = 0;
-        float fcutl = 0;
-        float s[1000];      /* smoothing filter array */
-        float *temp;            /* temporary array */
-
-        /* save input fcut */
-        fcut = fcutr;
-
-        /* don't smooth if nsr equal to zero */
-        if (smoothWindowLen == 0 || numSample <= 1)
-            return;
-
-        /* if halfwidth more than 100 samples, truncate */
-        if (smoothWindowLen > 100)
-            fcut=1.0/100;
-
-        /* allocate space */
-        temp = new float[numSample];
-
-        /* initialize smoothing function if not the same as the last one used */
-        if (fcut != fcutl) {
-            fcutl = fcut;
-
-            /* set span of 3, at width of 1.5*exp(-PI*1.5**2)=1/1174 */
-            n = (int) (3.0 / fcut + 0.5);
-            n = 2 * n / 2 + 1;      /* make it odd for symmetry */
-
-            /* mean is the index of the zero in the smoothing wavelet */
-            mean = n / 2;
-
-            /* s(n) is the smoothing gaussian */
-            for (is = 1; is <= n; is++) {
-                r = is- mean - 1;
-                r = -r * r * fcut * fcut * 3.141;
-                s[is-1] = exp(r);
-            }
-
-            /* normalize to unit area, will preserve DC frequency at full
-               amplitude. Frequency at fcut will be half amplitude */
-            for (is = 0; is < n; is++)
-                sum += s[is];
-            for (is = 0; is < n; is++)
-                s[is] /= sum;
-        }
-
-        /* convolve by gaussian into buffer */
-        if (1.01/fcutr > (float)numSample) {
-            /* replace drastic smoothing by averaging */
-            sum = 0.0;
-            for (is = 0; is < numSample; is++)
-                sum += data[is];
-            sum /= numSample;
-
-            for (is = 0; is < numSample; is++)
-                data[is] = sum;
-
-        } else {
-            /* convolve with gaussian */
-            conv (n, -mean, s, numSample, -mean, data, numSample, -mean, temp);
-            /* copy filtered data back to output array */
-            for (is = 0; is < numSample; is++) data[is] = temp[is];
-        }
-        /* free allocated space */
-        delete[] temp;
+        SmoothingEngine::forCurrentThread().gaussian(data,
+                                                     numSample,
+                                                     smoothWindowLen);
     }
 
     float median(vector <float> y)
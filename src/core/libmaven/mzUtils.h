@@ -240,7 +240,7 @@ namespace mzUtils
      * @param  points        []
      * @param  n             []
      */
-    void smoothAverage(float* y, float* s, int points, int n);
+    void smoothAverage(const float* y, float* s, int points, int n);
 
     /********************************************************************
       Compute z = x convolved with y; i.e.,
@@ -270,20 +270,19 @@ namespace mzUtils
      of input, one might use x[0] = x[1] = x[2] = x[3] = x[4] = 1.0/5.0;
      conv(5, -2, x, xLen, 0, input, inputLen, 0, result);
      In this example, the filter x is symmetric, with index of first sample = -2
-     This function is optimized for architectures that can simultaneously
-     perform a multiply, add, and one load from memory; e.g., the IBM RISC
-     System/6000. Because, for each value of i, it accumulates the convolution
-     sum z[i] in a scalar, this function is not likely to be optimal for vector
-     architectures.
+     The sums are accumulated for all results at once, one x sample at a
+     time, so that they vectorise. Each z[i] adds its terms in increasing
+     order of j, giving the same values as a sum accumulated per result.
+     result must not overlap x or input.
      **************************************************************************
      Author:  Dave Hale, Colorado School of Mines, 11/23/91
      **************************************************************************/
     void conv(int xLen,
               int indexFirstX,
-              float* x,
+              const float* x,
               int inputLen,
               int indexFirstInput,
-              float* input,
+              const float* input,
               int resultLen,
               int indexFirstResult,
               float* result);
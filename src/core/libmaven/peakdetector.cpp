@@ -6,6 +6,7 @@
 #include <boost/bind.hpp>
 
 #include "classifierNeuralNet.h"
+#include "eiccache.h"
 #include "datastructures/adduct.h"
 #include "datastructures/isotope.h"
 #include "datastructures/mzSlice.h"
@@ -42,10 +43,25 @@ void PeakDetector::resetProgressBar() {
     _zeroStatus = true;
 }
 
+// set baseline parameters of an EIC to those of the current settings
+static void _setBaselineParameters(EIC* e, const MavenParameters* mp)
+{
+    if (mp->aslsBaselineMode) {
+        e->setBaselineMode(EIC::BaselineMode::AsLSSmoothing);
+        e->setAsLSSmoothness(mp->aslsSmoothness);
+        e->setAsLSAsymmetry(mp->aslsAsymmetry);
+    } else {
+        e->setBaselineMode(EIC::BaselineMode::Threshold);
+        e->setBaselineSmoothingWindow(mp->baseline_smoothingWindow);
+        e->setBaselineDropTopX(mp->baseline_dropTopX);
+    }
+}
+
 vector<EIC*> PeakDetector::pullEICs(const mzSlice* slice,
                                     const std::vector<mzSample*>& samples,
                                     const MavenParameters* mp,
-                                    bool filterUnselectedSamples)
+                                    bool filterUnselectedSamples,
+                                    EICCache* cache)
 {
     vector<mzSample*> vsamples;
     for (auto sample : samples) {
@@ -56,74 +72,162 @@ vector<EIC*> PeakDetector::pullEICs(const mzSlice* slice,
         vsamples.push_back(sample);
     }
 
-    vector<EIC*> eics;
-#pragma omp parallel
-    {
-        vector<EIC*> sharedEics;
-#pragma omp for nowait
-        for (unsigned int i = 0; i < vsamples.size(); i++) {
-            // Samples been selected
-            mzSample* sample = vsamples[i];
-            // getting the slice with which EIC has to be pulled
-            Compound* c = slice->compound;
-
-            EIC* e = nullptr;
-
-            if (!slice->srmId.empty()) {
-                e = sample->getEIC(slice->srmId, mp->eicType);
-            } else if (c && c->precursorMz() > 0 && c->productMz() > 0) {
-                e = sample->getEIC(c->precursorMz(),
-                                   c->collisionEnergy(),
-                                   c->productMz(),
-                                   mp->eicType,
-                                   mp->filterline,
-                                   mp->amuQ1,
-                                   mp->amuQ3);
+    // each iteration writes only its own sample's slot, so the order of the
+    // EICs does not depend on how samples are scheduled across threads
+    vector<EIC*> eicsBySample(vsamples.size(), nullptr);
+#pragma omp parallel for schedule(dynamic)
+    for (unsigned int i = 0; i < vsamples.size(); i++) {
+        // Samples been selected
+        mzSample* sample = vsamples[i];
+        // getting the slice with which EIC has to be pulled
+        Compound* c = slice->compound;
+
+        EIC* e = nullptr;
+
+        // RT range over which the trace (and its baseline) is computed
+        float eicRtMin = sample->minRt;
+        float eicRtMax = sample->maxRt;
+        if (mp->baselineWindowMode) {
+            eicRtMin = max(eicRtMin, slice->rtmin - mp->baselineWindowPadding);
+            eicRtMax = min(eicRtMax, slice->rtmax + mp->baselineWindowPadding);
+        }
+
+        if (!slice->srmId.empty()) {
+            e = sample->getEIC(slice->srmId, mp->eicType);
+        } else if (c && c->precursorMz() > 0 && c->productMz() > 0) {
+            e = sample->getEIC(c->precursorMz(),
+                               c->collisionEnergy(),
+                               c->productMz(),
+                               mp->eicType,
+                               mp->filterline,
+                               mp->amuQ1,
+                               mp->amuQ3);
+        } else if (cache == nullptr) {
+            e = sample->getEIC(slice->mzmin,
+                               slice->mzmax,
+                               eicRtMin,
+                               eicRtMax,
+                               1,
+                               mp->eicType,
+                               mp->filterline);
+        } else {
+            e = cache->getEIC(sample,
+                              slice->mzmin,
+                              slice->mzmax,
+                              eicRtMin,
+                              eicRtMax,
+                              1,
+                              mp->eicType,
+                              mp->filterline);
+        }
+
+        if (e) {
+            // if eic exists, perform smoothing
+            EIC::SmootherType smootherType =
+                (EIC::SmootherType)mp->eic_smoothingAlgorithm;
+            e->setSmootherType(smootherType);
+
+            // set appropriate baseline parameters
+            _setBaselineParameters(e, mp);
+
+            // in window mode the baseline is estimated over the padded window
+            // and kept when the trace is reduced to the slice, otherwise
+            // `getPeakPositions` estimates it over the reduced trace
+            bool windowBaseline = mp->baselineWindowMode
+                                  && slice->srmId.empty()
+                                  && !(c && c->precursorMz() > 0
+                                       && c->productMz() > 0);
+            if (windowBaseline)
+                e->computeBaseline();
+            e->reduceToRtRange(slice->rtmin, slice->rtmax);
+            if (slice->isotope.isNone()) {
+                e->setFilterSignalBaselineDiff(mp->minSignalBaselineDifference);
             } else {
-                e = sample->getEIC(slice->mzmin,
-                                   slice->mzmax,
-                                   sample->minRt,
-                                   sample->maxRt,
-                                   1,
-                                   mp->eicType,
-                                   mp->filterline);
+                e->setFilterSignalBaselineDiff(
+                    mp->isotopicMinSignalBaselineDifference);
             }
+            e->getPeakPositions(mp->eic_smoothingWindow, !windowBaseline);
+        }
+        eicsBySample[i] = e;
+    }
 
-            if (e) {
-                // if eic exists, perform smoothing
-                EIC::SmootherType smootherType =
-                    (EIC::SmootherType)mp->eic_smoothingAlgorithm;
-                e->setSmootherType(smootherType);
-
-                // set appropriate baseline parameters
-                if (mp->aslsBaselineMode) {
-                    e->setBaselineMode(EIC::BaselineMode::AsLSSmoothing);
-                    e->setAsLSSmoothness(mp->aslsSmoothness);
-                    e->setAsLSAsymmetry(mp->aslsAsymmetry);
-                } else {
-                    e->setBaselineMode(EIC::BaselineMode::Threshold);
-                    e->setBaselineSmoothingWindow(mp->baseline_smoothingWindow);
-                    e->setBaselineDropTopX(mp->baseline_dropTopX);
+    vector<EIC*> eics;
+    eics.reserve(eicsBySample.size());
+    for (auto eic : eicsBySample) {
+        if (eic != nullptr)
+            eics.push_back(eic);
+    }
+    return eics;
+}
+
+float PeakDetector::validateBaselineWindow(const vector<mzSlice*>& slices,
+                                           const vector<mzSample*>& samples,
+                                           const MavenParameters* mp,
+                                           ostream& report)
+{
+    MavenParameters parameters(*mp);
+
+    report << "mz,sample,rt,fullTraceArea,windowArea,relativeDifference"
+           << endl;
+    float maxDifference = 0.0f;
+    for (auto slice : slices) {
+        parameters.baselineWindowMode = false;
+        auto fullTraceEics = pullEICs(slice, samples, &parameters);
+        parameters.baselineWindowMode = true;
+        auto windowEics = pullEICs(slice, samples, &parameters);
+        for (auto fullTraceEic : fullTraceEics) {
+            auto windowEic = find_if(begin(windowEics),
+                                     end(windowEics),
+                                     [fullTraceEic](EIC* eic) {
+                                         return eic->sample
+                                                == fullTraceEic->sample;
+                                     });
+            for (auto& peak : fullTraceEic->peaks) {
+                // peaks sharing an apex are told apart by their bounds
+                auto distance = [&peak](const Peak& candidate) {
+                    return make_pair(abs(candidate.rt - peak.rt),
+                                     abs(candidate.rtmin - peak.rtmin)
+                                         + abs(candidate.rtmax - peak.rtmax));
+                };
+                Peak* match = nullptr;
+                if (windowEic != end(windowEics)) {
+                    for (auto& candidate : (*windowEic)->peaks) {
+                        if (match == nullptr
+                            || distance(candidate) < distance(*match)) {
+                            match = &candidate;
+                        }
+                    }
                 }
-                e->computeBaseline();
-                e->reduceToRtRange(slice->rtmin, slice->rtmax);
-                if (slice->isotope.isNone()) {
-                    e->setFilterSignalBaselineDiff(
-                        mp->minSignalBaselineDifference);
-                } else {
-                    e->setFilterSignalBaselineDiff(
-                        mp->isotopicMinSignalBaselineDifference);
+                if (match != nullptr
+                    && (match->rt < peak.rtmin || match->rt > peak.rtmax)) {
+                    match = nullptr;
                 }
-                e->getPeakPositions(mp->eic_smoothingWindow);
 
-                // push eic to shared EIC vector
-                sharedEics.push_back(e);
+                float windowArea = 0.0f;
+                float difference = 1.0f;
+                if (match != nullptr) {
+                    windowArea = match->peakAreaCorrected;
+                    float largerArea = max(abs(peak.peakAreaCorrected),
+                                           abs(windowArea));
+                    difference = largerArea > 0.0f
+                                     ? abs(peak.peakAreaCorrected - windowArea)
+                                           / largerArea
+                                     : 0.0f;
+                }
+                maxDifference = max(maxDifference, difference);
+
+                report << slice->mz << ","
+                       << fullTraceEic->sampleName << ","
+                       << peak.rt << ","
+                       << peak.peakAreaCorrected << ","
+                       << windowArea << ","
+                       << difference << endl;
             }
         }
-#pragma omp critical
-        eics.insert(begin(eics), begin(sharedEics), end(sharedEics));
+        delete_all(fullTraceEics);
+        delete_all(windowEics);
     }
-    return eics;
+    return maxDifference;
 }
 
 void PeakDetector::editPeakRegionForSample(PeakGroup *group,
@@ -203,6 +307,9 @@ void PeakDetector::processFeatures(const vector<Compound*>& identificationSet)
     // find average scan time
     _mavenParameters->setAverageScanTime();
 
+    // traces pulled by any stage of this run are shared through a cache
+    auto eicCache = _eicCacheForRun();
+
     MassSlicer massSlicer(_mavenParameters);
     massSlicer.findFeatureSlices();
 
@@ -376,6 +483,9 @@ void PeakDetector::processCompounds(vector<Compound*> compounds,
     sendBoostSignal("Preparing libraries for search…", 0, 0);
     string setName = "groups";
 
+    // traces pulled by any stage of this run are shared through a cache
+    auto eicCache = _eicCacheForRun();
+
     bool srmTransitionPresent = false;
     vector<Compound*> compoundsWithRawMzOnly;
     vector<Compound*> compoundsWithNeutralMassOnly;
@@ -538,6 +648,18 @@ void PeakDetector::processCompounds(vector<Compound*> compounds,
     }
 }
 
+shared_ptr<EICCache> PeakDetector::_eicCacheForRun()
+{
+    auto cache = _eicCache.lock();
+    if (cache == nullptr && _mavenParameters->eicCacheSize > 0) {
+        size_t memoryLimit = static_cast<size_t>(_mavenParameters->eicCacheSize)
+                             * 1024 * 1024;
+        cache = make_shared<EICCache>(memoryLimit);
+        _eicCache = cache;
+    }
+    return cache;
+}
+
 void PeakDetector::processSlices(vector<mzSlice*>& slices,
                                  string setName,
                                  bool applyGroupFilters,
@@ -548,48 +670,17 @@ void PeakDetector::processSlices(vector<mzSlice*>& slices,
 
     // shared `MavenParameters` object
     auto mp = make_shared<MavenParameters>(*_mavenParameters);
+    auto eicCache = _eicCache.lock();
 
-    // lambda that adds detected groups to mavenparameters
-    auto detectGroupsForSlice = [&](vector<EIC*>& eics, mzSlice* slice) {
-        vector<PeakGroup> peakgroups =
-            EIC::groupPeaks(eics,
-                            slice,
-                            mp,
-                            PeakGroup::IntegrationType::Automated);
-
-        // we do not filter non-parent adducts or non-parent isotopologues
-        bool isParentGroup = slice->adduct == nullptr
-                             || (slice->adduct->isParent()
-                                 && slice->isotope.isNone())
-                             || (slice->adduct->isParent()
-                                 && slice->isotope.isParent());
-        if (isParentGroup && applyGroupFilters) {
-            GroupFiltering groupFiltering(_mavenParameters, slice);
-            groupFiltering.filter(peakgroups);
-        }
-        if (peakgroups.empty())
-            return;
-
-        _mavenParameters->allgroups.insert(
-            _mavenParameters->allgroups.end(),
-            make_move_iterator(peakgroups.begin()),
-            make_move_iterator(peakgroups.end()));
-    };
-
-    if (!appendNewGroups)
-        _mavenParameters->allgroups.clear();
-
-    sort(slices.begin(), slices.end(), mzSlice::compIntensity);
-    for (unsigned int s = 0; s < slices.size(); s++) {
-        if (_mavenParameters->stop) {
-            _mavenParameters->allgroups.clear();
-            break;
-        }
-
-        mzSlice* slice = slices[s];
+    // lambda that detects and filters groups for a single slice; it only
+    // reads shared state, so that slices can be processed concurrently
+    auto detectGroupsForSlice = [&](mzSlice* slice) {
+        vector<PeakGroup> peakgroups;
         vector<EIC*> eics = pullEICs(slice,
                                      _mavenParameters->samples,
-                                     _mavenParameters);
+                                     _mavenParameters,
+                                     true,
+                                     eicCache.get());
 
         if (_mavenParameters->clsf->hasModel())
             _mavenParameters->clsf->scoreEICs(eics);
@@ -633,7 +724,7 @@ void PeakDetector::processSlices(vector<mzSlice*>& slices,
             && applyGroupFilters
             && eicMaxIntensity < _mavenParameters->minGroupIntensity) {
             delete_all(eics);
-            continue;
+            return peakgroups;
         }
 
         // TODO: maybe adducts should have their own filters?
@@ -642,17 +733,75 @@ void PeakDetector::processSlices(vector<mzSlice*>& slices,
         PeakFiltering peakFiltering(_mavenParameters, isIsotope);
         peakFiltering.filter(eics);
 
-        detectGroupsForSlice(eics, slice);
+        peakgroups = EIC::groupPeaks(eics,
+                                     slice,
+                                     mp,
+                                     PeakGroup::IntegrationType::Automated);
+
+        // we do not filter non-parent adducts or non-parent isotopologues
+        if (isParentGroup && applyGroupFilters) {
+            GroupFiltering groupFiltering(_mavenParameters, slice);
+            groupFiltering.filter(peakgroups);
+        }
 
         // cleanup
         delete_all(eics);
+        return peakgroups;
+    };
+
+    if (!appendNewGroups)
+        _mavenParameters->allgroups.clear();
+
+    sort(slices.begin(), slices.end(), mzSlice::compIntensity);
 
-        if (_mavenParameters->allgroups.size()
-            > _mavenParameters->limitGroupCount) {
-            cerr << "Group limit exceeded!" << endl;
+    // Slices are processed in batches. Within a batch, each thread picks up
+    // the next unprocessed slice as soon as it is done with its previous one
+    // (EICs of a slice are then pulled serially). Groups are merged in slice
+    // order after each batch, so that the result and the point at which the
+    // group limit is hit do not depend on thread scheduling.
+    int numThreads = omp_get_max_threads();
+    size_t batchSize = static_cast<size_t>(numThreads) * 16;
+
+    vector<vector<PeakGroup>> batchGroups(batchSize);
+    bool groupLimitExceeded = false;
+    for (size_t batchStart = 0;
+         batchStart < slices.size() && !groupLimitExceeded;
+         batchStart += batchSize) {
+        size_t batchEnd = std::min(slices.size(), batchStart + batchSize);
+        int batchLength = static_cast<int>(batchEnd - batchStart);
+
+        // with fewer slices than threads, parallelising over samples (within
+        // `pullEICs`) makes better use of the threads
+#pragma omp parallel for schedule(dynamic, 1) if (batchLength >= numThreads)
+        for (int i = 0; i < batchLength; i++) {
+            if (_mavenParameters->stop)
+                continue;
+            batchGroups[i] = detectGroupsForSlice(slices[batchStart + i]);
+        }
+
+        if (_mavenParameters->stop) {
+            _mavenParameters->allgroups.clear();
             break;
         }
 
+        size_t slicesDone = batchEnd;
+        for (int i = 0; i < batchLength; i++) {
+            vector<PeakGroup>& peakgroups = batchGroups[i];
+            _mavenParameters->allgroups.insert(
+                _mavenParameters->allgroups.end(),
+                make_move_iterator(peakgroups.begin()),
+                make_move_iterator(peakgroups.end()));
+            peakgroups.clear();
+
+            if (_mavenParameters->allgroups.size()
+                > _mavenParameters->limitGroupCount) {
+                cerr << "Group limit exceeded!" << endl;
+                groupLimitExceeded = true;
+                slicesDone = batchStart + i + 1;
+                break;
+            }
+        }
+
         if (_zeroStatus) {
             sendBoostSignal("Status", 0, 1);
             _zeroStatus = false;
@@ -662,7 +811,7 @@ void PeakDetector::processSlices(vector<mzSlice*>& slices,
             string progressText = "Finding "
                                   + setName;
             sendBoostSignal(progressText,
-                            s + 1,
+                            slicesDone,
                             std::min((int)slices.size(),
                                      _mavenParameters->limitGroupCount));
         }
@@ -1073,7 +1222,11 @@ void PeakDetector::detectIsotopesForParent(PeakGroup& parentGroup,
             if (slice->isotope.isParent())
                 continue;
 
-            auto eics = pullEICs(slice, visibleSamples, _mavenParameters);
+            auto eics = pullEICs(slice,
+                                 visibleSamples,
+                                 _mavenParameters,
+                                 true,
+                                 _eicCache.lock().get());
             auto isotopeGroup = integrateEicRegion(eics,
                                                    parentGroup.minRt,
                                                    parentGroup.maxRt,
@@ -1145,7 +1298,9 @@ void PeakDetector::linkParentIsotopeRange(PeakGroup& parentGroup,
     for (auto& child : isotopes) {
         auto eics = pullEICs(&child->getSlice(),
                              _mavenParameters->samples,
-                             _mavenParameters);
+                             _mavenParameters,
+                             true,
+                             _eicCache.lock().get());
         for (const auto& peak : parentGroup.peaks) {
             auto sample = peak.getSample();
             editPeakRegionForSample(child.get(),
@@ -1204,8 +1359,7 @@ PeakDetector::integrateEicRegion(const std::vector<EIC*>& eics,
     }
 
     integratedGroup->groupStatistics();
-    int ms2Events = integratedGroup->getFragmentationEvents().size();
-    if (ms2Events > 0) {
+    if (integratedGroup->fragmentationEventCount() > 0) {
         float ppm = parameters->fragmentTolerance;
         string scoringAlgo = parameters->scoringAlgo;
         integratedGroup->computeFragPattern(ppm);
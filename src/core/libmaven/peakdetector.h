@@ -1,11 +1,15 @@
 #ifndef PEAKDETECTOR_H
 #define PEAKDETECTOR_H
 
+#include <iosfwd>
+#include <memory>
+
 #include <boost/signals2.hpp>
 
 class Adduct;
 class Compound;
 class EIC;
+class EICCache;
 class MavenParameters;
 class mzSample;
 class mzSlice;
@@ -38,10 +42,47 @@ public:
         return *this;
     }
 
+    /**
+     * @brief Pull EICs for a slice from each of the given samples, with their
+     * baselines computed and peaks found.
+     * @param slice The m/z-rt region for which EICs will be pulled.
+     * @param samples Samples for which EICs will be pulled.
+     * @param mp Parameters for baseline estimation, smoothing and peak
+     * detection.
+     * @param filterUnselectedSamples Whether to skip samples that are not
+     * selected.
+     * @param cache An optional cache from which traces for slices in the
+     * m/z-rt domain are taken (and added to, if not present).
+     * @return A vector of EICs, owned by the caller. EICs are in the same
+     * order as their samples, regardless of the number of threads used.
+     */
     static std::vector<EIC*> pullEICs(const mzSlice* slice,
                                       const std::vector<mzSample*>& samples,
                                       const MavenParameters* mp,
-                                      bool filterUnselectedSamples = true);
+                                      bool filterUnselectedSamples = true,
+                                      EICCache* cache = nullptr);
+
+    /**
+     * @brief Compare the peaks found in EICs pulled with window-restricted
+     * baselines (see `MavenParameters::baselineWindowMode`) against those
+     * found by default, where the whole trace is extracted and the baseline
+     * is estimated once it has been reduced to the slice.
+     * @details For every slice and sample, each peak found by default is
+     * matched to the peak with the nearest apex (and then the nearest
+     * bounds) in the window-restricted EIC, using the padding set in `mp`.
+     * @param slices The slices for which EICs will be compared.
+     * @param samples Samples for which EICs will be pulled.
+     * @param mp Parameters used for pulling EICs.
+     * @param report Stream to which a CSV report is written, with one row
+     * per peak: the slice's m/z, sample name, apex RT, corrected peak area
+     * with either baseline and their relative difference.
+     * @return The largest relative difference in corrected area, where an
+     * unmatched peak counts as a difference of 1.
+     */
+    static float validateBaselineWindow(const std::vector<mzSlice*>& slices,
+                                        const std::vector<mzSample*>& samples,
+                                        const MavenParameters* mp,
+                                        std::ostream& report);
 
     /**
      * @brief Set the RT bounds of the peak, of the given peak-group, for the
@@ -168,6 +209,21 @@ public:
 private:
     MavenParameters* _mavenParameters;
     bool _zeroStatus;
+
+    /**
+     * @brief EICs pulled during the current detection run, shared by the
+     * detection of its groups and of their isotopes. The cache is owned by
+     * the outermost `processFeatures` or `processCompounds` call.
+     */
+    std::weak_ptr<EICCache> _eicCache;
+
+    /**
+     * @brief Get the EIC cache of the current run, creating one if no run is
+     * in progress.
+     * @return Shared pointer to the cache, or to nothing if caching has been
+     * disabled.
+     */
+    std::shared_ptr<EICCache> _eicCacheForRun();
 };
 
 #endif  // PEAKDETECTOR_H
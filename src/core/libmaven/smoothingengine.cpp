@@ -0,0 +1,187 @@
+#include <cmath>
+
+#include "doctest.h"
+#include "mzUtils.h"
+#include "SavGolSmoother.h"
+#include "smoothingengine.h"
+
+namespace mzUtils
+{
+    SmoothingEngine& SmoothingEngine::forCurrentThread()
+    {
+        static thread_local SmoothingEngine engine;
+        return engine;
+    }
+
+    void SmoothingEngine::savitzkyGolay(const float* input,
+                                       float* output,
+                                       int n,
+                                       int window,
+                                       int order)
+    {
+        const vector<float>& kernel = _savitzkyGolayKernel(window, order);
+        int kernelLen = kernel.size();
+
+        // points without a full window on both sides are left as they are
+        int first = window;
+        int last = n - window - 2;
+        for (int i = 0; i < n; i++)
+            output[i] = input[i];
+        if (last < first)
+            return;
+
+        // accumulate over the kernel in the outer loop, so that the inner
+        // one runs over contiguous outputs and each output sums its terms in
+        // the same order as a per-point loop would
+        int count = last - first + 1;
+        float* out = output + first;
+        for (int i = 0; i < count; i++)
+            out[i] = 0.0f;
+        for (int k = 0; k < kernelLen; k++) {
+            const float* in = input + k;
+            float coefficient = kernel[k];
+#pragma omp simd
+            for (int i = 0; i < count; i++)
+                out[i] += in[i] * coefficient;
+        }
+        for (int i = 0; i < count; i++) {
+            if (out[i] < 0)
+                out[i] = 0;
+        }
+    }
+
+    void SmoothingEngine::gaussian(float* data, int n, int window)
+    {
+        if (window <= 0 || n <= 1)
+            return;
+
+        float fcutr = 1.0 / window;
+        if (1.01 / fcutr > (float)n) {
+            // replace drastic smoothing by averaging
+            float sum = 0.0;
+            for (int i = 0; i < n; i++)
+                sum += data[i];
+            sum /= n;
+            for (int i = 0; i < n; i++)
+                data[i] = sum;
+            return;
+        }
+
+        const vector<float>& kernel = _gaussianKernel(window);
+        int kernelLen = kernel.size();
+        int mean = kernelLen / 2;
+        if (_scratch.size() < static_cast<size_t>(n))
+            _scratch.resize(n);
+        conv(kernelLen,
+             -mean,
+             kernel.data(),
+             n,
+             -mean,
+             data,
+             n,
+             -mean,
+             _scratch.data());
+        copy(begin(_scratch), begin(_scratch) + n, data);
+    }
+
+    void SmoothingEngine::movingAverage(const float* input,
+                                       float* output,
+                                       int n,
+                                       int window)
+    {
+        if (window <= 0)
+            return;
+
+        const vector<float>& kernel = _averageKernel(window);
+        conv(window, -window / 2, kernel.data(), n, 0, input, n, 0, output);
+    }
+
+    size_t SmoothingEngine::kernelCount() const
+    {
+        return _savitzkyGolayKernels.size() + _gaussianKernels.size()
+               + _averageKernels.size();
+    }
+
+    const vector<float>& SmoothingEngine::_savitzkyGolayKernel(int window,
+                                                               int order)
+    {
+        auto key = make_pair(window, order);
+        auto kernel = _savitzkyGolayKernels.find(key);
+        if (kernel != _savitzkyGolayKernels.end())
+            return kernel->second;
+
+        SavGolSmoother smoother(window, window, order);
+        return _savitzkyGolayKernels[key] = smoother.coefficients();
+    }
+
+    const vector<float>& SmoothingEngine::_gaussianKernel(int window)
+    {
+        // halfwidths of more than 100 samples are truncated
+        if (window > 100)
+            window = 100;
+
+        auto kernel = _gaussianKernels.find(window);
+        if (kernel != _gaussianKernels.end())
+            return kernel->second;
+
+        // span of 3, at width of 1.5*exp(-PI*1.5**2)=1/1174
+        float fcut = 1.0 / window;
+        int n = (int)(3.0 / fcut + 0.5);
+        n = 2 * n / 2 + 1;
+
+        // mean is the index of the zero in the smoothing wavelet
+        int mean = n / 2;
+        vector<float> s(n);
+        for (int i = 1; i <= n; i++) {
+            float r = i - mean - 1;
+            r = -r * r * fcut * fcut * 3.141;
+            s[i - 1] = exp(r);
+        }
+
+        // normalize to unit area, will preserve DC frequency at full
+        // amplitude. Frequency at fcut will be half amplitude
+        float sum = 0.0;
+        for (int i = 0; i < n; i++)
+            sum += s[i];
+        for (int i = 0; i < n; i++)
+            s[i] /= sum;
+
+        return _gaussianKernels[window] = s;
+    }
+
+    const vector<float>& SmoothingEngine::_averageKernel(int window)
+    {
+        auto kernel = _averageKernels.find(window);
+        if (kernel != _averageKernels.end())
+            return kernel->second;
+
+        return _averageKernels[window] = vector<float>(window, 1.0 / window);
+    }
+
+    TEST_CASE("Testing cached Savitzky-Golay smoothing")
+    {
+        vector<float> input = {10.002, 15.001, 22.002, 42.229, 28.992,
+                               11.09,  12.091, 33.082, 12.234, 43.998,
+                               5.12,   0.0,    18.5,   27.75,  31.0};
+        SmoothingEngine& engine = SmoothingEngine::forCurrentThread();
+        for (int window = 2; window <= 5; window++) {
+            SavGolSmoother smoother(window, window, 4);
+            vector<float> expected = smoother.Smooth(input);
+
+            vector<float> smoothed(input.size());
+            engine.savitzkyGolay(input.data(),
+                                 smoothed.data(),
+                                 input.size(),
+                                 window,
+                                 4);
+            REQUIRE(smoothed == expected);
+        }
+
+        // kernels are reused
+        size_t kernels = engine.kernelCount();
+        vector<float> smoothed(input.size());
+        engine.savitzkyGolay(
+            input.data(), smoothed.data(), input.size(), 3, 4);
+        REQUIRE(engine.kernelCount() == kernels);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef SMOOTHINGENGINE_H
+#define SMOOTHINGENGINE_H
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace mzUtils
+{
+    /**
+     * @brief Smoothing filters with cached kernels and reusable buffers.
+     *
+     * @details Filters of EICs are applied for every EIC of every sample of
+     * every slice, mostly with the same few window sizes. An engine keeps the
+     * kernels it has built, keyed by their parameters, along with a scratch
+     * buffer for the convolution output, so that smoothing a trace does not
+     * solve for filter coefficients or allocate memory once the engine has
+     * warmed up.
+     *
+     * The results are identical to those of `SavGolSmoother`,
+     * `gaussian1d_smoothing` and `smoothAverage`. An engine is not thread-safe,
+     * use the one returned by `forCurrentThread`.
+     */
+    class SmoothingEngine
+    {
+      public:
+        /**
+         * @brief The engine owned by the calling thread.
+         */
+        static SmoothingEngine& forCurrentThread();
+
+        /**
+         * @brief Savitzky-Golay filter with a window of `window` points on
+         * each side. The first `window` and last `window + 1` points are
+         * copied as they are and negative values are set to zero, as done by
+         * `SavGolSmoother::Smooth`.
+         * @param input Array of `n` values to be smoothed.
+         * @param output Array of `n` values, must not overlap `input`.
+         */
+        void savitzkyGolay(const float* input,
+                           float* output,
+                           int n,
+                           int window,
+                           int order);
+
+        /**
+         * @brief Gaussian smoothing of `n` values, in place. See
+         * `gaussian1d_smoothing` for the meaning of `window`.
+         */
+        void gaussian(float* data, int n, int window);
+
+        /**
+         * @brief Moving average of `n` values over `window` points.
+         * @param output Array of `n` values, must not overlap `input`.
+         */
+        void movingAverage(const float* input,
+                           float* output,
+                           int n,
+                           int window);
+
+        /**
+         * @brief Number of kernels held by the engine.
+         */
+        size_t kernelCount() const;
+
+      private:
+        const std::vector<float>& _savitzkyGolayKernel(int window, int order);
+        const std::vector<float>& _gaussianKernel(int window);
+        const std::vector<float>& _averageKernel(int window);
+
+        std::map<std::pair<int, int>, std::vector<float>> _savitzkyGolayKernels;
+        std::map<int, std::vector<float>> _gaussianKernels;
+        std::map<int, std::vector<float>> _averageKernels;
+        std::vector<float> _scratch;
+    };
+}
+
+#endif  // SMOOTHINGENGINE_H
@@ -24,4 +24,16 @@
 #include <cfloat>
 #include <memory>
 
+/**
+ * @brief Type in which the m/z values of scans and EICs are stored.
+ * @details Single precision unless El-MAVEN is built with MZ_DOUBLE defined
+ * (see .qmake.conf), in which case 64-bit m/z arrays keep their full
+ * precision. Intensities are always stored as float.
+ */
+#ifdef MZ_DOUBLE
+typedef double mzValue;
+#else
+typedef float mzValue;
+#endif
+
 #endif // STANDARDINCLUDES_H
@@ -0,0 +1,236 @@
+#include <cstring>
+
+#include "xmlelementreader.h"
+
+static bool isNameEnd(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '/'
+           || c == '>';
+}
+
+XMLElementReader::XMLElementReader(const string& filename, size_t chunkSize)
+    : _file(filename.c_str(), ios::in | ios::binary),
+      _chunkSize(chunkSize),
+      _bufferOffset(0),
+      _pos(0),
+      _tagStart(0),
+      _tagEnd(0)
+{
+}
+
+bool XMLElementReader::_ensure(size_t index)
+{
+    while (index >= _buffer.size()) {
+        if (!_file.is_open() || !_file.good())
+            return false;
+
+        size_t oldSize = _buffer.size();
+        _buffer.resize(oldSize + _chunkSize);
+        _file.read(&_buffer[oldSize], _chunkSize);
+        _buffer.resize(oldSize + _file.gcount());
+        if (_file.gcount() == 0)
+            return false;
+    }
+    return true;
+}
+
+size_t XMLElementReader::_find(char c, size_t from)
+{
+    while (true) {
+        size_t index = _buffer.find(c, from);
+        if (index != string::npos)
+            return index;
+
+        from = max(from, _buffer.size());
+        if (!_ensure(_buffer.size()))
+            return string::npos;
+    }
+}
+
+size_t XMLElementReader::_find(const char* str, size_t from)
+{
+    size_t length = strlen(str);
+    while (true) {
+        size_t index = _buffer.find(str, from);
+        if (index != string::npos)
+            return index;
+
+        // the string may straddle the end of the buffer
+        if (_buffer.size() >= length)
+            from = max(from, _buffer.size() - length + 1);
+        if (!_ensure(_buffer.size()))
+            return string::npos;
+    }
+}
+
+size_t XMLElementReader::_tagEndFrom(size_t tagStart)
+{
+    char quote = 0;
+    for (size_t i = tagStart + 1;; i++) {
+        if (!_ensure(i))
+            return string::npos;
+
+        char c = _buffer[i];
+        if (quote) {
+            if (c == quote)
+                quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            return i + 1;
+        }
+    }
+}
+
+string XMLElementReader::_tagNameAt(size_t tagStart, size_t& nameEnd)
+{
+    size_t nameStart = tagStart + 1;
+    if (_ensure(nameStart) && _buffer[nameStart] == '/')
+        nameStart++;
+
+    nameEnd = nameStart;
+    while (_ensure(nameEnd) && !isNameEnd(_buffer[nameEnd]))
+        nameEnd++;
+
+    return _buffer.substr(nameStart, nameEnd - nameStart);
+}
+
+size_t XMLElementReader::_skipSpecial(size_t tagStart)
+{
+    if (!_ensure(tagStart + 1))
+        return string::npos;
+
+    char c = _buffer[tagStart + 1];
+    if (c == '?') {
+        size_t end = _find("?>", tagStart + 2);
+        return end == string::npos ? end : end + 2;
+    }
+    if (c != '!')
+        return 0;
+
+    if (!_ensure(tagStart + 8))
+        return string::npos;
+
+    size_t end;
+    if (_buffer.compare(tagStart, 4, "<!--") == 0) {
+        end = _find("-->", tagStart + 4);
+        return end == string::npos ? end : end + 3;
+    }
+    if (_buffer.compare(tagStart, 9, "<![CDATA[") == 0) {
+        end = _find("]]>", tagStart + 9);
+        return end == string::npos ? end : end + 3;
+    }
+
+    // doctype and other declarations
+    return _tagEndFrom(tagStart);
+}
+
+bool XMLElementReader::findStartTag(const vector<string>& names, string& name)
+{
+    // drop what has been consumed, once it is worth moving the rest
+    if (_pos >= _chunkSize) {
+        _buffer.erase(0, _pos);
+        _bufferOffset += _pos;
+        _pos = 0;
+    }
+
+    while (true) {
+        size_t tagStart = _find('<', _pos);
+        if (tagStart == string::npos) {
+            _pos = _buffer.size();
+            return false;
+        }
+
+        size_t skipTo = _skipSpecial(tagStart);
+        if (skipTo == string::npos) {
+            _pos = _buffer.size();
+            return false;
+        }
+        if (skipTo > 0) {
+            _pos = skipTo;
+            continue;
+        }
+
+        size_t nameEnd;
+        string tagName = _tagNameAt(tagStart, nameEnd);
+        bool isEndTag = _buffer[tagStart + 1] == '/';
+        _pos = nameEnd;
+        if (isEndTag)
+            continue;
+
+        for (const auto& candidate : names) {
+            if (tagName != candidate)
+                continue;
+
+            size_t tagEnd = _tagEndFrom(tagStart);
+            if (tagEnd == string::npos) {
+                _pos = _buffer.size();
+                return false;
+            }
+
+            _tagName = tagName;
+            _tagStart = tagStart;
+            _tagEnd = tagEnd;
+            _pos = tagEnd;
+            name = tagName;
+            return true;
+        }
+    }
+}
+
+string XMLElementReader::startTag() const
+{
+    string tag = _buffer.substr(_tagStart, _tagEnd - _tagStart);
+    if (tag.size() >= 2 && tag[tag.size() - 2] != '/')
+        tag.insert(tag.size() - 1, "/");
+    return tag;
+}
+
+bool XMLElementReader::readElement(string& element)
+{
+    // empty element
+    if (_buffer[_tagEnd - 2] == '/') {
+        element = _buffer.substr(_tagStart, _tagEnd - _tagStart);
+        _pos = _tagEnd;
+        return true;
+    }
+
+    int depth = 1;
+    size_t pos = _tagEnd;
+    while (depth > 0) {
+        size_t tagStart = _find('<', pos);
+        if (tagStart == string::npos)
+            return false;
+
+        size_t skipTo = _skipSpecial(tagStart);
+        if (skipTo == string::npos)
+            return false;
+        if (skipTo > 0) {
+            pos = skipTo;
+            continue;
+        }
+
+        size_t nameEnd;
+        string tagName = _tagNameAt(tagStart, nameEnd);
+        bool isEndTag = _buffer[tagStart + 1] == '/';
+        if (tagName != _tagName) {
+            pos = nameEnd;
+            continue;
+        }
+
+        size_t tagEnd = _tagEndFrom(tagStart);
+        if (tagEnd == string::npos)
+            return false;
+
+        if (isEndTag) {
+            depth--;
+        } else if (_buffer[tagEnd - 2] != '/') {
+            depth++;
+        }
+        pos = tagEnd;
+    }
+
+    element = _buffer.substr(_tagStart, pos - _tagStart);
+    _pos = pos;
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef XMLELEMENTREADER_H
+#define XMLELEMENTREADER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Forward-only reader that pulls single elements out of an XML file.
+ *
+ * @details Large mass spectrometry files (mzML, mzXML, mzData) consist of a
+ * small header followed by thousands of independent spectrum elements.
+ * Instead of loading the whole document into memory, this reader scans the
+ * file in fixed size chunks for start tags of interest and returns the
+ * complete text of one element at a time, which can then be parsed on its
+ * own (e.g., with pugixml). Only the chunk being scanned and the element
+ * being read are kept in memory.
+ *
+ * The reader does not validate the document. Comments and CDATA sections
+ * are skipped while looking for tags.
+ */
+class XMLElementReader
+{
+  public:
+    /**
+     * @brief Open a file for reading.
+     * @param filename Path of the XML file.
+     * @param chunkSize Number of bytes read from the file at a time.
+     */
+    XMLElementReader(const string& filename, size_t chunkSize = 1 << 22);
+
+    /**
+     * @brief Check whether the file could be opened.
+     */
+    bool isOpen() const { return _file.is_open(); }
+
+    /**
+     * @brief Advance to the next start tag that has one of the given names.
+     * @param names Tag names to look for.
+     * @param name Set to the name of the tag that was found.
+     * @return True if a tag was found, false at the end of the file.
+     */
+    bool findStartTag(const vector<string>& names, string& name);
+
+    /**
+     * @brief Text of the start tag found last, including its attributes.
+     * @details The text is always returned as an empty element
+     * (i.e., ending with "/>"), so that it can be parsed on its own.
+     */
+    string startTag() const;
+
+    /**
+     * @brief Read the element whose start tag was found last.
+     * @details Elements nested within it, including ones of the same name,
+     * are part of the returned text. Reading continues after its end tag.
+     * @param element Set to the complete text of the element.
+     * @return False if the file ended before the element was closed.
+     */
+    bool readElement(string& element);
+
+    /**
+     * @brief Position in the file of the start tag found last.
+     * @return Byte offset of its '<' from the beginning of the file.
+     */
+    long long tagOffset() const { return _bufferOffset + _tagStart; }
+
+  private:
+    ifstream _file;
+    size_t _chunkSize;
+    string _buffer;
+    long long _bufferOffset;
+    size_t _pos;
+
+    string _tagName;
+    size_t _tagStart;
+    size_t _tagEnd;
+
+    /**
+     * @brief Make sure that the buffer holds the byte at given index,
+     * reading more of the file if needed.
+     * @return False if the file ends before that index.
+     */
+    bool _ensure(size_t index);
+
+    /**
+     * @brief Find a character in the buffer, reading more of the file if
+     * needed.
+     * @return Index of the character, or string::npos at end of file.
+     */
+    size_t _find(char c, size_t from);
+
+    /**
+     * @brief Find a string in the buffer, reading more of the file if needed.
+     * @return Index of the string, or string::npos at end of file.
+     */
+    size_t _find(const char* str, size_t from);
+
+    /**
+     * @brief Find the end of a tag starting at the given '<', skipping over
+     * quoted attribute values.
+     * @return Index one past the closing '>', or string::npos at end of file.
+     */
+    size_t _tagEndFrom(size_t tagStart);
+
+    /**
+     * @brief Read the name of a tag whose '<' is at the given index.
+     * @param nameEnd Set to the index one past the name.
+     * @return The tag name (without a leading '/' for end tags).
+     */
+    string _tagNameAt(size_t tagStart, size_t& nameEnd);
+
+    /**
+     * @brief If a comment, CDATA section or processing instruction starts at
+     * the given '<', find where it ends.
+     * @return Index one past its end, 0 if there is none at this position, or
+     * string::npos at end of file.
+     */
+    size_t _skipSpecial(size_t tagStart);
+};
+
+#endif  // XMLELEMENTREADER_H
@@ -202,7 +202,9 @@ void BackgroundOpsThread::alignWithObiWarp()
         0.0f,
         mainwindow->alignmentDialog->responseObiWarp->value(),
         false,
-        mainwindow->alignmentDialog->binSizeObiWarp->value());
+        mainwindow->alignmentDialog->binSizeObiWarp->value(),
+        mavenParameters->obiWarpDropEmptyColumns,
+        mavenParameters->obiWarpMaxRtShift);
 
     emit updateProgressBar("Aligning samples…", 0, 100);
 
@@ -3821,6 +3821,7 @@ void MainWindow::UndoAlignment()
 		for(auto scan : sample->scans)
 			if(scan->originalRt >= 0)
 				scan->rt = scan->originalRt;
+		sample->retentionTimesUpdated();
 	}
 
 	getEicWidget()->replotForced();
@@ -4040,8 +4041,8 @@ bool MainWindow::checkCompoundExistance(Compound* c) {
 	for (unsigned int i = 0; i < samples.size(); i++) {
 		int consectveMatches = 0;
 		for (unsigned int j = 0; j < samples[i]->scans.size(); j++) {
-			vector<int> matches = samples[i]->scans[j]->findMatchingMzs(mzmin,
-					mzmax);
+			auto scan = samples[i]->loadScanData(samples[i]->scans[j]);
+			vector<int> matches = scan->findMatchingMzs(mzmin, mzmax);
 			if (matches.size() > 0) {
 				consectveMatches++;
 			} else
@@ -4328,7 +4329,8 @@ void MainWindow::getLinks(Peak* peak) {
 	MassCutoff *massCutoff = getUserMassCutoff();
 
 	vector<mzLink> links = peak->findCovariants();
-	vector<mzLink> linksX = SpectraWidget::findLinks(peak->peakMz, scan, massCutoff,
+	vector<mzLink> linksX = SpectraWidget::findLinks(peak->peakMz,
+			sample->loadScanData(scan).get(), massCutoff,
 			ionizationMode);
 	for (int i = 0; i < linksX.size(); i++)
 		links.push_back(linksX[i]);
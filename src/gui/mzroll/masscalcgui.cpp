@@ -6,6 +6,7 @@
 #include "masscalcgui.h"
 #include "masscutofftype.h"
 #include "mavenparameters.h"
+#include "mzSample.h"
 #include "Scan.h"
 #include "spectrawidget.h"
 #include "mzSample.h"
@@ -217,7 +218,10 @@ void MassCalcWidget::setFragmentationScan(Scan* scan) {
     if (_currentScan)
         delete _currentScan;
     _currentScan = new Scan(nullptr, -1, 1, 0.0f, 0.0f, -1);
-    _currentScan->deepcopy(scan);
+    if (scan->getSample())
+        _currentScan->deepcopy(scan->getSample()->loadScanData(scan).get());
+    else
+        _currentScan->deepcopy(scan);
 
     Fragment f(scan, 0, 0, 1024);
     _mz = scan->precursorMz;
@@ -251,7 +251,7 @@ void PeakEditor::_applyEdits()
 {
     _setBusyState();
 
-    MavenParameters* mp = _group->parameters().get();
+    MavenParameters* mp = _group->mutableParameters();
     if (ui->baselineTabWidget->currentIndex() == 0) {
         mp->aslsBaselineMode = false;
         mp->baseline_dropTopX = ui->dropTopSpinBox->value();
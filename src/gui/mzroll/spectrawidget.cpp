@@ -94,7 +94,10 @@ void SpectraWidget::setCurrentScan(Scan* scan)
         links.clear();
         chargeStates.clear();
         peakClusters.clear();
-        _currentScan->deepcopy(scan);
+        if (scan->getSample())
+            _currentScan->deepcopy(scan->getSample()->loadScanData(scan).get());
+        else
+            _currentScan->deepcopy(scan);
         _scanset.clear();
 
         if (scan->mslevel == 1) {
@@ -502,7 +505,7 @@ void SpectraWidget::setGroupTitle()
     mainwindow->fragSpectraDockWidget->setWindowTitle("Fragmentation spectra: " + compoundName);
 }
 
-void SpectraWidget::drawScan(Scan* scan, QColor sampleColor)
+void SpectraWidget::drawScan(const Scan* scan, QColor sampleColor)
 {
     float _focusedMz = _focusCoord.x();
 
@@ -577,8 +580,10 @@ void SpectraWidget::drawScanSet(vector<Scan*>& scanset) {
         if (scanset[i]->sample) {
             mzSample* sample = scanset[i]->sample;
             sampleColor = QColor::fromRgbF( sample->color[0], sample->color[1], sample->color[2], 0.6 );
+            drawScan(sample->loadScanData(scanset[i]).get(), sampleColor);
+        } else {
+            drawScan(scanset[i],sampleColor);
         }
-        drawScan(scanset[i],sampleColor);
      }
 }
 
@@ -1272,7 +1277,7 @@ void SpectraWidget::gotoScan()
 		}
 }
 
-vector<mzLink> SpectraWidget::findLinks(float centerMz, Scan* scan, MassCutoff *massCutoff, int ionizationMode)
+vector<mzLink> SpectraWidget::findLinks(float centerMz, const Scan* scan, MassCutoff *massCutoff, int ionizationMode)
 {
     vector<mzLink> links;
     //check for possible C13s
@@ -25,7 +25,7 @@ public:
     };
 
     SpectraWidget(MainWindow* mw, bool isFragSpectra = false);
-    static vector<mzLink> findLinks(float centerMz, Scan* scan, MassCutoff *massCutoff, int ionizationMode);
+    static vector<mzLink> findLinks(float centerMz, const Scan* scan, MassCutoff *massCutoff, int ionizationMode);
 
         public Q_SLOTS:
                     void setScan(Scan* s);
@@ -73,7 +73,7 @@ public:
                     void assignCharges(); //TODO: Sahil, Added while merging spectrawidget
 
                     void drawScanSet(vector<Scan*>& scanset); //TODO: Sahil, Added while merging spectrawidget
-                    void drawScan(Scan* scan, QColor sampleColor);
+                    void drawScan(const Scan* scan, QColor sampleColor);
                     void drawMzLabels(Scan *scan); //TODO: Sahil, Added while merging spectrawidget
                     void drawAnnotations(); //TODO: Sahil, Added while merging spectrawidget
                     void clearScans();
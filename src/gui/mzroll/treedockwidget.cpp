@@ -293,7 +293,10 @@ void TreeDockWidget::addScanItem(Scan* scan) {
         item->setText(2, QString::number(scan->rt));
         item->setText(3,QString::number(scan->getPrecursorPurity(20.00),'g',3));
         item->setText(4,QString::number(scan->totalIntensity(),'g',3));
-        item->setText(5,QString::number(scan->nobs()));
+        if (scan->sample)
+            item->setText(5,QString::number(scan->sample->loadScanData(scan)->nobs()));
+        else
+            item->setText(5,QString::number(scan->nobs()));
 }
 
 void TreeDockWidget::sortScansBySample()
@@ -489,8 +489,9 @@ void ProjectDatabase::saveGroupPeaks(PeakGroup* group,
 
         // spectrum at peak apex
         if (_saveRawData) {
-            Scan* scan = p.getSample()->getScan(p.scan);
-            if (scan != nullptr) {
+            Scan* header = p.getSample()->getScan(p.scan);
+            if (header != nullptr) {
+                auto scan = p.getSample()->loadScanData(header);
                 stringstream mzs;
                 stringstream ins;
                 mzs << setprecision(6) << fixed;
@@ -717,12 +718,15 @@ void ProjectDatabase::saveScans(const vector<mzSample*>& sampleSet)
             if (scan->mslevel == 1)
                 continue;
 
-            string scanData = _getScanSignature(scan, 2000);
+            string scanData = _getScanSignature(s->loadScanData(scan).get(),
+                                                2000);
 
             scansQuery->bind(":sample_id", s->getSampleId());
             scansQuery->bind(":scan", scan->scannum);
-            scansQuery->bind(":file_seek_start", -1);
-            scansQuery->bind(":file_seek_end", -1);
+            scansQuery->bind(":file_seek_start",
+                             static_cast<long>(scan->fileSeekStart));
+            scansQuery->bind(":file_seek_end",
+                             static_cast<long>(scan->fileSeekEnd));
             scansQuery->bind(":mslevel", scan->mslevel);
             scansQuery->bind(":rt", scan->rt);
             scansQuery->bind(":precursor_mz", scan->precursorMz);
@@ -1503,7 +1507,8 @@ void ProjectDatabase::loadAndPerformAlignment(const vector<mzSample*>& loaded)
 
     Aligner aligner;
     aligner.setSamples(loaded);
-    AlignmentSegment* lastSegment = nullptr;
+    map<string, vector<AlignmentSegment>> alignmentSegments;
+    string lastSampleName;
     int segCount = 0;
 
     while (alignmentQuery->next()) {
@@ -1517,7 +1522,7 @@ void ProjectDatabase::loadAndPerformAlignment(const vector<mzSample*>& loaded)
         int scannum = alignmentQuery->integerValue("scannum");
         if (scannum != -1) {
             // perform regular alignment
-            auto scanMap = sampleScanMap[sampleId];
+            auto& scanMap = sampleScanMap[sampleId];
             if (!scanMap.count(scannum)) {
                 cerr << "Error: no scan with scannum " << sampleId << endl;
                 continue;
@@ -1529,26 +1534,29 @@ void ProjectDatabase::loadAndPerformAlignment(const vector<mzSample*>& loaded)
         } else {
             // perform segmented alignment
             segCount++;
-            AlignmentSegment* seg = new AlignmentSegment();
-            seg->sampleName = sampleName;
-            seg->segStart = 0;
-            seg->segEnd   = alignmentQuery->floatValue("rt_original");
-            seg->newStart = 0;
-            seg->newEnd   = alignmentQuery->floatValue("rt_updated");
-
-            if (lastSegment and lastSegment->sampleName == seg->sampleName) {
-                seg->segStart = lastSegment->segEnd;
-                seg->newStart = lastSegment->newEnd;
+            AlignmentSegment seg;
+            seg.sampleName = sampleName;
+            seg.segStart = 0;
+            seg.segEnd   = alignmentQuery->floatValue("rt_original");
+            seg.newStart = 0;
+            seg.newEnd   = alignmentQuery->floatValue("rt_updated");
+
+            auto& segments = alignmentSegments[sampleName];
+            if (lastSampleName == sampleName && !segments.empty()) {
+                seg.segStart = segments.back().segEnd;
+                seg.newStart = segments.back().newEnd;
             }
-            auto alignmentSegments = aligner.alignmentSegments();
-            aligner.addSegment(sampleName, *seg, alignmentSegments);
-            lastSegment = seg;
-            aligner.setAlignmentSegment(alignmentSegments);
+            segments.push_back(seg);
+            lastSampleName = sampleName;
         }
     }
+    aligner.setAlignmentSegment(alignmentSegments);
 
     if (segCount > 0)
         aligner.performSegmentedAlignment();
+
+    for (auto sample : loaded)
+        sample->retentionTimesUpdated();
 }
 
 string _nextSettingsRow(Cursor* settingsQuery,
@@ -2257,7 +2265,7 @@ bool ProjectDatabase::_compoundDatabaseLoaded(string databaseName)
     return false;
 }
 
-string ProjectDatabase::_getScanSignature(Scan* scan, int limitSize)
+string ProjectDatabase::_getScanSignature(const Scan* scan, int limitSize)
 {
     stringstream signature;
     map<int, bool> seen;
@@ -515,7 +515,7 @@ private:
      * @param limitSize A limiting number on the length of the scan signature.
      * @return A scan signature of the Scan as a string.
      */
-    string _getScanSignature(Scan* scan, int limitSize);
+    string _getScanSignature(const Scan* scan, int limitSize);
 
     /**
      * @brief Find a given sample within one of the possible paths.
@@ -1,6 +1,7 @@
 #include "testEIC.h"
 #include "datastructures/mzSlice.h"
 #include "EIC.h"
+#include "eiccache.h"
 #include "masscutofftype.h"
 #include "mavenparameters.h"
 #include "mzMassCalculator.h"
@@ -62,6 +63,85 @@ void TestEIC::testgetEICms2() {
     QVERIFY(e3->maxIntensity == 2500);
 }
 
+void TestEIC::testgetEICFromSpectrumStore() {
+    mzSample* mzsample = maventests::samples.ms1TestSamples[0];
+
+    EIC* e = mzsample->getEIC(402.9929f, 402.9969f, 12.0, 16.0, 1, 0, "");
+    mzsample->buildSpectrumStore();
+    EIC* storeEic = mzsample->getEIC(402.9929f, 402.9969f, 12.0, 16.0, 1, 0, "");
+    mzsample->releaseSpectrumStore();
+
+    QVERIFY(storeEic->size() == e->size());
+    QVERIFY(storeEic->scannum == e->scannum);
+    QVERIFY(storeEic->rt == e->rt);
+    QVERIFY(storeEic->mz == e->mz);
+    QVERIFY(storeEic->intensity == e->intensity);
+    QVERIFY(storeEic->maxIntensity == e->maxIntensity);
+
+    delete e;
+    delete storeEic;
+}
+
+void TestEIC::testEICCache() {
+    mzSample* mzsample = maventests::samples.ms1TestSamples[0];
+
+    EIC* e = mzsample->getEIC(402.9929f, 402.9969f, 12.0, 16.0, 1, 0, "");
+    EICCache cache(1024 * 1024);
+    EIC* first = cache.getEIC(mzsample, 402.9929f, 402.9969f, 12.0, 16.0, 1, 0, "");
+    EIC* second = cache.getEIC(mzsample, 402.9929f, 402.9969f, 12.0, 16.0, 1, 0, "");
+    QVERIFY(cache.misses() == 1);
+    QVERIFY(cache.hits() == 1);
+    QVERIFY(cache.size() == 1);
+    QVERIFY(second != first);
+    QVERIFY(second->scannum == e->scannum);
+    QVERIFY(second->rt == e->rt);
+    QVERIFY(second->mz == e->mz);
+    QVERIFY(second->intensity == e->intensity);
+    QVERIFY(second->maxIntensity == e->maxIntensity);
+
+    // a different window or EIC type is a different entry
+    delete cache.getEIC(mzsample, 402.9929f, 402.9969f, 12.0, 16.0, 1, 1, "");
+    QVERIFY(cache.misses() == 2);
+    QVERIFY(cache.size() == 2);
+
+    // least recently used traces are evicted once over the memory limit
+    EICCache smallCache(cache.memoryUsage() / 2 + 1);
+    delete smallCache.getEIC(mzsample, 402.9929f, 402.9969f, 12.0, 16.0, 1, 0, "");
+    delete smallCache.getEIC(mzsample, 402.9929f, 402.9969f, 12.0, 16.0, 1, 1, "");
+    QVERIFY(smallCache.size() == 1);
+    QVERIFY(smallCache.evictions() == 1);
+    QVERIFY(smallCache.memoryUsage() <= smallCache.memoryLimit());
+
+    delete e;
+    delete first;
+    delete second;
+}
+
+void TestEIC::testgetEICMaximum() {
+    mzSample* mzsample = maventests::samples.ms1TestSamples[0];
+
+    for (int eicType = 0; eicType < 2; ++eicType) {
+        EIC* e = mzsample->getEIC(402.9929f, 402.9969f, 12.0, 16.0, 1, eicType, "");
+        float maxIntensity, rtAtMax;
+        mzValue mzAtMax;
+        mzsample->getEICMaximum(402.9929f, 402.9969f, 12.0, 16.0, 1, eicType, "",
+                                maxIntensity, rtAtMax, mzAtMax);
+        QVERIFY(maxIntensity > 0.0f);
+        QVERIFY(maxIntensity == e->maxIntensity);
+        QVERIFY(rtAtMax == e->rtAtMaxIntensity);
+        QVERIFY(mzAtMax == e->mzAtMaxIntensity);
+
+        mzsample->buildSpectrumStore();
+        mzsample->getEICMaximum(402.9929f, 402.9969f, 12.0, 16.0, 1, eicType, "",
+                                maxIntensity, rtAtMax, mzAtMax);
+        mzsample->releaseSpectrumStore();
+        QVERIFY(maxIntensity == e->maxIntensity);
+        QVERIFY(rtAtMax == e->rtAtMaxIntensity);
+        QVERIFY(mzAtMax == e->mzAtMaxIntensity);
+        delete e;
+    }
+}
+
 void TestEIC::testcomputeSpline()
 {
     EIC* e = maventests::samples.ms1TestSamples[0]->getEIC(402.9929f,
@@ -25,6 +25,9 @@ class TestEIC : public QObject {
         // this is automatically detected thanks to Qt's meta-information about QObjects
         void testgetEIC();
         void testgetEICms2();
+        void testgetEICFromSpectrumStore();
+        void testEICCache();
+        void testgetEICMaximum();
         void testcomputeSpline();
         void testgetPeakPositions();
         void testcomputeBaselineThreshold();
@@ -2,7 +2,14 @@
 #include "mavenparameters.h"
 #include "mzSample.h"
 #include "Scan.h"
+#include "base64.h"
+#include "EIC.h"
+#include "datastructures/mzSlice.h"
 #include "utilities.h"
+#include "xmlelementreader.h"
+
+#include <fstream>
+#include <QTemporaryDir>
 
 TestLoadSamples::TestLoadSamples() {
     loadFile = "bin/methods/testsample_1.mzxml";
@@ -99,6 +106,241 @@ void TestLoadSamples:: testSrmScan() {
     QVERIFY(k == numberOfScans);
 }
 
+void TestLoadSamples:: testScanIndex() {
+    mzSample mzsample;
+    mzsample.loadSample(loadFile);
+
+    const vector<Scan*>& ms1Scans = mzsample.scansAtMsLevel(1);
+    QVERIFY(ms1Scans.size() == mzsample.ms1ScanCount());
+    QVERIFY(mzsample.scansAtMsLevel(2).size() == mzsample.ms2ScanCount());
+    QVERIFY(mzsample.scansAtMsLevel(3).empty());
+
+    for (unsigned int i = 0; i < ms1Scans.size(); i++) {
+        QVERIFY(ms1Scans[i]->mslevel == 1);
+        QVERIFY(mzsample.getScan(ms1Scans[i]->scannum) == ms1Scans[i]);
+        if (i > 0)
+            QVERIFY(ms1Scans[i - 1]->rt <= ms1Scans[i]->rt);
+    }
+}
+
+void TestLoadSamples:: testLazyScanLoading() {
+    mzSample eagerSample;
+    eagerSample.loadSample(loadFile);
+
+    mzSample::setLazyScanLoading(true);
+    mzSample::setScanCacheSize(1);
+    mzSample lazySample;
+    lazySample.loadSample(loadFile);
+    mzSample::setLazyScanLoading(false);
+    mzSample::setScanCacheSize(64);
+
+    QVERIFY(lazySample.hasLazyScans());
+    QVERIFY(lazySample.scans.size() == eagerSample.scans.size());
+
+    //bounds read from the headers of indexed files may be wider
+    QVERIFY(lazySample.minMz <= eagerSample.minMz);
+    QVERIFY(lazySample.maxMz >= eagerSample.maxMz);
+
+    //scans only keep their headers, peaks are read into shared copies
+    auto firstScanData = lazySample.loadScanData(lazySample.scans[0]);
+    for (unsigned int i = 0; i < lazySample.scans.size(); i++) {
+        Scan* lazyScan = lazySample.scans[i];
+        Scan* eagerScan = eagerSample.scans[i];
+        QVERIFY(lazyScan->fileSeekStart >= 0);
+        QVERIFY(lazyScan->fileSeekEnd > lazyScan->fileSeekStart);
+        QVERIFY(lazyScan->rt == eagerScan->rt);
+        QVERIFY(lazyScan->precursorMz == eagerScan->precursorMz);
+        QVERIFY(lazyScan->mz.empty());
+        QVERIFY(lazyScan->hasSummary());
+        QVERIFY(lazyScan->minMz() <= eagerScan->minMz());
+        QVERIFY(lazyScan->maxMz() >= eagerScan->maxMz());
+
+        auto scanData = lazySample.loadScanData(lazyScan);
+        QVERIFY(scanData.get() != lazyScan);
+        QVERIFY(scanData->mz == eagerScan->mz);
+        QVERIFY(scanData->intensity == eagerScan->intensity);
+    }
+
+    //copies evicted from the cache stay valid while they are held
+    QVERIFY(firstScanData->mz == eagerSample.scans[0]->mz);
+    QVERIFY(firstScanData->intensity == eagerSample.scans[0]->intensity);
+
+    EIC* eagerEic = eagerSample.getEIC(150.0f, 150.1f, 0.0f, 10.0f, 1, 0, "");
+    EIC* lazyEic = lazySample.getEIC(150.0f, 150.1f, 0.0f, 10.0f, 1, 0, "");
+    QVERIFY(lazyEic->intensity == eagerEic->intensity);
+    delete eagerEic;
+    delete lazyEic;
+}
+
+void TestLoadSamples:: testSpectrumStore() {
+    mzSample eagerSample;
+    eagerSample.loadSample(loadFile);
+
+    mzSample::setUseSpectrumStore(true);
+    mzSample storeSample;
+    storeSample.loadSample(loadFile);
+    mzSample::setUseSpectrumStore(false);
+
+    //peaks are only kept in the store, and scans view their rows
+    QVERIFY(storeSample.hasSpectrumStore());
+    QVERIFY(!storeSample.hasLazyScans());
+    for (unsigned int i = 0; i < storeSample.scans.size(); i++) {
+        Scan* storeScan = storeSample.scans[i];
+        Scan* eagerScan = eagerSample.scans[i];
+        QVERIFY(storeScan->mz.isView() || storeScan->mz.empty());
+        QVERIFY(storeScan->mz == eagerScan->mz);
+        QVERIFY(storeScan->intensity == eagerScan->intensity);
+    }
+
+    //chromatograms are read from the store columns
+    EIC* eagerTic = eagerSample.getTIC(0, 0, 1);
+    EIC* storeTic = storeSample.getTIC(0, 0, 1);
+    QVERIFY(storeTic->scannum == eagerTic->scannum);
+    QVERIFY(storeTic->rt == eagerTic->rt);
+    QVERIFY(storeTic->intensity == eagerTic->intensity);
+    EIC* eagerBic = eagerSample.getBIC(0, 0, 1);
+    EIC* storeBic = storeSample.getBIC(0, 0, 1);
+    QVERIFY(storeBic->intensity == eagerBic->intensity);
+    QVERIFY(storeBic->mz == eagerBic->mz);
+
+    //releasing the store gives the scans their own copy of the peaks
+    storeSample.releaseSpectrumStore();
+    QVERIFY(!storeSample.hasSpectrumStore());
+    for (unsigned int i = 0; i < storeSample.scans.size(); i++) {
+        QVERIFY(!storeSample.scans[i]->mz.isView());
+        QVERIFY(storeSample.scans[i]->mz == eagerSample.scans[i]->mz);
+        QVERIFY(storeSample.scans[i]->intensity
+                == eagerSample.scans[i]->intensity);
+    }
+
+    delete eagerTic;
+    delete storeTic;
+    delete eagerBic;
+    delete storeBic;
+}
+
+void TestLoadSamples:: testIonChromatograms() {
+    mzSample mzsample;
+    mzsample.loadSample(loadFile);
+
+    const vector<Scan*>& ms1Scans = mzsample.scansAtMsLevel(1);
+    EIC* tic = mzsample.getTIC(0, 0, 1);
+    EIC* bic = mzsample.getBIC(0, 0, 1);
+    QVERIFY(tic->size() == ms1Scans.size());
+    QVERIFY(bic->size() == ms1Scans.size());
+    for (unsigned int i = 0; i < ms1Scans.size(); i++) {
+        Scan* scan = ms1Scans[i];
+        double sum = 0;
+        float highest = 0;
+        for (auto intensity : scan->intensity) {
+            sum += intensity;
+            highest = max(highest, intensity);
+        }
+        QVERIFY(tic->scannum[i] == scan->scannum);
+        QVERIFY(TestUtils::floatCompare(tic->intensity[i], sum));
+        QVERIFY(bic->intensity[i] == highest);
+    }
+
+    //rt ranges are answered with the scans inside them
+    float rtmin = ms1Scans[ms1Scans.size() / 4]->rt;
+    float rtmax = ms1Scans[ms1Scans.size() / 2]->rt;
+    EIC* ticSlice = mzsample.getTIC(rtmin, rtmax, 1);
+    QVERIFY(ticSlice->size() > 0);
+    QVERIFY(ticSlice->size() < tic->size());
+    QVERIFY(ticSlice->rt.front() >= rtmin);
+    QVERIFY(ticSlice->rt.back() <= rtmax);
+
+    //rewritten retention times are picked up
+    for (auto scan : mzsample.scans)
+        scan->rt += 1.0f;
+    mzsample.retentionTimesUpdated();
+    EIC* shiftedTic = mzsample.getTIC(0, 0, 1);
+    QVERIFY(shiftedTic->rt.front() == tic->rt.front() + 1.0f);
+    QVERIFY(shiftedTic->intensity == tic->intensity);
+
+    delete tic;
+    delete bic;
+    delete ticSlice;
+    delete shiftedTic;
+}
+
+void TestLoadSamples:: testFragmentationEvents() {
+    mzSample mzsample;
+    mzsample.loadSample("bin/methods/ms2test1.mzML");
+
+    const vector<Scan*>& ms2Scans = mzsample.scansAtMsLevel(2);
+    QVERIFY(ms2Scans.size() > 0);
+
+    //windows around some of the precursors match a linear search
+    auto linearSearch = [&](mzSlice& slice) {
+        vector<Scan*> matches;
+        for (auto scan : ms2Scans) {
+            if (scan->rt >= slice.rtmin && scan->rt <= slice.rtmax
+                && scan->precursorMz >= slice.mzmin
+                && scan->precursorMz <= slice.mzmax)
+                matches.push_back(scan);
+        }
+        return matches;
+    };
+    size_t found = 0;
+    for (size_t i = 0; i < ms2Scans.size(); i += 1 + ms2Scans.size() / 20) {
+        Scan* scan = ms2Scans[i];
+        mzSlice slice(scan->precursorMz - 0.5,
+                      scan->precursorMz + 0.5,
+                      scan->rt - 0.5f,
+                      scan->rt + 0.5f);
+        vector<Scan*> events = mzsample.getFragmentationEvents(&slice);
+        QVERIFY(events == linearSearch(slice));
+        QVERIFY(find(events.begin(), events.end(), scan) != events.end());
+        QVERIFY(mzsample.countFragmentationEvents(&slice) == events.size());
+        found += events.size();
+    }
+    QVERIFY(found > 0);
+
+    //rewritten retention times are picked up
+    Scan* first = ms2Scans.front();
+    mzSlice slice(first->precursorMz - 0.001,
+                  first->precursorMz + 0.001,
+                  first->rt + 99.0f,
+                  first->rt + 101.0f);
+    QVERIFY(mzsample.getFragmentationEvents(&slice).empty());
+    for (auto scan : mzsample.scans)
+        scan->rt += 100.0f;
+    mzsample.retentionTimesUpdated();
+    vector<Scan*> shifted = mzsample.getFragmentationEvents(&slice);
+    QVERIFY(find(shifted.begin(), shifted.end(), first) != shifted.end());
+}
+
+void TestLoadSamples:: testMzPrecision() {
+    // m/z values are stored as mzValue (double when built with MZ_DOUBLE),
+    // so 64-bit m/z arrays keep the precision of the build
+    const double values[] = {1234.5678912345, 70.0663604736328, 2311.00512695312};
+    string b64String = "c59HhUVKk0D///8/P4RRQPX//58CDqJA";
+    vector<mzValue> mzs;
+    base64::decodeBase64(b64String.c_str(),
+                         b64String.size(),
+                         8,
+                         false,
+                         false,
+                         mzs);
+    QVERIFY(mzs.size() == 3);
+
+    Scan scan(nullptr, 0, 1, 0.0f, 0.0f, 1);
+    scan.mz.swap(mzs);
+    scan.intensity.assign(3, 1000.0f);
+    scan.updateSummary();
+    for (unsigned int i = 0; i < scan.nobs(); i++) {
+        QVERIFY(scan.mz[i] == static_cast<mzValue>(values[i]));
+        QVERIFY(fabs(scan.mz[i] - values[i])
+                <= values[i] * numeric_limits<mzValue>::epsilon());
+#ifdef MZ_DOUBLE
+        QVERIFY(scan.mz[i] == values[i]);
+#endif
+    }
+    QVERIFY(scan.minMz() == static_cast<mzValue>(values[1]));
+    QVERIFY(scan.maxMz() == static_cast<mzValue>(values[2]));
+}
+
 void TestLoadSamples:: testMinMaxMz() {
     mzSample mzsample;
     float minMz = 70.0012;
@@ -194,3 +436,297 @@ void TestLoadSamples::testParseMzMLInjectionTimeStamp() {
     }
 
 }
+
+static string writeTestFile(const QTemporaryDir& dir,
+                            const char* name,
+                            const string& content)
+{
+    string path = dir.filePath(name).toStdString();
+    ofstream file(path.c_str(), ios::out | ios::binary);
+    file << content;
+    return path;
+}
+
+void TestLoadSamples::testXMLElementReader() {
+    // comments and CDATA sections may hold text that looks like a tag, and
+    // quoted attribute values may hold '>'
+    const string content =
+        "<?xml version=\"1.0\"?>\n"
+        "<!-- <spectrum id=\"inComment\"> -->\n"
+        "<list>\n"
+        "<spectrum id=\"a\" note=\"x &gt; y &amp; &quot;z&quot; > w\">"
+        "<![CDATA[</spectrum><spectrum id=\"inCData\">]]>"
+        "<spectrum id=\"nested\"><p/></spectrum>"
+        "</spectrum>\n"
+        "<spectrum id=\"b\"/>\n"
+        "</list>\n";
+    size_t startA = content.find("<spectrum id=\"a\"");
+    size_t endA = content.find("</spectrum>\n") + strlen("</spectrum>");
+    size_t startB = content.find("<spectrum id=\"b\"");
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    string path = writeTestFile(dir, "reader.xml", content);
+
+    // tags and elements split across chunks are read the same way
+    const vector<string> tags = {"spectrum"};
+    for (size_t chunkSize : {1, 7, 1 << 22}) {
+        XMLElementReader reader(path, chunkSize);
+        QVERIFY(reader.isOpen());
+
+        string name, element;
+        QVERIFY(reader.findStartTag(tags, name));
+        QVERIFY(name == "spectrum");
+        QVERIFY(reader.tagOffset() == static_cast<long long>(startA));
+
+        xml_document tagDoc;
+        QVERIFY(tagDoc.load_string(reader.startTag().c_str()));
+        QVERIFY(string(tagDoc.child("spectrum").attribute("id").value())
+                == "a");
+
+        // entities are kept as written, for the XML parser to decode
+        QVERIFY(reader.readElement(element));
+        QVERIFY(element == content.substr(startA, endA - startA));
+        xml_document doc;
+        QVERIFY(doc.load_string(element.c_str()));
+        xml_node spectrum = doc.child("spectrum");
+        QVERIFY(string(spectrum.attribute("note").value())
+                == "x > y & \"z\" > w");
+        QVERIFY(string(spectrum.child("spectrum").attribute("id").value())
+                == "nested");
+
+        QVERIFY(reader.findStartTag(tags, name));
+        QVERIFY(reader.tagOffset() == static_cast<long long>(startB));
+        QVERIFY(reader.startTag() == "<spectrum id=\"b\"/>");
+        QVERIFY(reader.readElement(element));
+        QVERIFY(element == "<spectrum id=\"b\"/>");
+
+        QVERIFY(!reader.findStartTag(tags, name));
+    }
+}
+
+void TestLoadSamples::testStreamMzML() {
+    // the same 64-bit array is used for m/z and intensity values
+    const string binary =
+        "<binaryDataArrayList count=\"2\">"
+        "<binaryDataArray encodedLength=\"32\">"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000523\" name=\"64-bit float\" value=\"\"/>"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000514\" name=\"m/z array\" value=\"\"/>"
+        "<binary>c59HhUVKk0D///8/P4RRQPX//58CDqJA</binary>"
+        "</binaryDataArray>"
+        "<binaryDataArray encodedLength=\"32\">"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000523\" name=\"64-bit float\" value=\"\"/>"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000515\" name=\"intensity array\" value=\"\"/>"
+        "<binary>c59HhUVKk0D///8/P4RRQPX//58CDqJA</binary>"
+        "</binaryDataArray>"
+        "</binaryDataArrayList>\n";
+    const string content =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        "<mzML xmlns=\"http://psi.hupo.org/ms/mzml\" version=\"1.1.0\">\n"
+        "<!-- <run startTimeStamp=\"1999-01-01T00:00:00Z\"> -->\n"
+        "<run id=\"test\" startTimeStamp=\"2001-10-26T19:32:52Z\">\n"
+        "<spectrumList count=\"3\">\n"
+        "<spectrum index=\"0\" id=\"scan=1\" defaultArrayLength=\"3\">\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000511\" name=\"ms level\" value=\"1\"/>\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000130\" name=\"positive scan\" value=\"\"/>\n"
+        "<scanList count=\"1\"><scan>\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000016\" name=\"scan start time\" value=\"1.5\" unitName=\"minute\"/>\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000512\" name=\"filter string\" value=\"FTMS + p ESI &lt;sim&gt; ms [70.00-2500.00]\"/>\n"
+        "</scan></scanList>\n"
+        + binary +
+        "</spectrum>\n"
+        "<![CDATA[<spectrum id=\"inCData\">]]>\n"
+        "<spectrum index=\"1\" id=\"scan=2\" defaultArrayLength=\"0\"/>\n"
+        "<!-- </spectrum> -->\n"
+        "<spectrum index=\"2\" id=\"scan=3\" defaultArrayLength=\"3\">\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000511\" name=\"ms level\" value=\"2\"/>\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000129\" name=\"negative scan\" value=\"\"/>\n"
+        "<scanList count=\"1\"><scan>\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000016\" name=\"scan start time\" value=\"120\" unitName=\"second\"/>\n"
+        "</scan></scanList>\n"
+        "<precursorList count=\"1\"><precursor><isolationWindow>\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000827\" name=\"isolation window target m/z\" value=\"1234.5678\"/>\n"
+        "</isolationWindow></precursor></precursorList>\n"
+        + binary +
+        "</spectrum>\n"
+        "</spectrumList>\n"
+        "</run>\n"
+        "</mzML>\n";
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    string path = writeTestFile(dir, "stream.mzML", content);
+
+    mzSample streamed;
+    streamed.parseMzML(path.c_str());
+    QVERIFY(streamed.injectionTime == 1004124772);
+
+    // spectra streamed one at a time match the ones parsed from the whole
+    // document
+    mzSample parsed;
+    xml_document doc;
+    QVERIFY(doc.load_file(path.c_str(), parse_minimal));
+    parsed.parseMzMLSpectrumList(
+        doc.child("mzML").child("run").child("spectrumList"));
+
+    QVERIFY(streamed.scans.size() == 2);
+    QVERIFY(streamed.scans.size() == parsed.scans.size());
+    for (unsigned int i = 0; i < streamed.scans.size(); i++) {
+        Scan* scan = streamed.scans[i];
+        Scan* expected = parsed.scans[i];
+        QVERIFY(scan->scannum == expected->scannum);
+        QVERIFY(scan->mslevel == expected->mslevel);
+        QVERIFY(scan->getPolarity() == expected->getPolarity());
+        QVERIFY(scan->rt == expected->rt);
+        QVERIFY(scan->precursorMz == expected->precursorMz);
+        QVERIFY(scan->filterLine == expected->filterLine);
+        QVERIFY(scan->mz == expected->mz);
+        QVERIFY(scan->intensity == expected->intensity);
+        QVERIFY(scan->nobs() == 3);
+    }
+
+    Scan* first = streamed.scans[0];
+    QVERIFY(first->mslevel == 1);
+    QVERIFY(first->getPolarity() == 1);
+    QVERIFY(TestUtils::floatCompare(first->rt, 1.5));
+    QVERIFY(first->filterLine.find("&lt;sim&gt;") != string::npos);
+    QVERIFY(content.compare(first->fileSeekStart,
+                            strlen("<spectrum index=\"0\""),
+                            "<spectrum index=\"0\"") == 0);
+
+    Scan* second = streamed.scans[1];
+    QVERIFY(second->mslevel == 2);
+    QVERIFY(second->getPolarity() == -1);
+    QVERIFY(TestUtils::floatCompare(second->rt, 2.0));
+    QVERIFY(TestUtils::floatCompare(second->precursorMz, 1234.5678));
+    QVERIFY(content.compare(second->fileSeekStart,
+                            strlen("<spectrum index=\"2\""),
+                            "<spectrum index=\"2\"") == 0);
+}
+
+void TestLoadSamples::testStreamMzXML() {
+    // peaks (100.5, 20), (0, 5) and (200.25, 30), as 32-bit network order
+    const string peaks =
+        "<peaks precision=\"32\" byteOrder=\"network\" pairOrder=\"m/z-int\">"
+        "QskAAEGgAAAAAAAAQKAAAENIQABB8AAA</peaks>\n";
+    const string content =
+        "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+        "<mzXML xmlns=\"http://sashimi.sourceforge.net/schema_revision/mzXML_3.2\">\n"
+        "<msRun scanCount=\"3\">\n"
+        "<msInstrument>\n"
+        "<msManufacturer category=\"msManufacturer\" value=\"Thermo Scientific\"/>\n"
+        "<msModel category=\"msModel\" value=\"Q &amp; E > HF\"/>\n"
+        "</msInstrument>\n"
+        "<!-- <scan num=\"0\" msLevel=\"1\"> -->\n"
+        "<scan num=\"1\" msLevel=\"1\" peaksCount=\"3\" polarity=\"+\" retentionTime=\"PT90S\">\n"
+        + peaks +
+        "<![CDATA[</scan>]]>\n"
+        "<scan num=\"2\" msLevel=\"2\" peaksCount=\"3\" polarity=\"+\" retentionTime=\"PT91S\">\n"
+        "<precursorMz precursorIntensity=\"100\">100.5</precursorMz>\n"
+        + peaks +
+        "</scan>\n"
+        "</scan>\n"
+        "<scan num=\"3\" msLevel=\"1\" peaksCount=\"0\" retentionTime=\"PT120S\">\n"
+        "<peaks precision=\"32\" byteOrder=\"network\" pairOrder=\"m/z-int\"/>\n"
+        "</scan>\n"
+        "</msRun>\n"
+        "</mzXML>\n";
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    string path = writeTestFile(dir, "stream.mzXML", content);
+
+    mzSample mzsample;
+    mzsample.parseMzXML(path.c_str());
+    QVERIFY(mzsample.instrumentInfo["msManufacturer"] == "Thermo Scientific");
+    QVERIFY(mzsample.instrumentInfo["msModel"] == "Q &amp; E > HF");
+
+    // scans nested within another are read as well, scans without peaks
+    // are dropped and so are peaks at m/z 0
+    QVERIFY(mzsample.scans.size() == 2);
+    for (auto scan : mzsample.scans) {
+        QVERIFY(scan->nobs() == 2);
+        QVERIFY(TestUtils::floatCompare(scan->mz[0], 100.5));
+        QVERIFY(TestUtils::floatCompare(scan->intensity[0], 20.0));
+        QVERIFY(TestUtils::floatCompare(scan->mz[1], 200.25));
+        QVERIFY(TestUtils::floatCompare(scan->intensity[1], 30.0));
+    }
+    QVERIFY(mzsample.scans[0]->mslevel == 1);
+    QVERIFY(TestUtils::floatCompare(mzsample.scans[0]->rt, 1.5));
+    QVERIFY(mzsample.scans[1]->mslevel == 2);
+    QVERIFY(TestUtils::floatCompare(mzsample.scans[1]->rt, 91.0 / 60.0));
+    QVERIFY(TestUtils::floatCompare(mzsample.scans[1]->precursorMz, 100.5));
+}
+
+void TestLoadSamples::testStreamFallback() {
+    // files without spectra (here within an indexedmzML wrapper) are read
+    // as a whole document
+    const char* filename = "bin/methods/ms2test1.mzML";
+    mzSample streamed;
+    streamed.parseMzML(filename);
+
+    mzSample parsed;
+    xml_document doc;
+    QVERIFY(doc.load_file(filename, parse_minimal));
+    parsed.parseMzMLChromatogramList(doc.first_child().first_element_by_path(
+        "mzML/run/chromatogramList"));
+
+    QVERIFY(streamed.scans.size() > 0);
+    QVERIFY(streamed.scans.size() == parsed.scans.size());
+    for (unsigned int i = 0; i < streamed.scans.size(); i++) {
+        QVERIFY(streamed.scans[i]->filterLine == parsed.scans[i]->filterLine);
+        QVERIFY(streamed.scans[i]->mz == parsed.scans[i]->mz);
+        QVERIFY(streamed.scans[i]->intensity == parsed.scans[i]->intensity);
+    }
+}
+
+void TestLoadSamples::testCorruptBinaryData() {
+    // a zlib stream cut short fails the whole sample, instead of leaving a
+    // spectrum with part of its peaks
+    const string spectrum =
+        "<spectrum index=\"0\" id=\"scan=1\" defaultArrayLength=\"3\">\n"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000511\" name=\"ms level\" value=\"1\"/>\n"
+        "<binaryDataArrayList count=\"2\">"
+        "<binaryDataArray encodedLength=\"44\">"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000523\" name=\"64-bit float\" value=\"\"/>"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000574\" name=\"zlib compression\" value=\"\"/>"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000514\" name=\"m/z array\" value=\"\"/>"
+        "<binary>eJz7//+/vX1LoMPX///nM/EtcmBkYDhwAMgHAKlqC6s=</binary>"
+        "</binaryDataArray>"
+        "<binaryDataArray encodedLength=\"24\">"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000523\" name=\"64-bit float\" value=\"\"/>"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000574\" name=\"zlib compression\" value=\"\"/>"
+        "<cvParam cvRef=\"MS\" accession=\"MS:1000515\" name=\"intensity array\" value=\"\"/>"
+        "<binary>eJz7//+/vX1LoMPX///nM/Et</binary>"
+        "</binaryDataArray>"
+        "</binaryDataArrayList>\n"
+        "</spectrum>\n";
+    const string content =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        "<mzML><run><spectrumList count=\"1\">\n"
+        + spectrum +
+        "</spectrumList></run></mzML>\n";
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    string path = writeTestFile(dir, "corrupt.mzML", content);
+
+    mzSample mzsample;
+    mzsample.loadSample(path);
+    QVERIFY(mzsample.scans.empty());
+
+    // the same goes for the peaks of an mzXML scan
+    const string mzXML =
+        "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+        "<mzXML><msRun scanCount=\"1\">\n"
+        "<scan num=\"1\" msLevel=\"1\" peaksCount=\"1\" retentionTime=\"PT60S\">\n"
+        "<peaks precision=\"64\" byteOrder=\"little\" compressionType=\"zlib\">"
+        "eJz7//+/vX1LoMPX///nM/Et</peaks>\n"
+        "</scan>\n"
+        "</msRun></mzXML>\n";
+    path = writeTestFile(dir, "corrupt.mzXML", mzXML);
+
+    mzSample mzXMLSample;
+    mzXMLSample.loadSample(path);
+    QVERIFY(mzXMLSample.scans.empty());
+}
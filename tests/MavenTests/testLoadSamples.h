@@ -29,6 +29,12 @@ class TestLoadSamples : public QObject {
         void testIsAllScansParsed();
         void testScanParsing();
         void testSrmScan();
+        void testScanIndex();
+        void testLazyScanLoading();
+        void testSpectrumStore();
+        void testIonChromatograms();
+        void testFragmentationEvents();
+        void testMzPrecision();
         void testMinMaxMz();
         void testMinMaxRT();
 #ifndef WIN32
@@ -36,6 +42,11 @@ class TestLoadSamples : public QObject {
 #endif
         void testBlankSample();
         void testParseMzMLInjectionTimeStamp();
+        void testXMLElementReader();
+        void testStreamMzML();
+        void testStreamMzXML();
+        void testStreamFallback();
+        void testCorruptBinaryData();
 };
 
 #endif // TESTLOADSAMPLES_H
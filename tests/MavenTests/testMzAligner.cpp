@@ -1,3 +1,5 @@
+#include <omp.h>
+
 #include "testMzAligner.h"
 #include "classifierNeuralNet.h"
 #include "masscutofftype.h"
@@ -91,6 +93,133 @@ void TestMzAligner::testObiWarp()
 
 }
 
+void TestMzAligner::testObiWarpThreads()
+{
+    MavenParameters* mavenparameters = new MavenParameters;
+    mavenparameters->samples = maventests::samples.alignmentSamples;
+    ObiParams params("cor", false, 2.0, 1.0, 0.20, 3.40, 0.0, 20.0, false, 0.60);
+
+    int maxThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    Aligner serialAligner;
+    serialAligner.alignWithObiWarp(mavenparameters->samples, &params, mavenparameters);
+    omp_set_num_threads(maxThreads);
+
+    vector<vector<float>> serialRts;
+    for (auto sample : mavenparameters->samples) {
+        vector<float> rts;
+        for (auto scan : sample->scans)
+            rts.push_back(scan->rt);
+        serialRts.push_back(rts);
+        sample->restorePreviousRetentionTimes();
+    }
+
+    Aligner parallelAligner;
+    parallelAligner.alignWithObiWarp(mavenparameters->samples, &params, mavenparameters);
+    for (unsigned int i = 0; i < mavenparameters->samples.size(); i++) {
+        mzSample* sample = mavenparameters->samples[i];
+        for (unsigned int j = 0; j < sample->scans.size(); j++)
+            QVERIFY(sample->scans[j]->rt == serialRts[i][j]);
+        sample->restorePreviousRetentionTimes();
+    }
+    delete mavenparameters;
+}
+
+void TestMzAligner::testObiWarpBand()
+{
+    MavenParameters* mavenparameters = new MavenParameters;
+    mavenparameters->samples = maventests::samples.alignmentSamples;
+    ObiParams params("cor", false, 2.0, 1.0, 0.20, 3.40, 0.0, 20.0, false, 0.60);
+
+    Aligner aligner;
+    aligner.alignWithObiWarp(mavenparameters->samples, &params, mavenparameters);
+    vector<vector<float>> fullRts;
+    for (auto sample : mavenparameters->samples) {
+        vector<float> rts;
+        for (auto scan : sample->scans)
+            rts.push_back(scan->rt);
+        fullRts.push_back(rts);
+        sample->restorePreviousRetentionTimes();
+    }
+
+    // a band wider than the runs holds the whole score matrix
+    ObiParams wideParams("cor", false, 2.0, 1.0, 0.20, 3.40, 0.0, 20.0, false, 0.60,
+                         false, 1000.0f);
+    Aligner wideAligner;
+    wideAligner.alignWithObiWarp(mavenparameters->samples, &wideParams, mavenparameters);
+    for (unsigned int i = 0; i < mavenparameters->samples.size(); i++) {
+        mzSample* sample = mavenparameters->samples[i];
+        for (unsigned int j = 0; j < sample->scans.size(); j++)
+            QVERIFY(sample->scans[j]->rt == fullRts[i][j]);
+        sample->restorePreviousRetentionTimes();
+    }
+
+    // a narrow band still gives a monotonic warp
+    ObiParams bandParams("cor", false, 2.0, 1.0, 0.20, 3.40, 0.0, 20.0, false, 0.60,
+                         false, 0.5f);
+    Aligner bandAligner;
+    bandAligner.alignWithObiWarp(mavenparameters->samples, &bandParams, mavenparameters);
+    for (auto sample : mavenparameters->samples) {
+        for (unsigned int j = 1; j < sample->scans.size(); j++)
+            QVERIFY(sample->scans[j]->rt >= sample->scans[j - 1]->rt);
+        sample->restorePreviousRetentionTimes();
+    }
+    delete mavenparameters;
+}
+
+void TestMzAligner::testSegmentedAlignment()
+{
+    mzSample* sample = maventests::samples.alignmentSamples[0];
+    vector<float> rts;
+    for (auto scan : sample->scans)
+        rts.push_back(scan->rt);
+
+    // stretch retention times by 10%, using a segment every 50 scans
+    vector<AlignmentSegment> segments;
+    for (unsigned int i = 0; i < rts.size(); i++) {
+        if (i % 50 != 0 && i != rts.size() - 1)
+            continue;
+        AlignmentSegment seg;
+        seg.sampleName = sample->sampleName;
+        seg.segStart = segments.empty() ? 0.0f : segments.back().segEnd;
+        seg.newStart = segments.empty() ? 0.0f : segments.back().newEnd;
+        seg.segEnd = rts[i];
+        seg.newEnd = rts[i] * 1.1f;
+        segments.push_back(seg);
+    }
+
+    // the table finds the same segment as a linear search would
+    AlignmentSegmentTable table(segments);
+    QVERIFY(table.size() == segments.size());
+    for (auto rt : rts) {
+        const AlignmentSegment* expected = nullptr;
+        for (auto& seg : segments) {
+            if (rt >= seg.segStart && rt <= seg.segEnd) {
+                expected = &seg;
+                break;
+            }
+        }
+        const AlignmentSegment* found = table.segmentFor(rt);
+        QVERIFY(found != nullptr && expected != nullptr);
+        QVERIFY(found->segStart == expected->segStart);
+        QVERIFY(found->segEnd == expected->segEnd);
+    }
+    QVERIFY(table.segmentFor(rts.back() + 1.0f) == nullptr);
+
+    Aligner aligner;
+    aligner.setSamples({sample});
+    map<string, vector<AlignmentSegment>> sampleSegments;
+    sampleSegments[sample->sampleName] = segments;
+    aligner.setAlignmentSegment(sampleSegments);
+    aligner.performSegmentedAlignment();
+    for (unsigned int i = 0; i < rts.size(); i++)
+        QVERIFY(std::abs(sample->scans[i]->rt - rts[i] * 1.1f) < 1e-3f);
+
+    for (unsigned int i = 0; i < rts.size(); i++)
+        sample->scans[i]->rt = rts[i];
+    sample->retentionTimesUpdated();
+}
+
 void TestMzAligner::testSaveFit(){
 
     vector<mzSample*> samplesToLoad  = maventests::samples.alignmentSamples;
@@ -34,6 +34,26 @@ class TestMzAligner : public QObject {
          */
         void testObiWarp();
 
+        /**
+         * @brief Checks that aligning samples in parallel gives the same
+         * retention times as aligning them one at a time.
+         */
+        void testObiWarpThreads();
+
+        /**
+         * @brief Checks that limiting OBI-WARP to a band of retention time
+         * shifts wider than the runs changes nothing, and that a narrow band
+         * still gives monotonic retention times.
+         */
+        void testObiWarpBand();
+
+        /**
+         * @brief Checks segment lookup in an AlignmentSegmentTable against
+         * a linear search, and the retention times given by segmented
+         * alignment.
+         */
+        void testSegmentedAlignment();
+
 };
 
 #endif // TESTMZALIGNER_H
@@ -1,6 +1,9 @@
+#include <omp.h>
+
 #include "testPeakDetection.h"
 #include "datastructures/mzSlice.h"
 #include "masscutofftype.h"
+#include "massslicer.h"
 #include "PeakGroup.h"
 #include "EIC.h"
 #include "utilities.h"
@@ -88,6 +91,140 @@ void TestPeakDetection::testPullEICs() {
                                                mavenparameters->samples,
                                                mavenparameters);
     QVERIFY(eics.size() == 2);
+
+    // EICs follow sample order and do not depend on the number of threads
+    for (unsigned int i = 0; i < eics.size(); i++)
+        QVERIFY(eics[i]->sample == samplesToLoad[i]);
+
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    vector<EIC*> serialEics = PeakDetector::pullEICs(slice,
+                                                     mavenparameters->samples,
+                                                     mavenparameters);
+    omp_set_num_threads(threads);
+    QVERIFY(serialEics.size() == eics.size());
+    for (unsigned int i = 0; i < eics.size(); i++) {
+        QVERIFY(serialEics[i]->sample == eics[i]->sample);
+        QVERIFY(serialEics[i]->intensity == eics[i]->intensity);
+        QVERIFY(serialEics[i]->peaks.size() == eics[i]->peaks.size());
+        for (unsigned int j = 0; j < eics[i]->peaks.size(); j++) {
+            QVERIFY(serialEics[i]->peaks[j].pos == eics[i]->peaks[j].pos);
+            QVERIFY(serialEics[i]->peaks[j].peakArea
+                    == eics[i]->peaks[j].peakArea);
+        }
+    }
+    delete_all(eics);
+    delete_all(serialEics);
+}
+
+void TestPeakDetection::testBaselineWindow() {
+    vector<mzSample*> samplesToLoad;
+    for (int i = 0; i < files.size(); ++i) {
+        mzSample* mzsample = new mzSample();
+        mzsample->loadSample(files.at(i).toLatin1().data());
+        samplesToLoad.push_back(mzsample);
+    }
+
+    MavenParameters* mavenparameters = new MavenParameters();
+    mavenparameters->compoundMassCutoffWindow->setMassCutoffAndType(10,"ppm");
+    mavenparameters->samples = samplesToLoad;
+    mavenparameters->baselineWindowPadding = 1.0f;
+
+    vector<Compound*> compounds = TestUtils::getCompoudDataBaseWithRT();
+    vector<mzSlice*> slices;
+    for (size_t i = 0; i < 5 && i < compounds.size(); ++i) {
+        mzSlice* slice = new mzSlice();
+        slice->compound = compounds[i];
+        slice->calculateRTMinMax(true, 2);
+        slice->calculateMzMinMax(mavenparameters->compoundMassCutoffWindow, +1);
+        slices.push_back(slice);
+    }
+
+    // the windowed EIC is restricted to the padded slice, and its baseline
+    // is the one estimated over the padded window
+    mavenparameters->baselineWindowMode = true;
+    mzSlice* slice = slices[0];
+    vector<EIC*> eics = PeakDetector::pullEICs(slice,
+                                               mavenparameters->samples,
+                                               mavenparameters);
+    QVERIFY(eics.size() == 2);
+    for (auto eic : eics) {
+        for (auto rt : eic->rt) {
+            QVERIFY(rt >= slice->rtmin - 0.01f);
+            QVERIFY(rt <= slice->rtmax + 0.01f);
+        }
+
+        mzSample* sample = eic->getSample();
+        float padding = mavenparameters->baselineWindowPadding;
+        EIC* padded = sample->getEIC(slice->mzmin,
+                                     slice->mzmax,
+                                     max(sample->minRt, slice->rtmin - padding),
+                                     min(sample->maxRt, slice->rtmax + padding),
+                                     1,
+                                     mavenparameters->eicType,
+                                     mavenparameters->filterline);
+        padded->setBaselineMode(EIC::BaselineMode::Threshold);
+        padded->setBaselineSmoothingWindow(
+            mavenparameters->baseline_smoothingWindow);
+        padded->setBaselineDropTopX(mavenparameters->baseline_dropTopX);
+        padded->computeBaseline();
+        padded->reduceToRtRange(slice->rtmin, slice->rtmax);
+        QVERIFY(padded->size() == eic->size());
+        for (unsigned int i = 0; i < eic->size(); ++i)
+            QVERIFY(eic->baseline[i] == padded->baseline[i]);
+        delete padded;
+    }
+    delete_all(eics);
+
+    // every peak found by default is reported
+    stringstream report;
+    float maxDifference = PeakDetector::validateBaselineWindow(
+        slices, mavenparameters->samples, mavenparameters, report);
+    QVERIFY(maxDifference >= 0.0f && maxDifference <= 1.0f);
+    QVERIFY(report.str().find("fullTraceArea") != string::npos);
+
+    delete_all(slices);
+    delete_all(samplesToLoad);
+}
+
+void TestPeakDetection::testFeatureSlicePartitions() {
+    vector<mzSample*> samplesToLoad;
+    for (int i = 0; i < files.size(); ++i) {
+        mzSample* mzsample = new mzSample();
+        mzsample->loadSample(files.at(i).toLatin1().data());
+        samplesToLoad.push_back(mzsample);
+    }
+
+    MavenParameters* mavenparameters = new MavenParameters();
+    mavenparameters->samples = samplesToLoad;
+    mavenparameters->minIntensity = 10000;
+    mavenparameters->minMz = 100;
+    mavenparameters->maxMz = 400;
+
+    // slices reduced and merged over m/z partitions, in parallel, should be
+    // the same as those from a single serial pass
+    MassSlicer serialSlicer(mavenparameters);
+    serialSlicer.partitionSlices = false;
+    serialSlicer.findFeatureSlices();
+
+    MassSlicer partitionedSlicer(mavenparameters);
+    partitionedSlicer.findFeatureSlices();
+
+    QVERIFY(serialSlicer.slices.size() > 0);
+    QVERIFY(partitionedSlicer.slices.size() == serialSlicer.slices.size());
+    for (size_t i = 0; i < serialSlicer.slices.size(); ++i) {
+        auto serial = serialSlicer.slices[i];
+        auto partitioned = partitionedSlicer.slices[i];
+        QVERIFY(partitioned->mz == serial->mz);
+        QVERIFY(partitioned->mzmin == serial->mzmin);
+        QVERIFY(partitioned->mzmax == serial->mzmax);
+        QVERIFY(partitioned->rtmin == serial->rtmin);
+        QVERIFY(partitioned->rtmax == serial->rtmax);
+        QVERIFY(partitioned->ionCount == serial->ionCount);
+    }
+
+    delete mavenparameters;
+    delete_all(samplesToLoad);
 }
 
 void TestPeakDetection::testprocessSlices() {
@@ -96,3 +233,79 @@ void TestPeakDetection::testprocessSlices() {
     QVERIFY(allgroups.size() > 0);
 
 }
+
+void TestPeakDetection::testProcessSlicesDeterminism() {
+    vector<mzSample*> samplesToLoad;
+    MavenParameters* mavenparameters = new MavenParameters();
+    TestUtils::loadSamplesAndParameters(samplesToLoad, mavenparameters);
+
+    // untargeted detection with the given number of threads and group limit
+    auto detectGroups = [&](int numThreads, int limitGroupCount) {
+        int threads = omp_get_max_threads();
+        omp_set_num_threads(numThreads);
+        mavenparameters->limitGroupCount = limitGroupCount;
+        PeakDetector peakDetector;
+        peakDetector.setMavenParameters(mavenparameters);
+        peakDetector.processFeatures({});
+        omp_set_num_threads(threads);
+        return mavenparameters->allgroups;
+    };
+    auto sameGroups = [](const vector<PeakGroup>& groups,
+                         const vector<PeakGroup>& otherGroups) {
+        if (groups.size() != otherGroups.size())
+            return false;
+        for (size_t i = 0; i < groups.size(); ++i) {
+            const PeakGroup& group = groups[i];
+            const PeakGroup& other = otherGroups[i];
+            if (group.meanMz != other.meanMz || group.meanRt != other.meanRt
+                || group.peakCount() != other.peakCount())
+                return false;
+            for (unsigned int j = 0; j < group.peakCount(); ++j) {
+                const Peak& peak = group.peaks[j];
+                const Peak& otherPeak = other.peaks[j];
+                if (peak.getSample() != otherPeak.getSample()
+                    || peak.rt != otherPeak.rt
+                    || peak.peakAreaCorrected != otherPeak.peakAreaCorrected)
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    // groups are merged in slice order, whatever the number of threads
+    vector<PeakGroup> serialGroups = detectGroups(1, INT_MAX);
+    vector<PeakGroup> parallelGroups = detectGroups(4, INT_MAX);
+    QVERIFY(serialGroups.size() > 1);
+    QVERIFY(sameGroups(serialGroups, parallelGroups));
+
+    // the limit is hit at the same slice, even though slices after it in
+    // the same batch have already been processed by other threads
+    int limitGroupCount = min(5, static_cast<int>(serialGroups.size()) / 2);
+    vector<PeakGroup> limitedSerialGroups = detectGroups(1, limitGroupCount);
+    vector<PeakGroup> limitedParallelGroups = detectGroups(4, limitGroupCount);
+    QVERIFY(limitedSerialGroups.size() > static_cast<size_t>(limitGroupCount));
+    QVERIFY(limitedSerialGroups.size() < serialGroups.size());
+    QVERIFY(sameGroups(limitedSerialGroups, limitedParallelGroups));
+
+    delete mavenparameters;
+    delete_all(samplesToLoad);
+}
+
+void TestPeakDetection::testGroupParameters() {
+    vector<PeakGroup> allgroups = TestUtils::getGroupsFromProcessCompounds();
+    QVERIFY(allgroups.size() > 0);
+
+    // copies of a group share its parameters
+    PeakGroup& group = allgroups[0];
+    PeakGroup copy(group);
+    QVERIFY(copy.parameters() == group.parameters());
+
+    // modifying them detaches the group from the others
+    int dropTopX = group.parameters()->baseline_dropTopX;
+    MavenParameters* mp = copy.mutableParameters();
+    mp->baseline_dropTopX = dropTopX + 10;
+    QVERIFY(copy.parameters() != group.parameters());
+    QVERIFY(group.parameters()->baseline_dropTopX == dropTopX);
+    QVERIFY(copy.parameters()->baseline_dropTopX == dropTopX + 10);
+    QVERIFY(copy.mutableParameters() == mp);
+}
@@ -29,7 +29,11 @@ class TestPeakDetection : public QObject {
         // this is automatically detected thanks to Qt's meta-information about QObjects
         void testProcessCompound();
         void testPullEICs();
+        void testBaselineWindow();
+        void testFeatureSlicePartitions();
         void testprocessSlices();
+        void testProcessSlicesDeterminism();
+        void testGroupParameters();
 };
 
 #endif // TESTPEAKDETECTION_H
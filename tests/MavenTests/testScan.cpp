@@ -3,6 +3,7 @@
 #include "mavenparameters.h"
 #include "mzSample.h"
 #include "Scan.h"
+#include "datastructures/scanmzindex.h"
 #include "utilities.h"
 
 TestScan::TestScan() {
@@ -311,3 +312,76 @@ void TestScan::testgetTopPeaks() {
     QVERIFY(TestUtils::floatCompare(selected[0].second,(float) 2.06999993));
     QVERIFY(TestUtils::floatCompare(selected[1].second,(float) 8.8000001));
 }
+
+void TestScan::testupdateSummary() {
+    Scan* scan=new Scan (sample,1,2,3.3,4.4,1);
+    initScan (scan);
+
+    //without a summary, values are computed from the peaks
+    QVERIFY(TestUtils::floatCompare(scan->minMz(), 2.07));
+    QVERIFY(TestUtils::floatCompare(scan->maxMz(), 8.8));
+    QVERIFY(TestUtils::floatCompare(scan->totalIntensity(), 28.6));
+
+    scan->updateSummary();
+    QVERIFY(TestUtils::floatCompare(scan->minMz(), 2.07));
+    QVERIFY(TestUtils::floatCompare(scan->maxMz(), 8.8));
+    QVERIFY(TestUtils::floatCompare(scan->maxIntensity(), 9.9));
+    QVERIFY(TestUtils::floatCompare(scan->basePeakMz(), 2.07));
+    QVERIFY(TestUtils::floatCompare(scan->totalIntensity(), 28.6));
+    QVERIFY(scan->overlapsMzRange(2.085, 2.1));
+    QVERIFY(!scan->overlapsMzRange(9.0, 10.0));
+
+    //the summary outlives released peaks
+    scan->mz.clear();
+    scan->intensity.clear();
+    QVERIFY(TestUtils::floatCompare(scan->minMz(), 2.07));
+    QVERIFY(TestUtils::floatCompare(scan->maxMz(), 8.8));
+    QVERIFY(TestUtils::floatCompare(scan->maxIntensity(), 9.9));
+    QVERIFY(!scan->overlapsMzRange(1.0, 2.0));
+
+    //filters keep the summary up to date
+    initScan (scan);
+    scan->intensityFilter(9);
+    QVERIFY(TestUtils::floatCompare(scan->maxMz(), 2.07));
+    QVERIFY(TestUtils::floatCompare(scan->totalIntensity(), 9.9));
+
+    delete scan;
+}
+
+void TestScan::testScanMzIndex() {
+    deque<Scan*> scans;
+    for (int i = 0; i < 100; i++) {
+        Scan* scan = new Scan(sample, i, 1, i * 0.1f, 0, 1);
+
+        //every tenth scan only covers m/z 300 to 302
+        if (i % 10 == 0) {
+            scan->mz = {300.1f, 301.5f};
+        } else {
+            scan->mz = {100.2f, 150.7f, 250.3f};
+        }
+        scan->intensity.assign(scan->mz.size(), 1000.0f);
+        scans.push_back(scan);
+    }
+
+    ScanMzIndex index;
+    QVERIFY(index.mayContain(0, 100.0f, 101.0f));
+
+    index.build(scans, 1.0f);
+    QVERIFY(!index.empty());
+    QVERIFY(index.numBins() == 202);
+    for (int i = 0; i < 100; i++) {
+        bool sparse = (i % 10 == 0);
+        QVERIFY(index.mayContain(i, 301.4f, 301.6f) == sparse);
+        QVERIFY(index.mayContain(i, 150.69f, 150.71f) == !sparse);
+        QVERIFY(!index.mayContain(i, 200.0f, 201.0f));
+        QVERIFY(index.mayContain(i, 0.0f, 1000.0f));
+        QVERIFY(!index.mayContain(i, 10.0f, 20.0f));
+    }
+
+    //scans that were not indexed are never skipped
+    QVERIFY(index.mayContain(100, 200.0f, 201.0f));
+
+    index.clear();
+    QVERIFY(index.empty());
+    mzUtils::delete_all(scans);
+}
@@ -40,6 +40,8 @@ class TestScan : public QObject {
         void testchargeSeries();
         void testdeconvolute();
         void testgetTopPeaks();
+        void testupdateSummary();
+        void testScanMzIndex();
 
 };
 
@@ -36,6 +36,101 @@ void Testbase64::testdecodeBase64()
     QVERIFY(TestUtils::floatCompare(decodedArray[2],70.0742645263672));
 }
 
+void Testbase64::testdecodeBase64Compressed()
+{
+    // zlib compressed, little endian 64-bit values
+    string b64String="eJz7//+/vX1LoMPX///nM/EtcmBkYDhwAMgHAKlqC6s=";
+    vector<float> decodedArray;
+    QVERIFY(base64::decodeBase64(b64String.c_str(),
+                                 b64String.size(),
+                                 8,
+                                 false,
+                                 true,
+                                 decodedArray));
+
+    QVERIFY(decodedArray.size()==3);
+    QVERIFY(TestUtils::floatCompare(decodedArray[0],70.0663604736328));
+    QVERIFY(TestUtils::floatCompare(decodedArray[1],2311.00512695312));
+    QVERIFY(TestUtils::floatCompare(decodedArray[2],70.0742645263672));
+}
+
+void Testbase64::testdecodeBase64CorruptCompressed()
+{
+    // the stream above cut short, and with a broken zlib header
+    vector<string> b64Strings = {
+        "eJz7//+/vX1LoMPX///nM/Et",
+        "AAAA//+/vX1LoMPX///nM/EtcmBkYDhwAMgHAKlqC6s="
+    };
+    for (const string& b64String : b64Strings) {
+        vector<float> decodedArray(1, 1.0f);
+        QVERIFY(!base64::decodeBase64(b64String.c_str(),
+                                      b64String.size(),
+                                      8,
+                                      false,
+                                      true,
+                                      decodedArray));
+        QVERIFY(decodedArray.empty());
+
+        vector<float> mzs(1, 1.0f);
+        vector<float> intensities(1, 1.0f);
+        size_t count = 1;
+        QVERIFY(!base64::decodeBase64Pairs(b64String.c_str(),
+                                           b64String.size(),
+                                           8,
+                                           false,
+                                           true,
+                                           mzs,
+                                           intensities,
+                                           count));
+        QVERIFY(count==0);
+        QVERIFY(mzs.empty());
+        QVERIFY(intensities.empty());
+    }
+}
+
+void Testbase64::testdecodeBase64Pairs()
+{
+    // (100.5, 20), (0, 5), (200.25, 30) in network order
+    string b64String="QskAAEGgAAAAAAAAQKAAAENIQABB8AAA";
+    vector<float> mzs;
+    vector<float> intensities;
+    size_t count = 0;
+    QVERIFY(base64::decodeBase64Pairs(b64String.c_str(),
+                                      b64String.size(),
+                                      4,
+                                      true,
+                                      false,
+                                      mzs,
+                                      intensities,
+                                      count));
+
+    QVERIFY(count==6);
+    QVERIFY(mzs.size()==2);
+    QVERIFY(intensities.size()==2);
+    QVERIFY(TestUtils::floatCompare(mzs[0],100.5));
+    QVERIFY(TestUtils::floatCompare(intensities[0],20.0));
+    QVERIFY(TestUtils::floatCompare(mzs[1],200.25));
+    QVERIFY(TestUtils::floatCompare(intensities[1],30.0));
+}
+
+void Testbase64::testdecodeBase64Double()
+{
+    // little endian 64-bit values
+    string b64String="c59HhUVKk0D///8/P4RRQPX//58CDqJA";
+    vector<double> decodedArray;
+    base64::decodeBase64(b64String.c_str(),
+                         b64String.size(),
+                         8,
+                         false,
+                         false,
+                         decodedArray);
+
+    QVERIFY(decodedArray.size()==3);
+    QVERIFY(decodedArray[0]==1234.5678912345);
+    QVERIFY(decodedArray[1]==70.0663604736328);
+    QVERIFY(decodedArray[2]==2311.00512695312);
+}
+
 void Testbase64::testdecodeString()
 {
     string b64String="bWF2ZW4gaXMgYXdlc29tZQ==";
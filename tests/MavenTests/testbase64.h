@@ -27,6 +27,10 @@ class Testbase64 : public QObject {
         // test functions - all functions prefixed with "test" will be ran as tests
         // this is automatically detected thanks to Qt's meta-information about QObjects
         void testdecodeBase64();
+        void testdecodeBase64Compressed();
+        void testdecodeBase64CorruptCompressed();
+        void testdecodeBase64Pairs();
+        void testdecodeBase64Double();
         void testdecodeString();
 };
 